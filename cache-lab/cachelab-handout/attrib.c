@@ -0,0 +1,432 @@
+// attrib.c - Miss attribution by set, block, region and kind (see attrib.h)
+#include "attrib.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COMPULSORY 0
+#define CAPACITY 1
+#define CONFLICT 2
+
+static const char *kind_names[3] = {"compulsory", "capacity", "conflict"};
+
+#define MAX_NAME 32
+
+// A region of the map
+typedef struct {
+  char name[MAX_NAME];
+  uint64_t start, bytes, row;
+  uint64_t accesses, misses;
+  uint64_t kinds[3];
+} region_t;
+
+// A block that has been accessed. Its first access is its compulsory
+// miss, so it has 1 + capacity + conflict misses.
+typedef struct {
+  uint64_t key;      // block number + 1, or 0 for a free slot
+  int32_t node;      // its node in the recency list, or -1 if not cached
+  uint32_t capacity;
+  uint32_t conflict;
+} entry_t;
+
+struct attrib {
+  int s, b;
+  uint64_t sets;
+  uint64_t accesses;
+  uint64_t kinds[3];
+  uint64_t *set_misses;
+  uint64_t *set_conflicts;
+
+  // The blocks seen, by open addressing
+  entry_t *table;
+  size_t cap, count;
+
+  // The fully associative shadow cache: a list of nodes, most recently used
+  // first, each holding a block number
+  int32_t lines, used;
+  int32_t head, tail;
+  int32_t *prev, *next;
+  uint64_t *block;
+
+  region_t *regions;
+  int nregions;
+  int last;          // region of the previous access, or -1
+  region_t other;    // accesses outside every region
+};
+
+// Read the map file at path into a->regions; returns 0 or -1
+static int read_map(attrib_t *a, const char *path) {
+  FILE *f = fopen(path, "r");
+  char line[512];
+  int lineno = 0;
+
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    region_t r;
+    char *p = line + strspn(line, " \t");
+    ++lineno;
+    if (*p == '\0' || *p == '\n' || *p == '#') {
+      continue;
+    }
+    memset(&r, 0, sizeof(r));
+    int n = sscanf(p, "%31s %" SCNx64 " %" SCNu64 " %" SCNu64, r.name,
+                   &r.start, &r.bytes, &r.row);
+    if (n < 3 || r.bytes == 0) {
+      fprintf(stderr,
+              "%s:%d: expected <name> <start> <bytes> [<row bytes>]\n", path,
+              lineno);
+      fclose(f);
+      return -1;
+    }
+    region_t *grown = (region_t *)realloc(
+        a->regions, (a->nregions + 1) * sizeof(region_t));
+    if (grown == NULL) {
+      fclose(f);
+      return -1;
+    }
+    a->regions = grown;
+    a->regions[a->nregions++] = r;
+  }
+  fclose(f);
+  return 0;
+}
+
+attrib_t *attrib_new(int s, int E, int b, const char *path) {
+  attrib_t *a = (attrib_t *)calloc(1, sizeof(attrib_t));
+  if (a == NULL) {
+    fputs("attrib: out of memory\n", stderr);
+    return NULL;
+  }
+  a->s = s;
+  a->b = b;
+  a->sets = (uint64_t)1 << s;
+  a->lines = (int32_t)(a->sets * E);
+  a->head = a->tail = -1;
+  a->last = -1;
+  strcpy(a->other.name, "(other)");
+  a->cap = 1024;
+  a->set_misses = (uint64_t *)calloc(a->sets, sizeof(uint64_t));
+  a->set_conflicts = (uint64_t *)calloc(a->sets, sizeof(uint64_t));
+  a->table = (entry_t *)calloc(a->cap, sizeof(entry_t));
+  a->prev = (int32_t *)malloc(a->lines * sizeof(int32_t));
+  a->next = (int32_t *)malloc(a->lines * sizeof(int32_t));
+  a->block = (uint64_t *)malloc(a->lines * sizeof(uint64_t));
+  if (a->sets * E > INT32_MAX || a->set_misses == NULL ||
+      a->set_conflicts == NULL || a->table == NULL || a->prev == NULL ||
+      a->next == NULL || a->block == NULL) {
+    fputs("attrib: out of memory\n", stderr);
+    attrib_free(a);
+    return NULL;
+  }
+  if (path != NULL && read_map(a, path) < 0) {
+    attrib_free(a);
+    return NULL;
+  }
+  return a;
+}
+
+void attrib_free(attrib_t *a) {
+  if (a != NULL) {
+    free(a->set_misses);
+    free(a->set_conflicts);
+    free(a->table);
+    free(a->prev);
+    free(a->next);
+    free(a->block);
+    free(a->regions);
+    free(a);
+  }
+}
+
+// The slot of key in a table of cap slots: its entry, or the free slot
+// where it belongs
+static entry_t *slot(entry_t *table, size_t cap, uint64_t key) {
+  size_t h = (size_t)(key * 0x9e3779b97f4a7c15ULL) & (cap - 1);
+  while (table[h].key != 0 && table[h].key != key) {
+    h = (h + 1) & (cap - 1);
+  }
+  return &table[h];
+}
+
+// Double the table; returns 0, or -1 if memory runs out
+static int grow(attrib_t *a) {
+  size_t cap = 2 * a->cap;
+  entry_t *table = (entry_t *)calloc(cap, sizeof(entry_t));
+  if (table == NULL) {
+    return -1;
+  }
+  for (size_t i = 0; i < a->cap; ++i) {
+    if (a->table[i].key != 0) {
+      *slot(table, cap, a->table[i].key) = a->table[i];
+    }
+  }
+  free(a->table);
+  a->table = table;
+  a->cap = cap;
+  return 0;
+}
+
+static void unlink_node(attrib_t *a, int32_t n) {
+  if (a->prev[n] >= 0) {
+    a->next[a->prev[n]] = a->next[n];
+  } else {
+    a->head = a->next[n];
+  }
+  if (a->next[n] >= 0) {
+    a->prev[a->next[n]] = a->prev[n];
+  } else {
+    a->tail = a->prev[n];
+  }
+}
+
+static void push_front(attrib_t *a, int32_t n) {
+  a->prev[n] = -1;
+  a->next[n] = a->head;
+  if (a->head >= 0) {
+    a->prev[a->head] = n;
+  } else {
+    a->tail = n;
+  }
+  a->head = n;
+}
+
+// Access block in the shadow cache; returns 1 on a hit
+static int shadow_access(attrib_t *a, entry_t *e, uint64_t block) {
+  int32_t n = e->node;
+  if (n >= 0) {
+    unlink_node(a, n);
+    push_front(a, n);
+    return 1;
+  }
+  if (a->used < a->lines) {
+    n = a->used++;
+  } else {
+    n = a->tail;
+    unlink_node(a, n);
+    slot(a->table, a->cap, a->block[n] + 1)->node = -1;
+  }
+  a->block[n] = block;
+  e->node = n;
+  push_front(a, n);
+  return 0;
+}
+
+static region_t *region_of(attrib_t *a, uint64_t addr) {
+  if (a->last >= 0 && addr - a->regions[a->last].start <
+                          a->regions[a->last].bytes) {
+    return &a->regions[a->last];
+  }
+  for (int i = 0; i < a->nregions; ++i) {
+    if (addr - a->regions[i].start < a->regions[i].bytes) {
+      a->last = i;
+      return &a->regions[i];
+    }
+  }
+  return &a->other;
+}
+
+int attrib_access(attrib_t *a, uint64_t addr, int miss) {
+  uint64_t block = addr >> a->b;
+  if (2 * (a->count + 1) > a->cap && grow(a) < 0) {
+    return -1;
+  }
+  entry_t *e = slot(a->table, a->cap, block + 1);
+  int seen = e->key != 0;
+  if (!seen) {
+    e->key = block + 1;
+    e->node = -1;
+    ++a->count;
+  }
+  int shadow_hit = shadow_access(a, e, block);
+
+  region_t *r = region_of(a, addr);
+  ++a->accesses;
+  ++r->accesses;
+  if (!miss) {
+    return 0;
+  }
+  int kind = !seen ? COMPULSORY : shadow_hit ? CONFLICT : CAPACITY;
+  uint64_t set = block & (a->sets - 1);
+  ++a->kinds[kind];
+  ++a->set_misses[set];
+  ++r->misses;
+  ++r->kinds[kind];
+  if (kind == CAPACITY) {
+    ++e->capacity;
+  } else if (kind == CONFLICT) {
+    ++e->conflict;
+    ++a->set_conflicts[set];
+  }
+  return 0;
+}
+
+static uint64_t entry_misses(const entry_t *e) {
+  return 1 + (uint64_t)e->capacity + e->conflict;
+}
+
+static int by_entry_misses(const void *x, const void *y) {
+  const entry_t *e = *(const entry_t *const *)x;
+  const entry_t *f = *(const entry_t *const *)y;
+  uint64_t m = entry_misses(e), n = entry_misses(f);
+  if (m != n) {
+    return m > n ? -1 : 1;
+  }
+  return e->key < f->key ? -1 : e->key > f->key;
+}
+
+// For sorting the indices of a counts array, most first
+static const uint64_t *sort_counts;
+
+static int by_count(const void *x, const void *y) {
+  uint64_t i = *(const uint64_t *)x, j = *(const uint64_t *)y;
+  if (sort_counts[i] != sort_counts[j]) {
+    return sort_counts[i] > sort_counts[j] ? -1 : 1;
+  }
+  return i < j ? -1 : i > j;
+}
+
+// Indices 0 to n - 1 sorted by counts[i], most first; NULL if memory
+// runs out
+static uint64_t *sorted(const uint64_t *counts, uint64_t n) {
+  uint64_t *idx = (uint64_t *)malloc((n ? n : 1) * sizeof(uint64_t));
+  if (idx != NULL) {
+    for (uint64_t i = 0; i < n; ++i) {
+      idx[i] = i;
+    }
+    sort_counts = counts;
+    qsort(idx, n, sizeof(uint64_t), by_count);
+  }
+  return idx;
+}
+
+static void print_region(FILE *out, const region_t *r) {
+  fprintf(out, "%-16s %12" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+               " %10" PRIu64 "\n",
+          r->name, r->accesses, r->misses, r->kinds[COMPULSORY],
+          r->kinds[CAPACITY], r->kinds[CONFLICT]);
+}
+
+// Describe where addr lies, as region+offset and row if it has rows
+static void where(const attrib_t *a, uint64_t addr, char *buf, size_t size) {
+  for (int i = 0; i < a->nregions; ++i) {
+    const region_t *r = &a->regions[i];
+    if (addr + ((uint64_t)1 << a->b) > r->start &&
+        addr < r->start + r->bytes) {
+      uint64_t off = addr > r->start ? addr - r->start : 0;
+      if (r->row != 0) {
+        snprintf(buf, size, "%s row %" PRIu64 " +%" PRIu64, r->name,
+                 off / r->row, off % r->row);
+      } else {
+        snprintf(buf, size, "%s+%" PRIu64, r->name, off);
+      }
+      return;
+    }
+  }
+  snprintf(buf, size, "-");
+}
+
+// Misses of the rows of region r, each block counted in the row of its
+// first byte within r
+static void report_rows(const attrib_t *a, const region_t *r, FILE *out,
+                        int top) {
+  uint64_t rows = (r->bytes + r->row - 1) / r->row;
+  uint64_t *misses = (uint64_t *)calloc(rows, sizeof(uint64_t));
+  uint64_t *conflicts = (uint64_t *)calloc(rows, sizeof(uint64_t));
+  uint64_t *idx = NULL;
+  if (misses != NULL && conflicts != NULL) {
+    for (size_t i = 0; i < a->cap; ++i) {
+      const entry_t *e = &a->table[i];
+      uint64_t addr = (e->key - 1) << a->b;
+      if (e->key == 0 || addr + ((uint64_t)1 << a->b) <= r->start ||
+          addr >= r->start + r->bytes) {
+        continue;
+      }
+      uint64_t row = (addr > r->start ? addr - r->start : 0) / r->row;
+      misses[row] += entry_misses(e);
+      conflicts[row] += e->conflict;
+    }
+    idx = sorted(misses, rows);
+  }
+  if (idx == NULL) {
+    fputs("attrib: out of memory\n", stderr);
+  } else {
+    fprintf(out, "\nRows of %s with the most misses (%d of %" PRIu64 "):\n",
+            r->name, top < (int)rows ? top : (int)rows, rows);
+    fprintf(out, "%8s %10s %10s\n", "row", "misses", "conflict");
+    for (uint64_t i = 0; i < rows && i < (uint64_t)top; ++i) {
+      fprintf(out, "%8" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n", idx[i],
+              misses[idx[i]], conflicts[idx[i]]);
+    }
+  }
+  free(misses);
+  free(conflicts);
+  free(idx);
+}
+
+void attrib_report(const attrib_t *a, FILE *out, int top) {
+  uint64_t misses = a->kinds[COMPULSORY] + a->kinds[CAPACITY] +
+                    a->kinds[CONFLICT];
+
+  fprintf(out, "\n%" PRIu64 " misses in %" PRIu64 " accesses:\n", misses,
+          a->accesses);
+  for (int k = 0; k < 3; ++k) {
+    fprintf(out, "  %-10s %10" PRIu64 " (%.1f%%)\n", kind_names[k],
+            a->kinds[k], misses ? 100.0 * a->kinds[k] / misses : 0.0);
+  }
+
+  if (a->nregions > 0) {
+    fprintf(out, "\n%-16s %12s %10s %10s %10s %10s\n", "region", "accesses",
+            "misses", "compulsory", "capacity", "conflict");
+    for (int i = 0; i < a->nregions; ++i) {
+      print_region(out, &a->regions[i]);
+    }
+    print_region(out, &a->other);
+  }
+
+  uint64_t *idx = sorted(a->set_misses, a->sets);
+  if (idx != NULL) {
+    fprintf(out, "\nSets with the most misses (%d of %" PRIu64 "):\n",
+            (uint64_t)top < a->sets ? top : (int)a->sets, a->sets);
+    fprintf(out, "%8s %10s %10s\n", "set", "misses", "conflict");
+    for (uint64_t i = 0; i < a->sets && i < (uint64_t)top; ++i) {
+      fprintf(out, "%8" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n", idx[i],
+              a->set_misses[idx[i]], a->set_conflicts[idx[i]]);
+    }
+    free(idx);
+  }
+
+  const entry_t **blocks =
+      (const entry_t **)malloc((a->count ? a->count : 1) * sizeof(entry_t *));
+  if (blocks != NULL) {
+    size_t n = 0;
+    for (size_t i = 0; i < a->cap; ++i) {
+      if (a->table[i].key != 0) {
+        blocks[n++] = &a->table[i];
+      }
+    }
+    qsort(blocks, n, sizeof(entry_t *), by_entry_misses);
+    fprintf(out, "\nBlocks with the most misses (%d of %zu):\n",
+            (size_t)top < n ? top : (int)n, n);
+    fprintf(out, "%18s  %-24s %10s %10s %10s\n", "address", "where", "misses",
+            "capacity", "conflict");
+    for (size_t i = 0; i < n && i < (size_t)top; ++i) {
+      char buf[64];
+      uint64_t addr = (blocks[i]->key - 1) << a->b;
+      where(a, addr, buf, sizeof(buf));
+      fprintf(out, "%18" PRIx64 "  %-24s %10" PRIu64 " %10" PRIu32
+                   " %10" PRIu32 "\n",
+              addr, buf, entry_misses(blocks[i]), blocks[i]->capacity,
+              blocks[i]->conflict);
+    }
+    free(blocks);
+  }
+
+  for (int i = 0; i < a->nregions; ++i) {
+    if (a->regions[i].row != 0) {
+      report_rows(a, &a->regions[i], out, top);
+    }
+  }
+}
@@ -0,0 +1,48 @@
+// attrib.h - Where a cache's misses come from
+//
+// csim -a feeds every data access and its result to this module, which
+// reports the misses by cache set, by block and by symbol, and sorts each
+// miss into one of the three Cs:
+//
+// - compulsory: the first access to the block;
+// - capacity: a fully associative LRU cache with as many lines would also
+//   have missed;
+// - conflict: that cache would have hit, so the miss comes from the
+//   mapping to sets (or from the replacement policy).
+//
+// The fully associative shadow cache is a hash table of every block seen,
+// pointing into a doubly linked recency list of the cached ones, so that an
+// access costs O(1) whatever the number of lines.
+//
+// Symbols come from a map file with one region per line:
+//
+//   <name> <start> <bytes> [<row bytes>]
+//
+// with the start in hex (with or without 0x) and the sizes in decimal;
+// blank lines and lines starting with # are skipped. A region with a row
+// size is taken as a row-major array, and its misses are also reported
+// by row. tracegen-rec -m writes such a map for the lab's A and B.
+#ifndef ATTRIB_H
+#define ATTRIB_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct attrib attrib_t;
+
+// Create the report for a cache of 2^s sets of E lines of 2^b bytes, with
+// the regions of the map file at path (none if path is NULL). Returns NULL
+// if memory runs out or the map cannot be read or parsed, after printing
+// the reason to stderr.
+attrib_t *attrib_new(int s, int E, int b, const char *path);
+
+void attrib_free(attrib_t *a);
+
+// Record an access to addr, which missed in the cache if miss is nonzero;
+// returns 0, or -1 if memory runs out
+int attrib_access(attrib_t *a, uint64_t addr, int miss);
+
+// Print the report, listing the top sets, blocks and rows
+void attrib_report(const attrib_t *a, FILE *out, int top);
+
+#endif
@@ -0,0 +1,273 @@
+// cache.c - The cache model behind csim (see cache.h)
+#define _POSIX_C_SOURCE 200112L
+#include "cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CACHE_X86
+#endif
+
+// Marks a valid line in its tag. Tags have at most 63 bits since s + b
+// is at least 1, and padding ways hold 0, so they never match.
+#define VALID ((uint64_t)1 << 63)
+
+// Sets with more than one line are padded to a multiple of this many
+// ways, so that the SIMD loops below need no remainder handling
+#define SIMD_WAYS 4
+
+// Alignment of the tag array: a set of up to 8 ways is one host line
+#define ALIGNMENT 64
+
+// Return the way of tags that holds key, or -1
+static int find_scalar(const uint64_t *tags, int ways, uint64_t key) {
+  for (int i = 0; i < ways; ++i) {
+    if (tags[i] == key) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+#ifdef __SSE2__
+// SSE2 has no 64-bit compare: a way matches if both 32-bit halves do
+static int find_sse2(const uint64_t *tags, int ways, uint64_t key) {
+  __m128i k = _mm_set1_epi64x((long long)key);
+  for (int i = 0; i < ways; i += 2) {
+    __m128i t = _mm_load_si128((const __m128i *)(tags + i));
+    __m128i eq = _mm_cmpeq_epi32(t, k);
+    eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+    int mask = _mm_movemask_pd(_mm_castsi128_pd(eq));
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return -1;
+}
+#endif
+
+#ifdef CACHE_X86
+__attribute__((target("avx2"))) static int
+find_avx2(const uint64_t *tags, int ways, uint64_t key) {
+  __m256i k = _mm256_set1_epi64x((long long)key);
+  for (int i = 0; i < ways; i += 4) {
+    __m256i t = _mm256_load_si256((const __m256i *)(tags + i));
+    int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(t, k)));
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return -1;
+}
+#endif
+
+// Choose the lookup: the widest the host supports, or the one CSIM_ISA
+// names
+static void pick_find(cache_t *c) {
+  const char *want = getenv("CSIM_ISA");
+
+  c->find = find_scalar;
+  c->isa = "scalar";
+  if (c->ways == 1 || (want != NULL && strcmp(want, "scalar") == 0)) {
+    return;
+  }
+#ifdef __SSE2__
+  c->find = find_sse2;
+  c->isa = "sse2";
+  if (want != NULL && strcmp(want, "sse2") == 0) {
+    return;
+  }
+#endif
+#ifdef CACHE_X86
+  if (__builtin_cpu_supports("avx2")) {
+    c->find = find_avx2;
+    c->isa = "avx2";
+  }
+#endif
+}
+
+cache_t *cache_new(int s, int E, int b) {
+  if (s < 0 || b < 0 || E < 1 || s + b < 1 || s + b >= 64 || s >= 48) {
+    return NULL;
+  }
+  cache_t *c = (cache_t *)malloc(sizeof(cache_t));
+  if (c == NULL) {
+    return NULL;
+  }
+  c->s = s;
+  c->E = E;
+  c->b = b;
+  c->ways = E == 1 ? 1 : (E + SIMD_WAYS - 1) / SIMD_WAYS * SIMD_WAYS;
+  c->set_mask = ((uint64_t)1 << s) - 1;
+
+  // The tags of all sets, then their dirty flags, in one allocation
+  size_t lines = ((size_t)1 << s) * (size_t)c->ways;
+  void *p;
+  if (lines > SIZE_MAX / (sizeof(uint64_t) + 1) ||
+      posix_memalign(&p, ALIGNMENT, lines * (sizeof(uint64_t) + 1)) != 0) {
+    free(c);
+    return NULL;
+  }
+  c->tags = (uint64_t *)p;
+  c->dirty = (uint8_t *)(c->tags + lines);
+  pick_find(c);
+  cache_reset(c);
+  return c;
+}
+
+void cache_free(cache_t *c) {
+  if (c != NULL) {
+    free(c->tags);
+    free(c);
+  }
+}
+
+void cache_reset(cache_t *c) {
+  size_t lines = ((size_t)1 << c->s) * (size_t)c->ways;
+  memset(c->tags, 0, lines * (sizeof(uint64_t) + 1));
+  c->hits = 0;
+  c->misses = 0;
+  c->evictions = 0;
+}
+
+// Access the block holding addr and return the recency rank it had, or -1
+// on a miss; *res is set to the result for cache_access
+static inline int access_rank(cache_t *c, uint64_t addr, int *res) {
+  uint64_t block = addr >> c->b;
+  uint64_t *tags = c->tags + (size_t)(block & c->set_mask) * (size_t)c->ways;
+  uint64_t key = (block >> c->s) | VALID;
+
+  // Most hits are on the line used last, which is kept in way 0
+  *res = CACHE_HIT;
+  if (tags[0] == key) {
+    ++c->hits;
+    return 0;
+  }
+  int i = c->ways == 1 ? -1 : c->find(tags, c->ways, key);
+  int rank = i;
+  if (i >= 0) {
+    ++c->hits;
+  } else {
+    // Miss: the last way holds the least recently used line, or is empty
+    // if the set is not full
+    ++c->misses;
+    i = c->E - 1;
+    if (tags[i] & VALID) {
+      ++c->evictions;
+      *res = CACHE_EVICT;
+    } else {
+      *res = CACHE_MISS;
+    }
+  }
+  // Move the line to the front
+  memmove(tags + 1, tags, i * sizeof(uint64_t));
+  tags[0] = key;
+  return rank;
+}
+
+int cache_access(cache_t *c, uint64_t addr) {
+  int res;
+  access_rank(c, addr, &res);
+  return res;
+}
+
+int cache_access_rank(cache_t *c, uint64_t addr) {
+  int res;
+  return access_rank(c, addr, &res);
+}
+
+int cache_set_lines(const cache_t *c, uint64_t set) {
+  const uint64_t *tags = c->tags + (size_t)set * (size_t)c->ways;
+  int n = 0;
+  while (n < c->E && (tags[n] & VALID)) {
+    ++n;
+  }
+  return n;
+}
+
+// The way of the block holding addr in its set, or -1; *base is set to the
+// index of the first way of the set and *key to the tag to store
+static inline int find_block(const cache_t *c, uint64_t addr, size_t *base,
+                             uint64_t *key) {
+  uint64_t block = addr >> c->b;
+  *base = (size_t)(block & c->set_mask) * (size_t)c->ways;
+  *key = (block >> c->s) | VALID;
+  const uint64_t *tags = c->tags + *base;
+  if (tags[0] == *key) {
+    return 0;
+  }
+  return c->ways == 1 ? -1 : c->find(tags, c->ways, *key);
+}
+
+// Move way i of the set at base to the front, with the given dirty flag
+static inline void move_to_front(cache_t *c, size_t base, int i, uint64_t key,
+                                 int dirty) {
+  memmove(c->tags + base + 1, c->tags + base, i * sizeof(uint64_t));
+  memmove(c->dirty + base + 1, c->dirty + base, i);
+  c->tags[base] = key;
+  c->dirty[base] = (uint8_t)dirty;
+}
+
+int cache_contains(const cache_t *c, uint64_t addr) {
+  size_t base;
+  uint64_t key;
+  return find_block(c, addr, &base, &key) >= 0;
+}
+
+int cache_lookup(cache_t *c, uint64_t addr, int dirty) {
+  size_t base;
+  uint64_t key;
+  int i = find_block(c, addr, &base, &key);
+  if (i < 0) {
+    return 0;
+  }
+  move_to_front(c, base, i, key, dirty || c->dirty[base + i]);
+  return 1;
+}
+
+int cache_touch(cache_t *c, uint64_t addr, int dirty) {
+  size_t base;
+  uint64_t key;
+  int i = find_block(c, addr, &base, &key);
+  if (i < 0) {
+    return -1;
+  }
+  int old = c->dirty[base + i];
+  move_to_front(c, base, i, key, dirty);
+  return old;
+}
+
+int cache_insert(cache_t *c, uint64_t addr, int dirty, uint64_t *victim,
+                 int *victim_dirty) {
+  uint64_t block = addr >> c->b;
+  uint64_t set = block & c->set_mask;
+  size_t base = (size_t)set * (size_t)c->ways;
+  int last = c->E - 1;
+  uint64_t old = c->tags[base + last];
+  int evicted = (old & VALID) != 0;
+
+  if (evicted) {
+    *victim = (((old & ~VALID) << c->s) | set) << c->b;
+    *victim_dirty = c->dirty[base + last];
+  }
+  move_to_front(c, base, last, (block >> c->s) | VALID, dirty);
+  return evicted;
+}
+
+int cache_invalidate(cache_t *c, uint64_t addr) {
+  size_t base;
+  uint64_t key;
+  int i = find_block(c, addr, &base, &key);
+  if (i < 0) {
+    return -1;
+  }
+  // Close the gap, so that the valid lines stay in front
+  int dirty = c->dirty[base + i];
+  int rest = c->E - 1 - i;
+  memmove(c->tags + base + i, c->tags + base + i + 1, rest * sizeof(uint64_t));
+  memmove(c->dirty + base + i, c->dirty + base + i + 1, rest);
+  c->tags[base + c->E - 1] = 0;
+  c->dirty[base + c->E - 1] = 0;
+  return dirty;
+}
@@ -0,0 +1,85 @@
+// cache.h - A set-associative LRU cache model shared by csim and its tools
+//
+// The tags of the whole cache live in one contiguous array, set after
+// set, so that a lookup reads one or two host cache lines and compares
+// all ways of the set at once with SIMD instructions. Each set keeps its
+// tags in order of recency, most recently used first, so LRU needs no
+// time stamps: a hit moves the line to way 0 and a miss replaces the
+// line in the last way.
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+
+// Result of one access
+#define CACHE_HIT 1
+#define CACHE_MISS 0
+#define CACHE_EVICT 2
+
+typedef struct cache {
+  int s;                 // set index bits
+  int E;                 // lines per set
+  int b;                 // block offset bits
+  int ways;              // E rounded up to the SIMD width
+  uint64_t set_mask;     // (1 << s) - 1
+  uint64_t *tags;        // ways tags per set, valid ones first
+  uint8_t *dirty;        // dirty flag of each line, in the order of tags
+  int (*find)(const uint64_t *tags, int ways, uint64_t key);
+  const char *isa;       // name of the lookup implementation
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+} cache_t;
+
+// Create a cache with 2^s sets of E lines of 2^b bytes. s + b must be at
+// least 1, so that a tag never needs all 64 bits. The lookup uses the
+// widest instruction set the host supports, unless the environment
+// variable CSIM_ISA names another one ("avx2", "sse2" or "scalar").
+// Returns NULL if the arguments are invalid or memory runs out.
+cache_t *cache_new(int s, int E, int b);
+
+void cache_free(cache_t *c);
+
+// Forget the contents and the counters
+void cache_reset(cache_t *c);
+
+// Access the block holding addr; returns CACHE_HIT, CACHE_MISS or
+// CACHE_EVICT and updates the counters
+int cache_access(cache_t *c, uint64_t addr);
+
+// Like cache_access, but return the rank of the line in the recency order
+// of its set before the access (0 for the most recently used line), or -1
+// on a miss. This is the LRU stack distance: the access hits in every
+// cache with the same s and b and more than rank lines per set.
+int cache_access_rank(cache_t *c, uint64_t addr);
+
+// Number of valid lines in a set
+int cache_set_lines(const cache_t *c, uint64_t set);
+
+// The functions below let a caller such as hier.c decide what happens on a
+// miss. They keep dirty flags, which the ones above ignore, so use only
+// one of the two groups on a cache. None of them updates the counters.
+
+// 1 if the block holding addr is cached; changes nothing
+int cache_contains(const cache_t *c, uint64_t addr);
+
+// Look up the block holding addr. On a hit make it the most recently used
+// line, mark it dirty if dirty is nonzero and return 1; return 0 on a miss.
+int cache_lookup(cache_t *c, uint64_t addr, int dirty);
+
+// Like cache_lookup, but set the line's flag to dirty rather than add to
+// it. Returns the old flag on a hit and -1 on a miss.
+int cache_touch(cache_t *c, uint64_t addr, int dirty);
+
+// Fill the block holding addr, which must not be cached, as the most
+// recently used line. If that evicts a valid line, store the address of
+// its block in *victim and its dirty flag in *victim_dirty and return 1;
+// otherwise return 0.
+int cache_insert(cache_t *c, uint64_t addr, int dirty, uint64_t *victim,
+                 int *victim_dirty);
+
+// Drop the block holding addr; returns its dirty flag, or -1 if it is not
+// cached
+int cache_invalidate(cache_t *c, uint64_t addr);
+
+#endif
@@ -18,11 +18,12 @@ typedef struct trans_func{
 
 /* 
  * printSummary - This function provides a standard way for your cache
- * simulator * to display its final hit and miss statistics
+ * simulator * to display its final hit and miss statistics. The counts
+ * are 64-bit, as a long trace overflows an int
  */ 
-void printSummary(int hits,  /* number of  hits */
-				  int misses, /* number of misses */
-				  int evictions); /* number of evictions */
+void printSummary(unsigned long long hits,  /* number of  hits */
+				  unsigned long long misses, /* number of misses */
+				  unsigned long long evictions); /* number of evictions */
 
 /* Fill the matrix with data */
 void initMatrix(int M, int N, int A[N][M], int B[M][N]);
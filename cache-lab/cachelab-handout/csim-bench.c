@@ -0,0 +1,354 @@
+// csim-bench.c - Measure the speed of the cache model on a trace file and
+// on synthetic traces of any length
+//
+// Usage: ./csim-bench [-h] [-s <num>] [-E <num>] [-b <num>] [-n <num>]
+//                     [-p random|stream] [-w <bytes>] [-t <file>] [-r <num>]
+//
+// Each run replays the same accesses through the array-of-structs model
+// that csim.c used before cache.c (one malloc per set, a scan of the
+// line structs per access) and through cache.c with every lookup the host
+// supports. It checks that all of them count the same hits, misses and
+// evictions and prints the speed of each. With -t the trace (text or
+// binary) is read into memory first and replayed -r times, so parsing is
+// timed separately; without it, -n addresses are generated in chunks
+// outside the timed region.
+#define _POSIX_C_SOURCE 200112L
+#include "cache.h"
+#include "trace.h"
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CHUNK (1 << 20) // addresses generated per timed chunk
+
+// Source of the addresses of one run
+typedef struct {
+  uint64_t *trace;     // addresses of the trace file (-t), or NULL
+  long trace_len;      // number of them
+  long modifies;       // 'M' records per replay of the trace
+  int repeat;          // replays of the trace
+  long n;              // synthetic: number of addresses
+  int stream;          // synthetic: sequential rather than random
+  uint64_t footprint;  // synthetic: bytes touched
+} source_t;
+
+// Counts of one run
+typedef struct {
+  uint64_t hits, misses, evictions;
+  double secs;
+} result_t;
+
+// The line struct of the old csim.c, with the tag and stamp widened to
+// 64 bits so that its counts can be checked against cache.c
+typedef struct {
+  char valid;
+  uint64_t tag;
+  uint64_t time_stamp;
+} old_line_t;
+
+typedef struct {
+  old_line_t **sets;
+  int s, E, b;
+  uint64_t tt;
+  uint64_t hits, misses, evictions;
+} old_cache_t;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static old_cache_t *old_new(int s, int E, int b) {
+  old_cache_t *c = (old_cache_t *)calloc(1, sizeof(old_cache_t));
+  c->s = s;
+  c->E = E;
+  c->b = b;
+  c->sets = (old_line_t **)malloc(sizeof(old_line_t *) << s);
+  for (long i = 0; i < 1L << s; ++i) {
+    c->sets[i] = (old_line_t *)calloc(E, sizeof(old_line_t));
+  }
+  return c;
+}
+
+static void old_free(old_cache_t *c) {
+  for (long i = 0; i < 1L << c->s; ++i) {
+    free(c->sets[i]);
+  }
+  free(c->sets);
+  free(c);
+}
+
+// useCache of the old csim.c
+static void old_access(old_cache_t *c, uint64_t addr) {
+  old_line_t *st = c->sets[(addr >> c->b) & ((1UL << c->s) - 1)];
+  uint64_t tag = addr >> (c->b + c->s);
+  int line_index = 0;
+  uint64_t line_time_stamp = st[0].time_stamp;
+
+  for (int i = 0; i < c->E; ++i) {
+    old_line_t *tmp = &st[i];
+    if (tmp->valid && tmp->tag == tag) {
+      ++c->hits;
+      tmp->time_stamp = ++c->tt;
+      return;
+    }
+    if (tmp->time_stamp < line_time_stamp) {
+      line_index = i;
+      line_time_stamp = tmp->time_stamp;
+    }
+  }
+  ++c->misses;
+  old_line_t *chosen = &st[line_index];
+  chosen->tag = tag;
+  chosen->time_stamp = ++c->tt;
+  if (chosen->valid) {
+    ++c->evictions;
+  } else {
+    chosen->valid = 1;
+  }
+}
+
+// Fill buf with the next synthetic addresses; returns how many
+static long next_chunk(const source_t *src, long done, uint64_t *buf,
+                       uint64_t *rng) {
+  long len = src->n - done < CHUNK ? src->n - done : CHUNK;
+  for (long i = 0; i < len; ++i) {
+    if (src->stream) {
+      buf[i] = (uint64_t)(done + i) * 8 % src->footprint;
+    } else {
+      *rng ^= *rng << 13; // xorshift64
+      *rng ^= *rng >> 7;
+      *rng ^= *rng << 17;
+      buf[i] = *rng % src->footprint & ~(uint64_t)7;
+    }
+  }
+  return len;
+}
+
+// Replay the source through the old model (c == NULL) or cache.c
+static result_t run(const source_t *src, int s, int E, int b, cache_t *c) {
+  old_cache_t *old = c == NULL ? old_new(s, E, b) : NULL;
+  result_t r;
+  double start;
+
+  r.secs = 0;
+  if (src->trace != NULL) {
+    start = now();
+    for (int k = 0; k < src->repeat; ++k) {
+      if (old != NULL) {
+        for (long i = 0; i < src->trace_len; ++i) {
+          old_access(old, src->trace[i]);
+        }
+      } else {
+        for (long i = 0; i < src->trace_len; ++i) {
+          cache_access(c, src->trace[i]);
+        }
+      }
+    }
+    r.secs = now() - start;
+  } else {
+    uint64_t *buf = (uint64_t *)malloc(CHUNK * sizeof(uint64_t));
+    uint64_t rng = 88172645463325252ULL;
+    long len;
+    for (long done = 0; done < src->n; done += len) {
+      len = next_chunk(src, done, buf, &rng);
+      start = now();
+      if (old != NULL) {
+        for (long i = 0; i < len; ++i) {
+          old_access(old, buf[i]);
+        }
+      } else {
+        for (long i = 0; i < len; ++i) {
+          cache_access(c, buf[i]);
+        }
+      }
+      r.secs += now() - start;
+    }
+    free(buf);
+  }
+
+  if (old != NULL) {
+    r.hits = old->hits;
+    r.misses = old->misses;
+    r.evictions = old->evictions;
+    old_free(old);
+  } else {
+    r.hits = c->hits;
+    r.misses = c->misses;
+    r.evictions = c->evictions;
+  }
+  r.hits += (uint64_t)src->modifies * src->repeat;
+  return r;
+}
+
+// Read the L, S and M records of a trace into memory. Reports how fast
+// trace.c reads the file and, for a text trace, how fast the fscanf loop
+// that csim used before does.
+static void read_trace(source_t *src, const char *path) {
+  trace_t *t = trace_open(path);
+  long cap = 1 << 16, records = 0;
+  trace_rec_t r;
+  int more;
+
+  if (t == NULL) {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+  src->trace = (uint64_t *)malloc(cap * sizeof(uint64_t));
+  double start = now();
+  while ((more = trace_next(t, &r)) > 0) {
+    ++records;
+    if (r.op == 'I') {
+      continue;
+    }
+    if (src->trace_len == cap) {
+      cap *= 2;
+      src->trace = (uint64_t *)realloc(src->trace, cap * sizeof(uint64_t));
+    }
+    src->trace[src->trace_len++] = r.addr;
+    src->modifies += r.op == 'M';
+  }
+  double secs = now() - start;
+  if (more < 0) {
+    fprintf(stderr, "%s: the trace is corrupt\n", path);
+    exit(EXIT_FAILURE);
+  }
+  double mb = trace_bytes(t) / 1e6;
+  printf("read %s (%s, %.1f MB): %.1f Mrec/s, %.0f MB/s\n", path,
+         trace_is_binary(t) ? "binary" : "text", mb, records / secs / 1e6,
+         mb / secs);
+
+  if (!trace_is_binary(t)) {
+    FILE *fp = fopen(path, "r");
+    char operation;
+    unsigned long address;
+    int size;
+    records = 0;
+    start = now();
+    while (fscanf(fp, " %c %lx,%d\n", &operation, &address, &size) == 3) {
+      ++records;
+    }
+    secs = now() - start;
+    fclose(fp);
+    printf("read %s with fscanf: %.1f Mrec/s, %.0f MB/s\n", path,
+           records / secs / 1e6, mb / secs);
+  }
+  trace_close(t);
+}
+
+static void printUsage() {
+  puts("Usage: ./csim-bench [-h] [-s <num>] [-E <num>] [-b <num>] [-n <num>]");
+  puts("                    [-p random|stream] [-w <bytes>] [-t <file>] "
+       "[-r <num>]");
+  puts("Options:");
+  puts("  -h         Print this help message.");
+  puts("  -s <num>   Number of set index bits (default 6).");
+  puts("  -E <num>   Number of lines per set (default 8).");
+  puts("  -b <num>   Number of block offset bits (default 6).");
+  puts("  -n <num>   Synthetic accesses (default 100000000).");
+  puts("  -p <name>  Synthetic pattern: random or stream (default random).");
+  puts("  -w <num>   Synthetic footprint in bytes (default 67108864).");
+  puts("  -t <file>  Replay this trace instead.");
+  puts("  -r <num>   Replays of the trace (default 100).");
+  puts("");
+  puts("Examples:");
+  puts(" linux>  ./csim-bench -s 5 -E 1 -b 5 -t traces/long.trace");
+  puts(" linux>  ./csim-bench -s 10 -E 16 -b 6 -n 1000000000");
+}
+
+int main(int argc, char *argv[]) {
+  source_t src = {NULL, 0, 0, 100, 100000000L, 0, (uint64_t)1 << 26};
+  int s = 6, E = 8, b = 6;
+  char *trace = NULL;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "hs:E:b:n:p:w:t:r:")) != -1) {
+    switch (opt) {
+    case 's':
+      s = atoi(optarg);
+      break;
+    case 'E':
+      E = atoi(optarg);
+      break;
+    case 'b':
+      b = atoi(optarg);
+      break;
+    case 'n':
+      src.n = atol(optarg);
+      break;
+    case 'p':
+      src.stream = strcmp(optarg, "stream") == 0;
+      break;
+    case 'w':
+      src.footprint = strtoull(optarg, NULL, 0);
+      break;
+    case 't':
+      trace = optarg;
+      break;
+    case 'r':
+      src.repeat = atoi(optarg);
+      break;
+    case 'h':
+      printUsage();
+      exit(EXIT_SUCCESS);
+    default:
+      printUsage();
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (s <= 0 || E <= 0 || b <= 0 || src.n <= 0 || src.footprint < 8 ||
+      src.repeat <= 0) {
+    printUsage();
+    exit(EXIT_FAILURE);
+  }
+  if (trace != NULL) {
+    read_trace(&src, trace);
+    printf("%s x %d: %ld accesses, s=%d E=%d b=%d\n", trace, src.repeat,
+           src.trace_len * src.repeat, s, E, b);
+  } else {
+    src.repeat = 1;
+    printf("%s: %ld accesses over %" PRIu64 " bytes, s=%d E=%d b=%d\n",
+           src.stream ? "stream" : "random", src.n, src.footprint, s, E, b);
+  }
+
+  // The old model, then cache.c with each lookup up to the widest one
+  const char *isas[] = {NULL, "scalar", "sse2", "avx2"};
+  result_t base = {0, 0, 0, 0};
+  printf("%-10s %10s %10s %12s %12s %12s\n", "model", "Macc/s", "ns/acc",
+         "hits", "misses", "evictions");
+  for (int i = 0; i < 4; ++i) {
+    cache_t *c = NULL;
+    const char *name = "old";
+    if (isas[i] != NULL) {
+      setenv("CSIM_ISA", isas[i], 1);
+      if ((c = cache_new(s, E, b)) == NULL) {
+        fputs("csim-bench: cannot create the cache\n", stderr);
+        exit(EXIT_FAILURE);
+      }
+      if (strcmp(c->isa, isas[i]) != 0) { // not supported here
+        cache_free(c);
+        continue;
+      }
+      name = c->isa;
+    }
+    result_t r = run(&src, s, E, b, c);
+    cache_free(c);
+    double accesses = (double)(trace ? src.trace_len : src.n) * src.repeat;
+    printf("%-10s %10.1f %10.2f %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+           name, accesses / r.secs / 1e6, r.secs / accesses * 1e9, r.hits,
+           r.misses, r.evictions);
+    if (i == 0) {
+      base = r;
+    } else if (r.hits != base.hits || r.misses != base.misses ||
+               r.evictions != base.evictions) {
+      fprintf(stderr, "csim-bench: %s counts differ from the old model\n",
+              name);
+      exit(EXIT_FAILURE);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,100 @@
+// csim-conv.c - Convert memory traces between the text and binary formats
+//
+// Usage: ./csim-conv [-hd] <in> <out>
+//
+// By default the input (in either format) is written as a binary trace;
+// with -d it is written as text in the format of valgrind's lackey tool.
+// See trace.h for both formats.
+#include "trace.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Output help message
+static void printUsage() {
+  puts("Usage: ./csim-conv [-hd] <in> <out>");
+  puts("Options:");
+  puts("  -h         Print this help message.");
+  puts("  -d         Write text instead of binary.");
+  puts("");
+  puts("Examples:");
+  puts(" linux>  ./csim-conv traces/long.trace long.ctr");
+  puts(" linux>  ./csim-conv -d long.ctr long.trace");
+}
+
+int main(int argc, char *argv[]) {
+  int text = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "hd")) != -1) {
+    switch (opt) {
+    case 'h':
+      printUsage();
+      exit(EXIT_SUCCESS);
+    case 'd':
+      text = 1;
+      break;
+    default:
+      printUsage();
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (argc - optind != 2) {
+    printUsage();
+    exit(EXIT_FAILURE);
+  }
+  char *in = argv[optind];
+  char *out = argv[optind + 1];
+
+  trace_t *t = trace_open(in);
+  if (t == NULL) {
+    perror(in);
+    exit(EXIT_FAILURE);
+  }
+  trace_writer_t *w = NULL;
+  FILE *fp = NULL;
+  if (text ? (fp = fopen(out, "w")) == NULL
+           : (w = trace_create(out)) == NULL) {
+    perror(out);
+    exit(EXIT_FAILURE);
+  }
+
+  trace_rec_t r;
+  long records = 0;
+  int more = 0, err = 0;
+  while (!err && (more = trace_next(t, &r)) > 0) {
+    if (text) {
+      err = fprintf(fp, r.op == 'I' ? "%c  %lx,%d\n" : " %c %lx,%d\n", r.op,
+                    (unsigned long)r.addr, r.size) < 0;
+    } else {
+      err = trace_write(w, &r) < 0;
+    }
+    ++records;
+  }
+  if (text ? fclose(fp) != 0 : trace_finish(w) < 0) {
+    err = 1;
+  }
+  if (err) {
+    perror(out);
+    exit(EXIT_FAILURE);
+  }
+  if (more < 0) {
+    fprintf(stderr, "%s: the trace is corrupt after %ld records\n", in,
+            records);
+    exit(EXIT_FAILURE);
+  }
+
+  FILE *done = fopen(out, "r");
+  long bytes = 0;
+  if (done != NULL && fseek(done, 0, SEEK_END) == 0) {
+    bytes = ftell(done);
+  }
+  if (done != NULL) {
+    fclose(done);
+  }
+  printf("%ld records, %lu -> %ld bytes (%.2f bytes per record)\n", records,
+         (unsigned long)trace_bytes(t), bytes,
+         records ? (double)bytes / records : 0.0);
+  trace_close(t);
+  return 0;
+}
@@ -0,0 +1,166 @@
+// csim-hier.c - Replay a trace through a multi-level cache hierarchy
+//
+// Usage: ./csim-hier [-h] -1 <level> [-I <level>] [-2 <level>] [-3 <level>]
+//                    -t <file>
+//
+// A level is "s,E,b" followed by any of the options ",wb" or ",wt"
+// (write-back or write-through, default wb), ",wa" or ",nwa" (write-allocate
+// or not, default wa) and, for L2 and L3, ",incl", ",excl" or ",nine"
+// (default nine). -1 gives the L1 data cache and -I an L1 instruction
+// cache, which receives the I records of the trace. See hier.h for the
+// model. For each level the table shows the reads and writes it received,
+// its misses, evictions, write-backs of dirty lines and (for inclusive
+// levels) back-invalidations, and then the traffic to memory.
+#include "hier.h"
+#include "trace.h"
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *names[HIER_LEVELS] = {"L1D", "L1I", "L2", "L3"};
+
+// Output help message
+static void printUsage() {
+  puts("Usage: ./csim-hier [-h] -1 <level> [-I <level>] [-2 <level>] "
+       "[-3 <level>] -t <file>");
+  puts("Options:");
+  puts("  -h          Print this help message.");
+  puts("  -1 <level>  L1 data cache.");
+  puts("  -I <level>  L1 instruction cache (I records are skipped without).");
+  puts("  -2 <level>  L2 cache.");
+  puts("  -3 <level>  L3 cache.");
+  puts("  -t <file>   Trace file, as text or binary.");
+  puts("A level is s,E,b[,wb|wt][,wa|nwa][,incl|excl|nine].");
+  puts("");
+  puts("Examples:");
+  puts(" linux>  ./csim-hier -1 5,1,5 -t traces/long.trace");
+  puts(" linux>  ./csim-hier -1 6,8,6 -I 6,8,6 -2 9,8,6,incl "
+       "-3 12,16,6,excl -t traces/trans.trace");
+}
+
+// Parse a level description; returns 0 if it is malformed
+static int parse_level(hier_level_t *lv, char *arg) {
+  if (sscanf(arg, "%d,%d,%d", &lv->s, &lv->E, &lv->b) != 3 || lv->s < 0 ||
+      lv->E <= 0 || lv->b < 0) {
+    return 0;
+  }
+  // The options follow the third field
+  char *opt = strchr(strchr(arg, ',') + 1, ',') + 1;
+  for (opt = strchr(opt, ','); opt != NULL; opt = strchr(opt + 1, ',')) {
+    char *name = opt + 1;
+    size_t len = strcspn(name, ",");
+    if (len == 2 && strncmp(name, "wb", 2) == 0) {
+      lv->write_back = 1;
+    } else if (len == 2 && strncmp(name, "wt", 2) == 0) {
+      lv->write_back = 0;
+    } else if (len == 2 && strncmp(name, "wa", 2) == 0) {
+      lv->write_alloc = 1;
+    } else if (len == 3 && strncmp(name, "nwa", 3) == 0) {
+      lv->write_alloc = 0;
+    } else if (len == 4 && strncmp(name, "incl", 4) == 0) {
+      lv->inclusion = HIER_INCLUSIVE;
+    } else if (len == 4 && strncmp(name, "excl", 4) == 0) {
+      lv->inclusion = HIER_EXCLUSIVE;
+    } else if (len == 4 && strncmp(name, "nine", 4) == 0) {
+      lv->inclusion = HIER_NINE;
+    } else {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  hier_t h;
+  char *path = NULL;
+  int opt, k;
+
+  for (k = 0; k < HIER_LEVELS; ++k) {
+    h.lv[k].s = -1;
+    h.lv[k].write_back = 1;
+    h.lv[k].write_alloc = 1;
+    h.lv[k].inclusion = HIER_NINE;
+  }
+  while ((opt = getopt(argc, argv, "h1:I:2:3:t:")) != -1) {
+    switch (opt) {
+    case 'h':
+      printUsage();
+      exit(EXIT_SUCCESS);
+    case '1':
+    case 'I':
+    case '2':
+    case '3':
+      k = opt == '1' ? HIER_L1D
+                     : opt == 'I' ? HIER_L1I : opt == '2' ? HIER_L2 : HIER_L3;
+      if (!parse_level(&h.lv[k], optarg)) {
+        fprintf(stderr, "csim-hier: bad level %s\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 't':
+      path = optarg;
+      break;
+    default:
+      printUsage();
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (path == NULL || h.lv[HIER_L1D].s < 0) {
+    printUsage();
+    exit(EXIT_FAILURE);
+  }
+  if (hier_init(&h) < 0) {
+    fputs("csim-hier: invalid levels (all need the same b)\n", stderr);
+    exit(EXIT_FAILURE);
+  }
+  trace_t *t = trace_open(path);
+  if (t == NULL) {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+
+  trace_rec_t r;
+  int more;
+  while ((more = trace_next(t, &r)) > 0) {
+    hier_access(&h, r.op, r.addr, r.size);
+  }
+  trace_close(t);
+  if (more < 0) {
+    fprintf(stderr, "%s: the trace is corrupt\n", path);
+    exit(EXIT_FAILURE);
+  }
+
+  printf("%-4s %-16s %10s %10s %10s %10s %10s %10s %10s %7s\n", "", "policy",
+         "reads", "writes", "rmisses", "wmisses", "evictions", "writebacks",
+         "backinval", "miss%");
+  for (k = 0; k < HIER_LEVELS; ++k) {
+    hier_level_t *lv = &h.lv[k];
+    char policy[32];
+    if (lv->c == NULL) {
+      continue;
+    }
+    snprintf(policy, sizeof(policy), "%s,%s%s", lv->write_back ? "wb" : "wt",
+             lv->write_alloc ? "wa" : "nwa",
+             k < HIER_L2 ? ""
+                         : lv->inclusion == HIER_INCLUSIVE
+                               ? ",incl"
+                               : lv->inclusion == HIER_EXCLUSIVE ? ",excl"
+                                                                 : ",nine");
+    uint64_t accesses = lv->reads + lv->writes;
+    printf("%-4s %-16s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+           " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %6.2f%%\n",
+           names[k], policy, lv->reads, lv->writes, lv->read_misses,
+           lv->write_misses, lv->evictions, lv->writebacks, lv->back_invals,
+           accesses ? 100.0 * (lv->read_misses + lv->write_misses) / accesses
+                    : 0.0);
+  }
+  uint64_t block = (uint64_t)1 << h.lv[HIER_L1D].b;
+  printf("memory: %" PRIu64 " block reads, %" PRIu64 " block writes, %" PRIu64
+         " stores; %" PRIu64 " bytes\n",
+         h.mem_reads, h.mem_writes, h.mem_stores,
+         (h.mem_reads + h.mem_writes) * block + h.mem_store_bytes);
+  hier_free(&h);
+  return 0;
+}
@@ -0,0 +1,248 @@
+// csim-sweep.c - Simulate many cache geometries in one pass over a trace
+//
+// Usage: ./csim-sweep [-h] -c <s>,<E>,<b> [-c ...] -t <file>
+//
+// Each -c adds configurations. Every field is a number or a range lo-hi,
+// so "-c 0-6,1-16,5" adds the 7 x 16 caches with 32-byte blocks. The
+// trace is read once. Configurations with the same s and b share one
+// simulation (Mattson's stack algorithm): a cache with the largest E of
+// the group records the LRU stack distance of every access, and an access
+// at distance d hits in every cache of that group with more than d lines
+// per set. The cost of a sweep thus grows with the number of (s, b)
+// pairs, not with the number of configurations.
+//
+// The hits, misses and evictions printed for each configuration are the
+// ones csim prints for it.
+#define _POSIX_C_SOURCE 200112L
+#include "cache.h"
+#include "trace.h"
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  int s, E, b;
+} config_t;
+
+// Configurations with the same s and b, simulated together
+typedef struct {
+  int s, b;
+  int E;           // the largest E of the group
+  cache_t *c;      // a cache of that many lines per set
+  uint64_t *hist;  // hist[d]: accesses at stack distance d < E
+} group_t;
+
+static config_t *configs = NULL;
+static int num_configs = 0;
+static int cap_configs = 0;
+
+// Output help message
+static void printUsage() {
+  puts("Usage: ./csim-sweep [-h] -c <s>,<E>,<b> [-c ...] -t <file>");
+  puts("Options:");
+  puts("  -h               Print this help message.");
+  puts("  -c <s>,<E>,<b>   Add caches; each field is a number or a range "
+       "lo-hi.");
+  puts("  -t <file>        Trace file, as text or binary.");
+  puts("");
+  puts("Examples:");
+  puts(" linux>  ./csim-sweep -c 5,1,5 -c 4,2,4 -t traces/long.trace");
+  puts(" linux>  ./csim-sweep -c 0-8,1-32,4-6 -t traces/long.trace");
+}
+
+// Parse "n" or "lo-hi" up to the next comma; returns the rest or NULL
+static char *parse_range(char *str, int *lo, int *hi) {
+  char *end;
+  *lo = *hi = (int)strtol(str, &end, 10);
+  if (end == str) {
+    return NULL;
+  }
+  if (*end == '-') {
+    str = end + 1;
+    *hi = (int)strtol(str, &end, 10);
+    if (end == str || *hi < *lo) {
+      return NULL;
+    }
+  }
+  return *end == ',' ? end + 1 : (*end == '\0' ? end : NULL);
+}
+
+// Add the configurations of one -c argument; returns 0 if it is malformed
+static int add_configs(char *arg) {
+  int s0, s1, e0, e1, b0, b1;
+  char *p = arg;
+
+  if ((p = parse_range(p, &s0, &s1)) == NULL || *p == '\0' ||
+      (p = parse_range(p, &e0, &e1)) == NULL || *p == '\0' ||
+      (p = parse_range(p, &b0, &b1)) == NULL || *p != '\0') {
+    return 0;
+  }
+  if (s0 < 0 || e0 < 1 || b0 < 0 || s1 + b1 >= 48 || s0 + b0 < 1) {
+    return 0;
+  }
+  for (int s = s0; s <= s1; ++s) {
+    for (int e = e0; e <= e1; ++e) {
+      for (int b = b0; b <= b1; ++b) {
+        if (num_configs == cap_configs) {
+          cap_configs = cap_configs ? 2 * cap_configs : 64;
+          configs = (config_t *)realloc(configs, cap_configs * sizeof(config_t));
+        }
+        configs[num_configs].s = s;
+        configs[num_configs].E = e;
+        configs[num_configs].b = b;
+        ++num_configs;
+      }
+    }
+  }
+  return 1;
+}
+
+// Order by s, b and then E, so that a group is a run of the array
+static int cmp_config(const void *x, const void *y) {
+  const config_t *a = (const config_t *)x;
+  const config_t *b = (const config_t *)y;
+  if (a->s != b->s) {
+    return a->s - b->s;
+  }
+  if (a->b != b->b) {
+    return a->b - b->b;
+  }
+  return a->E - b->E;
+}
+
+int main(int argc, char *argv[]) {
+  char *path = NULL;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "hc:t:")) != -1) {
+    switch (opt) {
+    case 'h':
+      printUsage();
+      exit(EXIT_SUCCESS);
+    case 'c':
+      if (!add_configs(optarg)) {
+        fprintf(stderr, "csim-sweep: bad configuration %s\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 't':
+      path = optarg;
+      break;
+    default:
+      printUsage();
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (num_configs == 0 || path == NULL) {
+    printUsage();
+    exit(EXIT_FAILURE);
+  }
+  trace_t *t = trace_open(path);
+  if (t == NULL) {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+
+  // Drop duplicates and form the groups
+  qsort(configs, num_configs, sizeof(config_t), cmp_config);
+  int n = 0;
+  for (int i = 0; i < num_configs; ++i) {
+    if (n == 0 || cmp_config(&configs[n - 1], &configs[i]) != 0) {
+      configs[n++] = configs[i];
+    }
+  }
+  num_configs = n;
+  group_t *groups = (group_t *)calloc(num_configs, sizeof(group_t));
+  int num_groups = 0;
+  for (int i = 0; i < num_configs; ++i) {
+    config_t *cf = &configs[i];
+    if (num_groups == 0 || groups[num_groups - 1].s != cf->s ||
+        groups[num_groups - 1].b != cf->b) {
+      groups[num_groups].s = cf->s;
+      groups[num_groups].b = cf->b;
+      ++num_groups;
+    }
+    groups[num_groups - 1].E = cf->E; // sorted, so the largest comes last
+  }
+  for (int g = 0; g < num_groups; ++g) {
+    group_t *gr = &groups[g];
+    gr->c = cache_new(gr->s, gr->E, gr->b);
+    gr->hist = (uint64_t *)calloc(gr->E, sizeof(uint64_t));
+    if (gr->c == NULL || gr->hist == NULL) {
+      fprintf(stderr, "csim-sweep: cannot create a cache with s=%d E=%d b=%d\n",
+              gr->s, gr->E, gr->b);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // The pass over the trace
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  uint64_t accesses = 0, modifies = 0;
+  trace_rec_t r;
+  int more;
+  while ((more = trace_next(t, &r)) > 0) {
+    if (r.op == 'I') {
+      continue;
+    }
+    ++accesses;
+    modifies += r.op == 'M'; // the store hits in every cache
+    for (int g = 0; g < num_groups; ++g) {
+      int d = cache_access_rank(groups[g].c, r.addr);
+      if (d >= 0) {
+        ++groups[g].hist[d];
+      }
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  trace_close(t);
+  if (more < 0) {
+    fprintf(stderr, "%s: the trace is corrupt\n", path);
+    exit(EXIT_FAILURE);
+  }
+
+  // A cache of E lines per set hits at the distances below E. It misses
+  // without evicting once for each line it fills, which is, per set, E or
+  // the number of distinct blocks if that is smaller.
+  printf("%4s %5s %4s %12s %12s %12s %12s %7s\n", "s", "E", "b", "bytes",
+         "hits", "misses", "evictions", "miss%");
+  group_t *gr = groups;
+  uint64_t below = 0;
+  int d = 0;
+  for (int i = 0; i < num_configs; ++i) {
+    config_t *cf = &configs[i];
+    if (cf->s != gr->s || cf->b != gr->b) {
+      ++gr;
+      below = 0;
+      d = 0;
+    }
+    for (; d < cf->E; ++d) {
+      below += gr->hist[d];
+    }
+    uint64_t fills = 0;
+    for (uint64_t set = 0; set < (uint64_t)1 << cf->s; ++set) {
+      int lines = cache_set_lines(gr->c, set);
+      fills += lines < cf->E ? lines : cf->E;
+    }
+    uint64_t misses = accesses - below;
+    printf("%4d %5d %4d %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64
+           " %6.2f%%\n",
+           cf->s, cf->E, cf->b, ((uint64_t)cf->E << (cf->s + cf->b)),
+           below + modifies, misses, misses - fills,
+           accesses ? 100.0 * misses / (accesses + modifies) : 0.0);
+  }
+  printf("# %" PRIu64 " accesses, %d configurations, %d simulations, %.3f s\n",
+         accesses, num_configs, num_groups,
+         (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9);
+
+  for (int g = 0; g < num_groups; ++g) {
+    cache_free(groups[g].c);
+    free(groups[g].hist);
+  }
+  free(groups);
+  free(configs);
+  return 0;
+}
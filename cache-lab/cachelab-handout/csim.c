@@ -1,105 +1,124 @@
+#include "attrib.h"
+#include "cache.h"
 #include "cachelab.h"
+#include "policy.h"
+#include "prefetch.h"
+#include "shard.h"
+#include "trace.h"
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-// Define global parameters counting the performance
-int hits = 0;
-int misses = 0;
-int evictions = 0;
-// Define a timestamp to record the point
-int tt = 0;
-
-// Define structure of cache line
-struct cache_line {
-  char valid;
-  int tag;
-  int time_stamp;
-};
-
-// Define cache line
-typedef struct cache_line line;
-
-// Define cache set
-typedef line *set;
-
-// Define cache cache
-typedef set *cache;
-
-// Load, store or modify the data with cache
-// Return 0 if miss, 1 if hit, 2 if eviction happened
-char useCache(cache cc, unsigned int index, int tag, int lines_per_set,
-              char modify) {
-  set st = cc[index];
-  unsigned int line_index = 0;
-  int line_time_stamp = st[0].time_stamp;
-
-  for (int i = 0; i < lines_per_set; ++i) {
-    line *tmp = &st[i];
-    // hit
-    if (tmp->valid && tmp->tag == tag) {
-      if (modify) {
-        ++hits;
-      }
-      ++hits;
-      tmp->time_stamp = ++tt;
-      return 1;
-    }
-    // record the least recent used block or empty block
-    if (tmp->time_stamp < line_time_stamp) {
-      line_index = i;
-      line_time_stamp = tmp->time_stamp;
-    }
-  }
-
-  // miss
-  ++misses;
-  if (modify) {
-    ++hits;
-  }
-  // evict the least recent used block or fill in the empty block
-  line *chosen = &st[line_index];
-  chosen->tag = tag;
-  chosen->time_stamp = ++tt;
-  if (chosen->valid) {
-    ++evictions;
-    return 2;
-  } else {
-    chosen->valid = 1;
-    return 0;
-  }
-}
-
-// Initialize cache
-cache getCache(int lines_per_set, int set_index_bits) {
-  int length = 1 << set_index_bits;
-  cache res = (cache)malloc(sizeof(set) * length);
-  for (int i = 0; i < length; ++i) {
-    res[i] = (set)malloc(sizeof(line) * lines_per_set);
-    for (int j = 0; j < lines_per_set; ++j) {
-      line *tmp = &res[i][j];
-      tmp->valid = 0;
-      tmp->tag = 0;
-      tmp->time_stamp = 0;
-    }
-  }
-  return res;
-}
-
 // Output help message
 void printUsage() {
-  puts("Usage: ./csim [-hv] -s <num> -E <num> -b <num> -t <file>");
+  puts("Usage: ./csim [-hv] -s <num> -E <num> -b <num> [-p <policy>]");
+  puts("              [-j <num>] [-a <num>] [-m <file>] [-P <prefetcher>]");
+  puts("              [-d <num>] [-L <num>] -t <file>");
   puts("Options:");
   puts("  -h         Print this help message.");
   puts("  -v         Optional verbose flag.");
   puts("  -s <num>   Number of set index bits.");
   puts("  -E <num>   Number of lines per set.");
   puts("  -b <num>   Number of block offset bits.");
-  puts("  -t <file>  Trace file.");
+  puts("  -p <name>  Replacement policy: lru (default), plru, fifo, random,");
+  puts("             srrip, brrip or opt (see policy.h).");
+  puts("  -j <num>   Threads, each simulating some of the sets (lru without");
+  puts("             -v only; see shard.h).");
+  puts("  -a <num>   Report where the misses come from, listing the top");
+  puts("             <num> sets, blocks and rows (see attrib.h).");
+  puts("  -m <file>  Map of named address ranges for -a.");
+  puts("  -P <name>  Prefetcher: nextline, stream or stride (lru only; see");
+  puts("             prefetch.h).");
+  puts("  -d <num>   Prefetch degree (default 2).");
+  puts("  -L <num>   Prefetch latency in data accesses (default 0).");
+  puts("  -t <file>  Trace file, as text or binary (see csim-conv).");
   puts("");
   puts("Examples:");
   puts(" linux>  ./csim -s 4 -E 1 -b 4 -t traces/yi.trace");
   puts(" linux>  ./csim -v -s 8 -E 2 -b 4 -t traces/yi.trace");
+  puts(" linux>  ./csim -s 4 -E 4 -b 4 -p opt -t traces/long.trace");
+  puts(" linux>  ./csim -s 10 -E 8 -b 6 -j 4 -t big.ctr");
+  puts(" linux>  ./csim -s 5 -E 1 -b 5 -a 8 -m trans.map -t trace.f0");
+  puts(" linux>  ./csim -s 6 -E 8 -b 6 -P stride -d 4 -t traces/long.trace");
+}
+
+// The cache in use: c for lru, pc for the other policies
+static cache_t *c = NULL;
+static policy_cache_t *pc = NULL;
+static attrib_t *attr = NULL;
+static prefetch_t *pf = NULL;
+static uint64_t last_pc = 0; // address of the latest 'I' record
+static int v = 0;
+
+// Simulate the data access r; next_use is the index of the next access to
+// its block, for opt
+static void simulate(const trace_rec_t *r, uint64_t next_use) {
+  int res;
+  const char *str;
+
+  if (pf != NULL) {
+    res = prefetch_access(pf, r->addr, last_pc);
+  } else if (pc != NULL) {
+    res = policy_access(pc, r->addr, next_use);
+  } else {
+    res = cache_access(c, r->addr);
+  }
+  if (res < 0) {
+    fputs("csim: out of memory\n", stderr);
+    exit(EXIT_FAILURE);
+  }
+  if (r->op == 'M') {
+    // The store always hits the line that the load brought in
+    if (pc != NULL) {
+      ++pc->hits;
+    } else {
+      ++c->hits;
+    }
+    str = res == CACHE_HIT
+              ? "hit hit"
+              : (res == CACHE_MISS ? "miss hit" : "miss eviction hit");
+  } else {
+    str = res == CACHE_HIT ? "hit"
+                           : (res == CACHE_MISS ? "miss" : "miss eviction");
+  }
+  if (v) {
+    printf("%c %lx,%d %s\n", r->op, (unsigned long)r->addr, r->size, str);
+  }
+  if (attr != NULL &&
+      (attrib_access(attr, r->addr, res != CACHE_HIT) < 0 ||
+       (r->op == 'M' && attrib_access(attr, r->addr, 0) < 0))) {
+    fputs("csim: out of memory\n", stderr);
+    exit(EXIT_FAILURE);
+  }
+}
+
+// Read the data accesses of t into *recs; returns their number, or -1 if
+// the trace is corrupt or memory runs out
+static long load(trace_t *t, trace_rec_t **recs) {
+  size_t n = 0, cap = 1 << 16;
+  trace_rec_t *a = (trace_rec_t *)malloc(cap * sizeof(trace_rec_t));
+  int more = 0;
+
+  while (a != NULL && (more = trace_next(t, &a[n])) > 0) {
+    if (a[n].op == 'I') {
+      continue;
+    }
+    if (++n == cap) {
+      trace_rec_t *grown =
+          (trace_rec_t *)realloc(a, 2 * cap * sizeof(trace_rec_t));
+      if (grown == NULL) {
+        free(a);
+      }
+      a = grown;
+      cap *= 2;
+    }
+  }
+  if (a == NULL || more < 0) {
+    free(a);
+    return -1;
+  }
+  *recs = a;
+  return (long)n;
 }
 
 int main(int argc, char *argv[]) {
@@ -110,15 +129,21 @@ int main(int argc, char *argv[]) {
   }
 
   // Define input arguments
-  int v = 0;
   int s = -1;
   int e = -1;
   int b = -1;
-  FILE *t = NULL;
+  int policy = POLICY_LRU;
+  int threads = 1;
+  int top = 0;
+  const char *map = NULL;
+  int prefetcher = -1;
+  int degree = 2;
+  int latency = 0;
+  trace_t *t = NULL;
 
   // Read arguments
   int opt;
-  while ((opt = getopt(argc, argv, "hvs:E:b:t:")) != -1) {
+  while ((opt = getopt(argc, argv, "hvs:E:b:p:j:a:m:P:d:L:t:")) != -1) {
     switch (opt) {
     case 'h':
       printUsage();
@@ -135,8 +160,32 @@ int main(int argc, char *argv[]) {
     case 'b':
       b = atoi(optarg);
       break;
+    case 'p':
+      policy = policy_parse(optarg);
+      break;
+    case 'j':
+      threads = atoi(optarg);
+      break;
+    case 'a':
+      top = atoi(optarg);
+      break;
+    case 'm':
+      map = optarg;
+      break;
+    case 'P':
+      if ((prefetcher = prefetch_parse(optarg)) < 0) {
+        printUsage();
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'd':
+      degree = atoi(optarg);
+      break;
+    case 'L':
+      latency = atoi(optarg);
+      break;
     case 't':
-      t = fopen(optarg, "r");
+      t = trace_open(optarg);
       break;
     default:
       // Read undefined option
@@ -146,50 +195,118 @@ int main(int argc, char *argv[]) {
   }
 
   // Verify arguments
-  if (s <= 0 || e <= 0 || b <= 0 || t == NULL) {
+  if (s <= 0 || e <= 0 || b <= 0 || policy < 0 || threads <= 0 ||
+      top < 0 || (map != NULL && top == 0) || degree < 1 || latency < 0 ||
+      t == NULL) {
     printUsage();
     exit(EXIT_FAILURE);
   }
 
-  cache c = getCache(e, s);
-  // Read from file and process with cache
-  char operation;
-  unsigned long address;
-  int size;
-  unsigned int index;
-  int tag;
-  char res;
-  char *str;
-  while (fscanf(t, " %c %lx,%d\n", &operation, &address, &size) == 3) {
-    index = (address >> b) & ((1 << s) - 1);
-    tag = address >> (b + s);
-    switch (operation) {
-    case 'I':
-      continue;
-    case 'S':
-    case 'L':
-      res = useCache(c, index, tag, e, 0);
-      if (v) {
-        str = res == 1 ? "hit" : (res == 0 ? "miss" : "miss eviction");
-        printf("%c %lx,%d %s\n", operation, address, size, str);
+  if (threads > 1) {
+    if (policy != POLICY_LRU || v || top > 0 || prefetcher >= 0) {
+      fputs("csim: -j needs the lru policy and no -v, -a or -P\n", stderr);
+      exit(EXIT_FAILURE);
+    }
+    uint64_t hits, misses, evictions;
+    int res = shard_replay(t, s, e, b, threads, &hits, &misses, &evictions);
+    trace_close(t);
+    if (res < 0) {
+      fputs(res == -1 ? "csim: the trace is corrupt\n"
+                      : "csim: cannot create the caches or threads\n",
+            stderr);
+      exit(EXIT_FAILURE);
+    }
+    printSummary(hits, misses, evictions);
+    return 0;
+  }
+
+  if (prefetcher >= 0 && policy != POLICY_LRU) {
+    fputs("csim: -P needs the lru policy\n", stderr);
+    exit(EXIT_FAILURE);
+  }
+
+  // lru keeps to cache.c, which is faster than policy.c's
+  if (policy == POLICY_LRU) {
+    c = cache_new(s, e, b);
+  } else {
+    pc = policy_new(s, e, b, policy);
+  }
+  if (c == NULL && pc == NULL) {
+    if (policy == POLICY_PLRU) {
+      fputs("csim: plru needs E a power of 2 up to 64\n", stderr);
+    } else {
+      fputs("csim: cannot create the cache\n", stderr);
+    }
+    exit(EXIT_FAILURE);
+  }
+  if (c != NULL && prefetcher >= 0 &&
+      (pf = prefetch_new(c, prefetcher, degree, latency)) == NULL) {
+    fputs("csim: out of memory\n", stderr);
+    exit(EXIT_FAILURE);
+  }
+  if (top > 0 && (attr = attrib_new(s, e, b, map)) == NULL) {
+    exit(EXIT_FAILURE);
+  }
+
+  if (policy == POLICY_OPT) {
+    // opt looks ahead, so the whole trace is read first
+    trace_rec_t *recs = NULL;
+    long n = load(t, &recs);
+    trace_close(t);
+    uint64_t *addrs = n >= 0 ? (uint64_t *)malloc((n + 1) * sizeof(uint64_t))
+                             : NULL;
+    uint64_t *next = NULL;
+    if (addrs != NULL) {
+      for (long i = 0; i < n; ++i) {
+        addrs[i] = recs[i].addr;
       }
-      break;
-    case 'M':
-      res = useCache(c, index, tag, e, 1);
-      if (v) {
-        str = res == 1 ? "hit hit"
-                       : (res == 0 ? "miss hit" : "miss eviction hit");
-        printf("%c %lx,%d %s\n", operation, address, size, str);
+      next = policy_next_uses(addrs, (size_t)n, b);
+    }
+    if (next == NULL) {
+      fputs(n < 0 ? "csim: the trace is corrupt or too large\n"
+                  : "csim: out of memory\n",
+            stderr);
+      exit(EXIT_FAILURE);
+    }
+    for (long i = 0; i < n; ++i) {
+      simulate(&recs[i], next[i]);
+    }
+    free(recs);
+    free(addrs);
+    free(next);
+  } else {
+    // Read from file and process with cache
+    trace_rec_t r;
+    int more;
+    while ((more = trace_next(t, &r)) > 0) {
+      if (r.op != 'I') {
+        simulate(&r, POLICY_NEVER);
+      } else {
+        last_pc = r.addr;
       }
-      break;
+    }
+    trace_close(t);
+    if (more < 0) {
+      fputs("csim: the trace is corrupt\n", stderr);
+      exit(EXIT_FAILURE);
     }
   }
 
-  // Remember to free up resource
-  free(c);
-  fclose(t);
-
   // Output the result
-  printSummary(hits, misses, evictions);
+  if (pc != NULL) {
+    printSummary(pc->hits, pc->misses, pc->evictions);
+    policy_free(pc);
+  } else {
+    printSummary(c->hits, c->misses, c->evictions);
+  }
+  if (pf != NULL) {
+    prefetch_report(pf, stdout);
+    prefetch_free(pf);
+  }
+  if (attr != NULL) {
+    attrib_report(attr, stdout, top);
+    attrib_free(attr);
+  }
+  cache_free(c);
   return 0;
 }
@@ -0,0 +1,210 @@
+// hier.c - A multi-level cache hierarchy on top of cache.c (see hier.h)
+#include "hier.h"
+#include <stddef.h>
+
+static void fill(hier_t *h, int k, uint64_t addr, int dirty);
+static void writeback(hier_t *h, int k, uint64_t addr);
+
+// The level below level k, skipping absent ones
+static int next_level(const hier_t *h, int k) {
+  for (k = k == HIER_L1D ? HIER_L2 : k + 1; k < HIER_LEVELS; ++k) {
+    if (h->lv[k].c != NULL) {
+      return k;
+    }
+  }
+  return HIER_MEM;
+}
+
+int hier_init(hier_t *h) {
+  int b = h->lv[HIER_L1D].b;
+
+  if (h->lv[HIER_L1D].s < 0) {
+    return -1;
+  }
+  for (int k = 0; k < HIER_LEVELS; ++k) {
+    hier_level_t *lv = &h->lv[k];
+    lv->c = NULL;
+    if (lv->s < 0) {
+      continue;
+    }
+    if (lv->b != b || (lv->c = cache_new(lv->s, lv->E, lv->b)) == NULL) {
+      hier_free(h);
+      return -1;
+    }
+    if (k <= HIER_L1I) {
+      lv->inclusion = HIER_NINE; // nothing above the first level
+    }
+    if (k == HIER_L1I) {
+      lv->write_back = 1;        // nothing is ever written to it
+    }
+    lv->reads = lv->writes = lv->read_misses = lv->write_misses = 0;
+    lv->evictions = lv->writebacks = lv->back_invals = 0;
+  }
+  h->mem_reads = h->mem_writes = h->mem_stores = h->mem_store_bytes = 0;
+  return 0;
+}
+
+void hier_free(hier_t *h) {
+  for (int k = 0; k < HIER_LEVELS; ++k) {
+    cache_free(h->lv[k].c);
+    h->lv[k].c = NULL;
+  }
+}
+
+// Level k is asked for the block of addr by a level above it. Returns 1
+// if the block handed up is dirty, which only an exclusive level does:
+// it gives its copy away.
+static int fetch(hier_t *h, int k, uint64_t addr) {
+  if (k == HIER_MEM) {
+    ++h->mem_reads;
+    return 0;
+  }
+  hier_level_t *lv = &h->lv[k];
+  ++lv->reads;
+  if (cache_lookup(lv->c, addr, 0)) {
+    return lv->inclusion == HIER_EXCLUSIVE ? cache_invalidate(lv->c, addr) : 0;
+  }
+  ++lv->read_misses;
+  int dirty = fetch(h, next_level(h, k), addr);
+  if (lv->inclusion == HIER_EXCLUSIVE) {
+    return dirty; // passes through without being kept
+  }
+  fill(h, k, addr, dirty);
+  return 0;
+}
+
+// An inclusive level k evicted the block at victim: drop it from every
+// level above. Returns 1 if one of them held it dirty.
+static int back_invalidate(hier_t *h, int k, uint64_t victim) {
+  int dirty = 0;
+  for (int j = 0; j < k; ++j) {
+    if (h->lv[j].c != NULL) {
+      int d = cache_invalidate(h->lv[j].c, victim);
+      if (d >= 0) {
+        ++h->lv[k].back_invals;
+        dirty |= d;
+      }
+    }
+  }
+  return dirty;
+}
+
+// Level k receives a line evicted from the level above it
+static void take_victim(hier_t *h, int k, uint64_t victim, int dirty) {
+  if (k == HIER_MEM) {
+    h->mem_writes += dirty;
+    return;
+  }
+  hier_level_t *lv = &h->lv[k];
+  if (lv->inclusion == HIER_EXCLUSIVE) {
+    // A victim cache keeps clean victims as well as dirty ones, unless the
+    // other first-level cache still holds the block
+    for (int j = 0; j < k; ++j) {
+      if (h->lv[j].c != NULL && cache_contains(h->lv[j].c, victim)) {
+        if (dirty) {
+          writeback(h, next_level(h, k), victim);
+        }
+        return;
+      }
+    }
+    lv->writes += dirty;
+    if (!cache_lookup(lv->c, victim, dirty && lv->write_back)) {
+      fill(h, k, victim, dirty);
+    } else if (dirty && !lv->write_back) {
+      writeback(h, next_level(h, k), victim);
+    }
+  } else if (dirty) {
+    writeback(h, k, victim);
+  }
+}
+
+// Put the block of addr into level k and pass the line it replaces on
+static void fill(hier_t *h, int k, uint64_t addr, int dirty) {
+  hier_level_t *lv = &h->lv[k];
+  uint64_t victim;
+  int victim_dirty;
+
+  if (dirty && !lv->write_back) { // a write-through cache holds no dirty data
+    writeback(h, next_level(h, k), addr);
+    dirty = 0;
+  }
+  if (!cache_insert(lv->c, addr, dirty, &victim, &victim_dirty)) {
+    return;
+  }
+  ++lv->evictions;
+  if (lv->inclusion == HIER_INCLUSIVE) {
+    victim_dirty |= back_invalidate(h, k, victim);
+  }
+  lv->writebacks += victim_dirty;
+  take_victim(h, next_level(h, k), victim, victim_dirty);
+}
+
+// A whole dirty block arrives at level k. No fetch is needed, since the
+// block is overwritten in full.
+static void writeback(hier_t *h, int k, uint64_t addr) {
+  if (k == HIER_MEM) {
+    ++h->mem_writes;
+    return;
+  }
+  hier_level_t *lv = &h->lv[k];
+  ++lv->writes;
+  if (cache_lookup(lv->c, addr, lv->write_back)) {
+    if (!lv->write_back) {
+      writeback(h, next_level(h, k), addr);
+    }
+    return;
+  }
+  ++lv->write_misses;
+  if (lv->write_alloc && lv->inclusion != HIER_EXCLUSIVE) {
+    fill(h, k, addr, 1);
+  } else {
+    writeback(h, next_level(h, k), addr);
+  }
+}
+
+// A store of size bytes reaches level k
+static void store(hier_t *h, int k, uint64_t addr, int size) {
+  if (k == HIER_MEM) {
+    ++h->mem_stores;
+    h->mem_store_bytes += size;
+    return;
+  }
+  hier_level_t *lv = &h->lv[k];
+  ++lv->writes;
+  if (cache_lookup(lv->c, addr, lv->write_back)) {
+    if (!lv->write_back) {
+      store(h, next_level(h, k), addr, size);
+    }
+    return;
+  }
+  ++lv->write_misses;
+  if (!lv->write_alloc || lv->inclusion == HIER_EXCLUSIVE) {
+    store(h, next_level(h, k), addr, size);
+    return;
+  }
+  int dirty = fetch(h, next_level(h, k), addr);
+  fill(h, k, addr, dirty || lv->write_back);
+  if (!lv->write_back) {
+    store(h, next_level(h, k), addr, size);
+  }
+}
+
+void hier_access(hier_t *h, char op, uint64_t addr, int size) {
+  switch (op) {
+  case 'I':
+    if (h->lv[HIER_L1I].c != NULL) {
+      fetch(h, HIER_L1I, addr);
+    }
+    break;
+  case 'L':
+    fetch(h, HIER_L1D, addr);
+    break;
+  case 'S':
+    store(h, HIER_L1D, addr, size);
+    break;
+  case 'M':
+    fetch(h, HIER_L1D, addr);
+    store(h, HIER_L1D, addr, size);
+    break;
+  }
+}
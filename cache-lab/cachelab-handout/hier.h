@@ -0,0 +1,80 @@
+// hier.h - A multi-level cache hierarchy on top of cache.c
+//
+// The hierarchy has a first level split into a data cache (L1D) and an
+// optional instruction cache (L1I), then optionally L2 and L3, then
+// memory. Every level is LRU and all levels share one block size.
+//
+// Each level has a write policy:
+//
+// - write-back keeps stores in the line and writes dirty lines to the
+//   next level when they are evicted; write-through passes every store on
+//   at once and never holds dirty lines.
+// - write-allocate fetches the block on a store miss; no-write-allocate
+//   passes the store on without filling the line.
+//
+// Each level below L1 also has an inclusion policy towards the levels
+// above it:
+//
+// - inclusive: it holds every block the levels above hold, so evicting a
+//   block also invalidates it above (a back-invalidation);
+// - exclusive: it holds only blocks the levels above do not. It is filled
+//   by their victims, clean or dirty, and a hit moves the block up;
+// - non-inclusive (NINE, neither inclusive nor exclusive): fills go to
+//   every level on the way, and nothing is enforced.
+//
+// Loads and stores go to L1D and instruction fetches to L1I. A modify is
+// a load followed by a store.
+#ifndef HIER_H
+#define HIER_H
+
+#include "cache.h"
+#include <stdint.h>
+
+#define HIER_L1D 0
+#define HIER_L1I 1
+#define HIER_L2 2
+#define HIER_L3 3
+#define HIER_LEVELS 4
+#define HIER_MEM HIER_LEVELS // stands for memory as the next level
+
+#define HIER_NINE 0
+#define HIER_INCLUSIVE 1
+#define HIER_EXCLUSIVE 2
+
+// Configuration and counters of one level
+typedef struct {
+  int s, E, b;
+  int write_back;     // write-back rather than write-through
+  int write_alloc;    // write-allocate rather than no-write-allocate
+  int inclusion;      // HIER_NINE, HIER_INCLUSIVE or HIER_EXCLUSIVE
+  cache_t *c;         // NULL if the level is absent
+
+  uint64_t reads;       // loads, fetches and fills asked of this level
+  uint64_t writes;      // stores and write-backs that reach this level
+  uint64_t read_misses;
+  uint64_t write_misses;
+  uint64_t evictions;   // valid lines replaced
+  uint64_t writebacks;  // dirty lines written to the next level
+  uint64_t back_invals; // lines invalidated above by this (inclusive) level
+} hier_level_t;
+
+typedef struct {
+  hier_level_t lv[HIER_LEVELS];
+  uint64_t mem_reads;     // blocks read from memory
+  uint64_t mem_writes;    // blocks written back to memory
+  uint64_t mem_stores;    // stores written through to memory
+  uint64_t mem_store_bytes;
+} hier_t;
+
+// Fill in the configuration of the levels in h->lv (leave s at -1 for an
+// absent level), then call hier_init. Returns 0, or -1 if a level is
+// invalid, L1D is missing, or the block sizes differ.
+int hier_init(hier_t *h);
+
+void hier_free(hier_t *h);
+
+// Replay one trace record: op is 'I', 'L', 'S' or 'M'. Instruction
+// fetches are ignored if there is no L1I.
+void hier_access(hier_t *h, char op, uint64_t addr, int size);
+
+#endif
@@ -0,0 +1,114 @@
+// memrec.c - Thread sanitizer hooks that record into a cache (see memrec.h)
+#include "memrec.h"
+#include "cache.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/resource.h>
+
+static cache_t *cache = NULL;
+static FILE *out = NULL;
+static uintptr_t start_addr, end_addr;
+static uintptr_t stack_lo, stack_hi;
+static int recording = 0;
+static int done = 0;
+
+int memrec_open(int s, int E, int b, const volatile void *start,
+                const volatile void *end, const char *path) {
+  struct rlimit rl;
+  char here;
+
+  if ((cache = cache_new(s, E, b)) == NULL) {
+    return -1;
+  }
+  if (path != NULL && (out = fopen(path, "w")) == NULL) {
+    cache_free(cache);
+    cache = NULL;
+    return -1;
+  }
+  start_addr = (uintptr_t)start;
+  end_addr = (uintptr_t)end;
+
+  // The stack is taken to be the stack limit below this frame and a
+  // little above it, for the frames of the callers and the environment
+  uintptr_t limit = (uintptr_t)1 << 30;
+  if (getrlimit(RLIMIT_STACK, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY &&
+      rl.rlim_cur < limit) {
+    limit = rl.rlim_cur;
+  }
+  stack_hi = (uintptr_t)&here + ((uintptr_t)1 << 20);
+  stack_lo = (uintptr_t)&here - limit;
+  recording = done = 0;
+  return 0;
+}
+
+void memrec_close(uint64_t *hits, uint64_t *misses, uint64_t *evictions) {
+  recording = 0;
+  done = 1;
+  *hits = *misses = *evictions = 0;
+  if (cache != NULL) {
+    *hits = cache->hits;
+    *misses = cache->misses;
+    *evictions = cache->evictions;
+    cache_free(cache);
+    cache = NULL;
+  }
+  if (out != NULL) {
+    fclose(out);
+    out = NULL;
+  }
+}
+
+void memrec_start(void) { recording = cache != NULL; }
+
+void memrec_stop(void) { recording = 0; }
+
+static void record(char op, uintptr_t addr, int size) {
+  if (!recording) {
+    if (op != 'S' || addr != start_addr || start_addr == 0 || done ||
+        cache == NULL) {
+      return;
+    }
+    recording = 1;
+  }
+  if (addr < stack_lo || addr >= stack_hi) {
+    cache_access(cache, addr);
+    if (out != NULL) {
+      fprintf(out, " %c %" PRIxPTR ",%d\n", op, addr, size);
+    }
+  }
+  if (op == 'S' && addr == end_addr && end_addr != 0) {
+    recording = 0;
+    done = 1;
+  }
+}
+
+// The entry points gcc -fsanitize=thread calls. Function entry and exit
+// are not needed, nor is the runtime's initialization.
+void __tsan_init(void) {}
+void __tsan_func_entry(void *pc) {}
+void __tsan_func_exit(void) {}
+
+#define HOOKS(n)                                                               \
+  void __tsan_read##n(void *addr) { record('L', (uintptr_t)addr, n); }        \
+  void __tsan_write##n(void *addr) { record('S', (uintptr_t)addr, n); }       \
+  void __tsan_unaligned_read##n(void *addr) {                                  \
+    record('L', (uintptr_t)addr, n);                                           \
+  }                                                                            \
+  void __tsan_unaligned_write##n(void *addr) {                                 \
+    record('S', (uintptr_t)addr, n);                                           \
+  }
+
+HOOKS(1)
+HOOKS(2)
+HOOKS(4)
+HOOKS(8)
+HOOKS(16)
+
+void __tsan_read_range(void *addr, size_t size) {
+  record('L', (uintptr_t)addr, (int)size);
+}
+
+void __tsan_write_range(void *addr, size_t size) {
+  record('S', (uintptr_t)addr, (int)size);
+}
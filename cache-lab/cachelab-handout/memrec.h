@@ -0,0 +1,33 @@
+// memrec.h - Record the memory accesses of instrumented code into a cache
+//
+// Code compiled with gcc -fsanitize=thread calls __tsan_read4(addr),
+// __tsan_write4(addr) and so on before every load and store it makes.
+// memrec.c defines those hooks itself, so the thread sanitizer runtime is
+// never linked: the hooks feed the accesses straight into a cache.c model,
+// as valgrind's lackey trace fed csim-ref, in a fraction of the time.
+//
+// Like test-trans's filter of the lackey trace, recording starts at the
+// store to the start marker and ends with the store to the end marker,
+// both included, and skips accesses to the stack. Only the first such
+// window is recorded.
+#ifndef MEMREC_H
+#define MEMREC_H
+
+#include <stdint.h>
+
+// Simulate a cache of the given geometry over the window between the
+// stores to start and end, or, if they are NULL, between calls to
+// memrec_start and memrec_stop. If path is not NULL, the recorded accesses
+// are also written to it as a text trace. Returns 0, or -1 if the cache or
+// the file cannot be created.
+int memrec_open(int s, int E, int b, const volatile void *start,
+                const volatile void *end, const char *path);
+
+// Open and close the window by hand; it may be opened more than once
+void memrec_start(void);
+void memrec_stop(void);
+
+// Stop recording and return the counts the way csim counts them
+void memrec_close(uint64_t *hits, uint64_t *misses, uint64_t *evictions);
+
+#endif
@@ -0,0 +1,228 @@
+// policy.c - Replacement policies other than cache.c's LRU (see policy.h)
+#include "policy.h"
+#include "cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define VALID ((uint64_t)1 << 63)
+
+// Re-reference prediction values of srrip and brrip
+#define RRPV_MAX 3
+#define RRPV_LONG 2
+
+// brrip fills at RRPV_LONG once in this many fills
+#define BRRIP_EPSILON 32
+
+static const char *names[POLICY_COUNT] = {"lru",   "plru",  "fifo", "random",
+                                          "srrip", "brrip", "opt"};
+
+int policy_parse(const char *name) {
+  for (int i = 0; i < POLICY_COUNT; ++i) {
+    if (strcmp(name, names[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const char *policy_name(int policy) {
+  return policy >= 0 && policy < POLICY_COUNT ? names[policy] : "?";
+}
+
+policy_cache_t *policy_new(int s, int E, int b, int policy) {
+  if (s < 0 || b < 0 || E < 1 || s + b < 1 || s + b >= 64 || s >= 48 ||
+      policy < 0 || policy >= POLICY_COUNT) {
+    return NULL;
+  }
+  if (policy == POLICY_PLRU && (E > 64 || (E & (E - 1)) != 0)) {
+    return NULL;
+  }
+  policy_cache_t *c = (policy_cache_t *)calloc(1, sizeof(policy_cache_t));
+  if (c == NULL) {
+    return NULL;
+  }
+  size_t sets = (size_t)1 << s;
+  c->s = s;
+  c->E = E;
+  c->b = b;
+  c->policy = policy;
+  c->set_mask = sets - 1;
+  c->tags = (uint64_t *)calloc(sets * E, sizeof(uint64_t));
+  c->line = (uint64_t *)calloc(sets * E, sizeof(uint64_t));
+  c->set = (uint64_t *)calloc(sets, sizeof(uint64_t));
+  c->rng = 88172645463325252ULL;
+  if (c->tags == NULL || c->line == NULL || c->set == NULL) {
+    policy_free(c);
+    return NULL;
+  }
+  return c;
+}
+
+void policy_free(policy_cache_t *c) {
+  if (c != NULL) {
+    free(c->tags);
+    free(c->line);
+    free(c->set);
+    free(c);
+  }
+}
+
+static uint64_t next_random(policy_cache_t *c) {
+  c->rng ^= c->rng << 13; // xorshift64
+  c->rng ^= c->rng >> 7;
+  c->rng ^= c->rng << 17;
+  return c->rng;
+}
+
+// Turn the PLRU bits on the path to way w away from it
+static void plru_touch(policy_cache_t *c, uint64_t *bits, int w) {
+  int node = 1;
+  for (int half = c->E / 2; half > 0; half /= 2) {
+    int right = (w & half) != 0;
+    if (right) {
+      *bits &= ~((uint64_t)1 << node); // the left half is older now
+    } else {
+      *bits |= (uint64_t)1 << node;
+    }
+    node = 2 * node + right;
+  }
+}
+
+// Follow the PLRU bits to the victim
+static int plru_victim(policy_cache_t *c, uint64_t bits) {
+  int node = 1;
+  while (node < c->E) {
+    node = 2 * node + (int)((bits >> node) & 1);
+  }
+  return node - c->E;
+}
+
+// The way to evict from a full set; line points to the set's first line
+static int victim(policy_cache_t *c, uint64_t *line, uint64_t *set) {
+  int w = 0;
+  switch (c->policy) {
+  case POLICY_LRU:
+    for (int i = 1; i < c->E; ++i) {
+      if (line[i] < line[w]) {
+        w = i;
+      }
+    }
+    return w;
+  case POLICY_PLRU:
+    return plru_victim(c, *set);
+  case POLICY_FIFO:
+    w = (int)*set;
+    *set = (*set + 1) % c->E;
+    return w;
+  case POLICY_RANDOM:
+    return (int)(next_random(c) % c->E);
+  case POLICY_SRRIP:
+  case POLICY_BRRIP:
+    for (;;) {
+      for (int i = 0; i < c->E; ++i) {
+        if (line[i] >= RRPV_MAX) {
+          return i;
+        }
+      }
+      for (int i = 0; i < c->E; ++i) {
+        ++line[i];
+      }
+    }
+  default: // POLICY_OPT
+    for (int i = 1; i < c->E; ++i) {
+      if (line[i] > line[w]) {
+        w = i;
+      }
+    }
+    return w;
+  }
+}
+
+// Update the state of way w of a set for a hit (fill == 0) or a fill
+static void touch(policy_cache_t *c, uint64_t *line, uint64_t *set, int w,
+                  int fill, uint64_t next_use) {
+  switch (c->policy) {
+  case POLICY_LRU:
+    line[w] = c->clock;
+    break;
+  case POLICY_PLRU:
+    plru_touch(c, set, w);
+    break;
+  case POLICY_SRRIP:
+    line[w] = fill ? RRPV_LONG : 0;
+    break;
+  case POLICY_BRRIP:
+    line[w] = !fill ? 0
+                    : next_random(c) % BRRIP_EPSILON == 0 ? RRPV_LONG
+                                                          : RRPV_MAX;
+    break;
+  case POLICY_OPT:
+    line[w] = next_use;
+    break;
+  }
+}
+
+int policy_access(policy_cache_t *c, uint64_t addr, uint64_t next_use) {
+  uint64_t block = addr >> c->b;
+  uint64_t s = block & c->set_mask;
+  uint64_t key = (block >> c->s) | VALID;
+  uint64_t *tags = c->tags + s * c->E;
+  uint64_t *line = c->line + s * c->E;
+  uint64_t *set = c->set + s;
+  int w, empty = -1;
+
+  ++c->clock;
+  for (w = 0; w < c->E; ++w) {
+    if (tags[w] == key) {
+      ++c->hits;
+      touch(c, line, set, w, 0, next_use);
+      return CACHE_HIT;
+    }
+    if (empty < 0 && !(tags[w] & VALID)) {
+      empty = w;
+    }
+  }
+  ++c->misses;
+  int res = CACHE_MISS;
+  if (empty >= 0) {
+    w = empty;
+  } else {
+    w = victim(c, line, set);
+    ++c->evictions;
+    res = CACHE_EVICT;
+  }
+  tags[w] = key;
+  touch(c, line, set, w, 1, next_use);
+  return res;
+}
+
+uint64_t *policy_next_uses(const uint64_t *addrs, size_t n, int b) {
+  uint64_t *next = (uint64_t *)malloc((n ? n : 1) * sizeof(uint64_t));
+  // Open addressing from block + 1 (0 marks a free slot) to the index of
+  // its latest access seen, walking backwards
+  size_t cap = 16;
+  while (cap < 2 * n) {
+    cap *= 2;
+  }
+  uint64_t *keys = (uint64_t *)calloc(cap, sizeof(uint64_t));
+  uint64_t *seen = (uint64_t *)malloc(cap * sizeof(uint64_t));
+  if (next == NULL || keys == NULL || seen == NULL) {
+    free(next);
+    free(keys);
+    free(seen);
+    return NULL;
+  }
+  for (size_t i = n; i-- > 0;) {
+    uint64_t key = (addrs[i] >> b) + 1;
+    size_t h = (size_t)(key * 0x9e3779b97f4a7c15ULL) & (cap - 1);
+    while (keys[h] != 0 && keys[h] != key) {
+      h = (h + 1) & (cap - 1);
+    }
+    next[i] = keys[h] != 0 ? seen[h] : POLICY_NEVER;
+    keys[h] = key;
+    seen[h] = i;
+  }
+  free(keys);
+  free(seen);
+  return next;
+}
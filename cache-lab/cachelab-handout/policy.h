@@ -0,0 +1,80 @@
+// policy.h - Set-associative caches with replacement policies other than
+// the LRU of cache.c
+//
+// cache.c keeps each set in recency order, which makes LRU cheap but is of
+// no use to other policies. This model keeps the E lines of a set in
+// place, with a word of state per line and one per set:
+//
+// - lru: each line holds the time of its last use; the oldest is evicted.
+//   It gives the counts of cache.c, more slowly, as a check.
+// - plru: tree pseudo-LRU. A set has E - 1 bits, the inner nodes of a
+//   binary tree over the ways; each points to the half used less recently.
+//   An access turns the bits on its path away from it, and the victim is
+//   found by following them. E must be a power of 2 up to 64.
+// - fifo: the line filled first is evicted first, whatever its hits.
+// - random: any line, from a fixed-seed generator, so runs repeat.
+// - srrip: static re-reference interval prediction with 2-bit values. A
+//   hit sets the line's value to 0 and a fill to 2. The victim is a line
+//   at 3; if there is none, all values are aged by one until there is.
+// - brrip: bimodal RRIP, which fills at 3 and only one time in 32 at 2,
+//   so that a scan does not flush the lines that are reused.
+// - opt: Belady's optimal policy, which evicts the line used again
+//   furthest in the future. It needs the index of the next access to the
+//   block of every access, which policy_next_uses computes from the whole
+//   trace.
+//
+// Every policy fills an empty line, if its set has one, before evicting.
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define POLICY_LRU 0
+#define POLICY_PLRU 1
+#define POLICY_FIFO 2
+#define POLICY_RANDOM 3
+#define POLICY_SRRIP 4
+#define POLICY_BRRIP 5
+#define POLICY_OPT 6
+#define POLICY_COUNT 7
+
+// Next use of a block that is not used again
+#define POLICY_NEVER UINT64_MAX
+
+typedef struct {
+  int s, E, b;
+  int policy;
+  uint64_t set_mask;
+  uint64_t *tags;   // E per set, with the valid bit of cache.c
+  uint64_t *line;   // per line: time of last use, RRPV or next use
+  uint64_t *set;    // per set: PLRU bits or the next FIFO victim
+  uint64_t clock;   // accesses so far, for lru
+  uint64_t rng;     // for random and brrip
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+} policy_cache_t;
+
+// The number of a policy name ("lru", "plru", ...), or -1
+int policy_parse(const char *name);
+
+const char *policy_name(int policy);
+
+// Create a cache with 2^s sets of E lines of 2^b bytes; NULL if the
+// arguments are invalid for cache_new or the policy, or memory runs out
+policy_cache_t *policy_new(int s, int E, int b, int policy);
+
+void policy_free(policy_cache_t *c);
+
+// Access the block holding addr; returns CACHE_HIT, CACHE_MISS or
+// CACHE_EVICT and updates the counters. next_use is the index of the next
+// access to the same block, or POLICY_NEVER; only opt uses it.
+int policy_access(policy_cache_t *c, uint64_t addr, uint64_t next_use);
+
+// For the n accesses at addrs, the index of the next access to the same
+// block of 2^b bytes, or POLICY_NEVER: an array of n to free, or NULL if
+// memory runs out
+uint64_t *policy_next_uses(const uint64_t *addrs, size_t n, int b);
+
+#endif
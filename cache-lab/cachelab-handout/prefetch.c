@@ -0,0 +1,347 @@
+// prefetch.c - Next-line, stream and stride prefetchers (see prefetch.h)
+#include "prefetch.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QUEUE 64          // prefetches in flight
+#define STREAMS 16        // streams tracked
+#define STREAM_WINDOW 4   // blocks an access may be from its stream
+#define STRIDES 256       // entries of the stride table
+
+// A prefetch in flight
+typedef struct {
+  uint64_t block;
+  uint64_t ready;         // access count at which it is filled
+  int live;               // 0 once a demand miss has taken it over
+} request_t;
+
+typedef struct {
+  int64_t last;           // last block accessed
+  int64_t head;           // furthest block prefetched
+  int dir;                // +1, -1, or 0 while untrained
+  int conf;               // steps in dir seen in a row
+  uint64_t used;          // time of last use, for replacement
+} stream_t;
+
+typedef struct {
+  uint64_t pc;
+  uint64_t last;          // last address of this PC
+  int64_t stride;
+  int conf;               // 0 to 3
+  int valid;
+} stride_t;
+
+static const char *names[] = {"nextline", "stream", "stride"};
+
+struct prefetch {
+  cache_t *c;
+  int kind, degree, latency;
+  uint64_t now;           // demand accesses so far
+
+  request_t queue[QUEUE]; // a ring, in order of issue
+  int first, size;
+
+  // Blocks ever evicted by a prefetch fill (key block + 1, 0 for a free
+  // slot), flagged while they stay out of the cache
+  uint64_t *evicted;
+  uint8_t *polluted;
+  size_t cap, count;
+
+  stream_t streams[STREAMS];
+  stride_t strides[STRIDES];
+
+  uint64_t issued, dropped, useful, late, useless, evictions, pollution;
+};
+
+int prefetch_parse(const char *name) {
+  for (int i = 0; i < 3; ++i) {
+    if (strcmp(name, names[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+prefetch_t *prefetch_new(cache_t *c, int kind, int degree, int latency) {
+  if (kind < 0 || kind > PREFETCH_STRIDE || degree < 1 || latency < 0) {
+    return NULL;
+  }
+  prefetch_t *p = (prefetch_t *)calloc(1, sizeof(prefetch_t));
+  if (p == NULL) {
+    return NULL;
+  }
+  p->c = c;
+  p->kind = kind;
+  p->degree = degree;
+  p->latency = latency;
+  p->cap = 1024;
+  p->evicted = (uint64_t *)calloc(p->cap, sizeof(uint64_t));
+  p->polluted = (uint8_t *)calloc(p->cap, 1);
+  if (p->evicted == NULL || p->polluted == NULL) {
+    prefetch_free(p);
+    return NULL;
+  }
+  return p;
+}
+
+void prefetch_free(prefetch_t *p) {
+  if (p != NULL) {
+    free(p->evicted);
+    free(p->polluted);
+    free(p);
+  }
+}
+
+// The slot of key in the evicted table: its own, or the free one where
+// it belongs
+static size_t slot(const uint64_t *keys, size_t cap, uint64_t key) {
+  size_t h = (size_t)(key * 0x9e3779b97f4a7c15ULL) & (cap - 1);
+  while (keys[h] != 0 && keys[h] != key) {
+    h = (h + 1) & (cap - 1);
+  }
+  return h;
+}
+
+// Flag block as evicted by a prefetch; returns 0, or -1 if memory runs out
+static int mark_polluted(prefetch_t *p, uint64_t block) {
+  if (2 * (p->count + 1) > p->cap) {
+    size_t cap = 2 * p->cap;
+    uint64_t *keys = (uint64_t *)calloc(cap, sizeof(uint64_t));
+    uint8_t *flags = (uint8_t *)calloc(cap, 1);
+    if (keys == NULL || flags == NULL) {
+      free(keys);
+      free(flags);
+      return -1;
+    }
+    for (size_t i = 0; i < p->cap; ++i) {
+      if (p->evicted[i] != 0) {
+        size_t h = slot(keys, cap, p->evicted[i]);
+        keys[h] = p->evicted[i];
+        flags[h] = p->polluted[i];
+      }
+    }
+    free(p->evicted);
+    free(p->polluted);
+    p->evicted = keys;
+    p->polluted = flags;
+    p->cap = cap;
+  }
+  size_t h = slot(p->evicted, p->cap, block + 1);
+  if (p->evicted[h] == 0) {
+    p->evicted[h] = block + 1;
+    ++p->count;
+  }
+  p->polluted[h] = 1;
+  return 0;
+}
+
+// Clear the flag of block, which is being filled; returns the old flag
+static int clear_polluted(prefetch_t *p, uint64_t block) {
+  size_t h = slot(p->evicted, p->cap, block + 1);
+  int was = p->evicted[h] != 0 && p->polluted[h];
+  if (was) {
+    p->polluted[h] = 0;
+  }
+  return was;
+}
+
+// The queued request for block, or NULL
+static request_t *in_flight(prefetch_t *p, uint64_t block) {
+  for (int i = 0; i < p->size; ++i) {
+    request_t *r = &p->queue[(p->first + i) % QUEUE];
+    if (r->live && r->block == block) {
+      return r;
+    }
+  }
+  return NULL;
+}
+
+// Fill the requests that are ready; returns 0, or -1 if memory runs out
+static int drain(prefetch_t *p) {
+  while (p->size > 0 && p->queue[p->first].ready <= p->now) {
+    request_t *r = &p->queue[p->first];
+    p->first = (p->first + 1) % QUEUE;
+    --p->size;
+    if (!r->live) {
+      continue;
+    }
+    uint64_t addr = r->block << p->c->b, victim;
+    int victim_flag;
+    clear_polluted(p, r->block);
+    if (cache_insert(p->c, addr, 1, &victim, &victim_flag)) {
+      ++p->evictions;
+      p->useless += victim_flag;
+      if (mark_polluted(p, victim >> p->c->b) < 0) {
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+// Request a prefetch of block
+static int issue(prefetch_t *p, uint64_t block) {
+  if (cache_contains(p->c, block << p->c->b) || in_flight(p, block) != NULL ||
+      p->size == QUEUE) {
+    ++p->dropped;
+    return 0;
+  }
+  request_t *r = &p->queue[(p->first + p->size++) % QUEUE];
+  r->block = block;
+  r->ready = p->now + p->latency;
+  r->live = 1;
+  ++p->issued;
+  return drain(p);
+}
+
+// Train the stream table on block and prefetch ahead of its stream
+static int stream(prefetch_t *p, uint64_t block) {
+  int64_t b = (int64_t)block;
+  stream_t *s = NULL, *lru = &p->streams[0];
+
+  for (int i = 0; i < STREAMS; ++i) {
+    stream_t *t = &p->streams[i];
+    int64_t d = b - t->last;
+    if (t->used != 0 && d != 0 && d >= -STREAM_WINDOW &&
+        d <= STREAM_WINDOW) {
+      s = t;
+      break;
+    }
+    if (t->used < lru->used) {
+      lru = t;
+    }
+  }
+  if (s == NULL) {
+    memset(lru, 0, sizeof(stream_t));
+    lru->last = lru->head = b;
+    lru->used = p->now + 1;
+    return 0;
+  }
+  int dir = b > s->last ? 1 : -1;
+  if (dir == s->dir) {
+    s->conf += s->conf < 3;
+  } else {
+    s->dir = dir;
+    s->conf = 1;
+    s->head = b;
+  }
+  s->last = b;
+  s->used = p->now + 1;
+  if (s->conf < 2) {
+    return 0;
+  }
+  // Stay degree blocks ahead of the last access
+  for (int64_t next = b + dir; (next - b) * dir <= p->degree; next += dir) {
+    if ((next - s->head) * dir > 0 && next >= 0) {
+      s->head = next;
+      if (issue(p, (uint64_t)next) < 0) {
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+// Train the stride table on the access to addr by pc and prefetch
+static int stride(prefetch_t *p, uint64_t addr, uint64_t pc) {
+  stride_t *e =
+      &p->strides[(pc ^ (pc >> 8) ^ (pc >> 16)) % STRIDES];
+  if (!e->valid || e->pc != pc) {
+    memset(e, 0, sizeof(stride_t));
+    e->valid = 1;
+    e->pc = pc;
+    e->last = addr;
+    return 0;
+  }
+  int64_t d = (int64_t)(addr - e->last);
+  if (d == e->stride) {
+    e->conf += e->conf < 3;
+  } else if (e->conf > 0) {
+    --e->conf;
+  } else {
+    e->stride = d;
+  }
+  e->last = addr;
+  if (e->conf < 2 || e->stride == 0) {
+    return 0;
+  }
+  uint64_t prev = addr >> p->c->b;
+  for (int k = 1; k <= p->degree; ++k) {
+    uint64_t block = (addr + (uint64_t)(k * e->stride)) >> p->c->b;
+    if (block != prev && issue(p, block) < 0) {
+      return -1;
+    }
+    prev = block;
+  }
+  return 0;
+}
+
+int prefetch_access(prefetch_t *p, uint64_t addr, uint64_t pc) {
+  cache_t *c = p->c;
+  uint64_t block = addr >> c->b;
+  int res, flag;
+
+  ++p->now;
+  if (drain(p) < 0) {
+    return -1;
+  }
+  if ((flag = cache_touch(c, addr, 0)) >= 0) {
+    ++c->hits;
+    p->useful += flag;
+    res = CACHE_HIT;
+  } else {
+    uint64_t victim;
+    int victim_flag;
+    request_t *r = in_flight(p, block);
+    ++c->misses;
+    if (r != NULL) {
+      r->live = 0;
+      ++p->late;
+    }
+    p->pollution += clear_polluted(p, block);
+    res = CACHE_MISS;
+    if (cache_insert(c, addr, 0, &victim, &victim_flag)) {
+      ++c->evictions;
+      p->useless += victim_flag;
+      res = CACHE_EVICT;
+    }
+  }
+
+  // A miss or the first use of a prefetched line triggers the next-line
+  // and stream prefetchers; the stride one learns from every access
+  int trigger = res != CACHE_HIT || flag == 1;
+  int err = 0;
+  switch (p->kind) {
+  case PREFETCH_NEXTLINE:
+    for (int k = 1; trigger && k <= p->degree && err == 0; ++k) {
+      err = issue(p, block + k);
+    }
+    break;
+  case PREFETCH_STREAM:
+    err = trigger ? stream(p, block) : 0;
+    break;
+  case PREFETCH_STRIDE:
+    err = stride(p, addr, pc);
+    break;
+  }
+  return err < 0 ? -1 : res;
+}
+
+void prefetch_report(const prefetch_t *p, FILE *out) {
+  uint64_t misses = p->c->misses;
+  fprintf(out, "\n%s prefetcher, degree %d, latency %d:\n", names[p->kind],
+          p->degree, p->latency);
+  fprintf(out, "  issued     %10" PRIu64 " (%" PRIu64 " dropped)\n",
+          p->issued, p->dropped);
+  fprintf(out, "  useful     %10" PRIu64 "\n", p->useful);
+  fprintf(out, "  late       %10" PRIu64 "\n", p->late);
+  fprintf(out, "  useless    %10" PRIu64 "\n", p->useless);
+  fprintf(out, "  evictions  %10" PRIu64 "\n", p->evictions);
+  fprintf(out, "  pollution  %10" PRIu64 "\n", p->pollution);
+  fprintf(out, "  accuracy   %9.1f%%\n",
+          p->issued ? 100.0 * (p->useful + p->late) / p->issued : 0.0);
+  fprintf(out, "  coverage   %9.1f%%\n",
+          p->useful + misses ? 100.0 * p->useful / (p->useful + misses)
+                             : 0.0);
+}
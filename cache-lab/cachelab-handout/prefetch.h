@@ -0,0 +1,69 @@
+// prefetch.h - Hardware prefetchers in front of a cache.c cache
+//
+// csim -P adds one of three prefetchers to its LRU cache:
+//
+// - nextline: tagged next-line prefetching. A demand miss, or the first
+//   demand hit on a prefetched line, fetches the next degree blocks.
+// - stream: up to 16 streams. An access that misses or first hits a
+//   prefetched line joins the stream whose last block is within 4 blocks
+//   of it, or starts a new one in place of the least recently used.
+//   Two steps in the same direction confirm a stream, which then stays
+//   degree blocks ahead of its last access.
+// - stride: a table of 256 entries indexed by the PC of the access, taken
+//   from the latest 'I' record. Each entry learns the distance between
+//   successive addresses of its PC and, once the distance repeats, fetches
+//   degree distances ahead. Traces without 'I' records, such as those of
+//   tracegen-rec, have a single PC, which makes this a global stride
+//   prefetcher.
+//
+// Prefetches wait in a queue of up to 64 in-flight requests and are
+// filled latency data accesses after they are issued (0: before the next
+// access). A request for a block that is cached or in flight, or one that
+// finds the queue full, is dropped. A filled line carries the cache's
+// dirty flag, which csim does not otherwise use, until a demand access
+// uses it.
+//
+// Demand accesses update the cache's hits, misses and evictions as
+// cache_access would, so csim's summary counts only them. The prefetcher
+// counts the rest:
+//
+// - useful: prefetched lines later used by a demand access;
+// - late: demand misses on a block whose prefetch was still in flight;
+// - useless: prefetched lines evicted without being used;
+// - evictions: lines evicted by prefetch fills, kept apart from the
+//   demand evictions;
+// - pollution: demand misses on blocks that a prefetch fill evicted and
+//   nothing has brought back since.
+//
+// Accuracy is (useful + late) / issued. Coverage is useful / (useful +
+// demand misses), the share of the misses the prefetcher removed.
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include "cache.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define PREFETCH_NEXTLINE 0
+#define PREFETCH_STREAM 1
+#define PREFETCH_STRIDE 2
+
+typedef struct prefetch prefetch_t;
+
+// The number of a prefetcher name ("nextline", "stream", "stride"), or -1
+int prefetch_parse(const char *name);
+
+// Create a prefetcher of the given kind for c, which it then updates; NULL
+// if memory runs out or degree < 1 or latency < 0
+prefetch_t *prefetch_new(cache_t *c, int kind, int degree, int latency);
+
+void prefetch_free(prefetch_t *p);
+
+// A demand access to addr by the instruction at pc; returns CACHE_HIT,
+// CACHE_MISS or CACHE_EVICT like cache_access, or -1 if memory runs out
+int prefetch_access(prefetch_t *p, uint64_t addr, uint64_t pc);
+
+// Print the prefetcher's counts
+void prefetch_report(const prefetch_t *p, FILE *out);
+
+#endif
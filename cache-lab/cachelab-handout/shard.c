@@ -0,0 +1,149 @@
+// shard.c - Parallel trace replay by set (see shard.h)
+#include "shard.h"
+#include "cache.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+#define BATCH 8192 // accesses per batch
+#define RING 4     // batches per thread
+
+// One thread and the ring of batches it reads
+typedef struct {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;  // signals head, tail and done
+  uint64_t *buf;        // RING batches of BATCH entries
+  size_t len[RING];     // entries of each published batch
+  unsigned head, tail;  // batches published and consumed so far
+  int done;             // no batch follows those published
+  size_t n;             // entries in batch head % RING, being filled
+  cache_t *c;           // this thread's sets
+  uint64_t stores;      // stores of 'M' records, which always hit
+} worker_t;
+
+// An entry is the block number without the thread's bits, shifted left
+// once, with bit 0 set for an 'M' record
+static void *work(void *arg) {
+  worker_t *w = (worker_t *)arg;
+  int b = w->c->b;
+
+  for (;;) {
+    pthread_mutex_lock(&w->lock);
+    while (w->tail == w->head && !w->done) {
+      pthread_cond_wait(&w->cond, &w->lock);
+    }
+    if (w->tail == w->head) {
+      pthread_mutex_unlock(&w->lock);
+      return NULL;
+    }
+    unsigned i = w->tail % RING;
+    size_t len = w->len[i];
+    pthread_mutex_unlock(&w->lock);
+
+    const uint64_t *e = w->buf + (size_t)i * BATCH;
+    for (size_t j = 0; j < len; ++j) {
+      cache_access(w->c, (e[j] >> 1) << b);
+      w->stores += e[j] & 1;
+    }
+
+    pthread_mutex_lock(&w->lock);
+    ++w->tail;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+  }
+}
+
+// Hand the batch being filled to the thread. Unless it is the last, wait
+// until the ring has room for the next one.
+static void publish(worker_t *w, int last) {
+  pthread_mutex_lock(&w->lock);
+  if (w->n > 0) {
+    w->len[w->head % RING] = w->n;
+    ++w->head;
+    w->n = 0;
+  }
+  w->done = last;
+  pthread_cond_signal(&w->cond);
+  while (!last && w->head - w->tail == RING) {
+    pthread_cond_wait(&w->cond, &w->lock);
+  }
+  pthread_mutex_unlock(&w->lock);
+}
+
+int shard_threads(int s, int threads) {
+  int n = 1;
+  while (2 * n <= threads && n < (1 << 16) && (s >= 16 || n < (1 << s))) {
+    n *= 2;
+  }
+  return n;
+}
+
+int shard_replay(trace_t *t, int s, int E, int b, int threads,
+                 uint64_t *hits, uint64_t *misses, uint64_t *evictions) {
+  int n = shard_threads(s, threads);
+  int bits = 0;
+  while ((1 << bits) < n) {
+    ++bits;
+  }
+  worker_t *w = (worker_t *)calloc(n, sizeof(worker_t));
+  if (w == NULL) {
+    return -2;
+  }
+
+  int res = 0, started = 0;
+  for (; started < n; ++started) {
+    worker_t *x = &w[started];
+    x->buf = (uint64_t *)malloc(RING * BATCH * sizeof(uint64_t));
+    x->c = cache_new(s - bits, E, b);
+    if (x->buf == NULL || x->c == NULL) {
+      res = -2;
+      break;
+    }
+    pthread_mutex_init(&x->lock, NULL);
+    pthread_cond_init(&x->cond, NULL);
+    if (pthread_create(&x->thread, NULL, work, x) != 0) {
+      pthread_mutex_destroy(&x->lock);
+      pthread_cond_destroy(&x->cond);
+      res = -2;
+      break;
+    }
+  }
+
+  if (res == 0) {
+    uint64_t mask = (uint64_t)n - 1;
+    trace_rec_t r;
+    int more;
+    while ((more = trace_next(t, &r)) > 0) {
+      if (r.op == 'I') {
+        continue;
+      }
+      uint64_t block = r.addr >> b;
+      worker_t *x = &w[block & mask];
+      x->buf[(size_t)(x->head % RING) * BATCH + x->n] =
+          (block >> bits) << 1 | (r.op == 'M');
+      if (++x->n == BATCH) {
+        publish(x, 0);
+      }
+    }
+    if (more < 0) {
+      res = -1;
+    }
+  }
+
+  *hits = *misses = *evictions = 0;
+  for (int k = 0; k < started; ++k) {
+    publish(&w[k], 1);
+    pthread_join(w[k].thread, NULL);
+    pthread_mutex_destroy(&w[k].lock);
+    pthread_cond_destroy(&w[k].cond);
+    *hits += w[k].c->hits + w[k].stores;
+    *misses += w[k].c->misses;
+    *evictions += w[k].c->evictions;
+  }
+  for (int k = 0; k < n; ++k) {
+    free(w[k].buf);
+    cache_free(w[k].c);
+  }
+  free(w);
+  return res;
+}
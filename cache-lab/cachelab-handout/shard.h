@@ -0,0 +1,34 @@
+// shard.h - Replay a trace on several threads, each simulating some of the
+// sets
+//
+// An LRU set never affects another, so the sets can be split among
+// threads. With T = 2^t threads, thread k takes the sets whose low t index
+// bits are k. It simulates them in a cache.c cache of 2^(s - t) sets, fed
+// the block number with those t bits removed: the set index keeps its
+// upper s - t bits and the tag is unchanged. Every access therefore has
+// the result it would have in the whole cache, and the sums of the
+// threads' counts are exactly those of csim on one thread.
+//
+// The calling thread parses the trace once. It appends each data access to
+// a batch for the thread that owns its set, and hands over full batches
+// through a ring of a few batches per thread. It blocks when a ring is
+// full, so memory use does not depend on the length of the trace.
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "trace.h"
+#include <stdint.h>
+
+// The number of threads shard_replay uses when asked for threads: the
+// largest power of 2 that is at most threads and at most 2^s
+int shard_threads(int s, int threads);
+
+// Replay the data accesses of t ('I' records are skipped and 'M' counts a
+// load and a store, as in csim) through an LRU cache of 2^s sets of E
+// lines of 2^b bytes, on shard_threads(s, threads) threads. Store the
+// counts in *hits, *misses and *evictions and return 0, or return -1 if
+// the trace is corrupt and -2 if the caches or threads cannot be created.
+int shard_replay(trace_t *t, int s, int E, int b, int threads,
+                 uint64_t *hits, uint64_t *misses, uint64_t *evictions);
+
+#endif
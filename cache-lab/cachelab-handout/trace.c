@@ -0,0 +1,292 @@
+// trace.c - Readers and a writer for the memory traces csim replays
+// (see trace.h)
+#define _POSIX_C_SOURCE 200112L
+#include "trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAGIC "CSIMTRC1"
+#define MAGIC_LEN 8
+#define SIZE_VARINT 7       // size code for sizes that are not 1 << n
+#define WRITE_BUF (1 << 16) // bytes buffered by the writer
+#define MAX_RECORD 21       // header byte and two varints of 10 bytes
+
+struct trace {
+  const char *start;  // the whole file
+  const char *pos;    // next unread byte
+  const char *end;    // end of the file
+  int binary;         // the file is in the binary format
+  int mapped;         // start is mapped, rather than malloc'd
+  uint64_t prev[2];   // binary: previous data and instruction address
+};
+
+struct trace_writer {
+  FILE *fp;
+  uint64_t prev[2];   // previous data and instruction address
+  size_t len;         // bytes in buf
+  unsigned char buf[WRITE_BUF];
+};
+
+static const char ops[4] = {'I', 'L', 'S', 'M'};
+
+// Read a whole file that cannot be mapped, such as a pipe
+static char *read_all(int fd, size_t *len) {
+  size_t cap = 1 << 20;
+  char *buf = (char *)malloc(cap);
+  ssize_t n;
+
+  *len = 0;
+  while (buf != NULL && (n = read(fd, buf + *len, cap - *len)) != 0) {
+    if (n < 0) {
+      free(buf);
+      return NULL;
+    }
+    *len += n;
+    if (*len == cap) {
+      char *bigger = (char *)realloc(buf, cap *= 2);
+      if (bigger == NULL) {
+        free(buf);
+      }
+      buf = bigger;
+    }
+  }
+  return buf;
+}
+
+trace_t *trace_open(const char *path) {
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  trace_t *t = (trace_t *)calloc(1, sizeof(trace_t));
+  if (t == NULL || fstat(fd, &st) < 0) {
+    free(t);
+    close(fd);
+    return NULL;
+  }
+
+  void *p = MAP_FAILED;
+  size_t len = (size_t)st.st_size;
+  if (S_ISREG(st.st_mode) && len > 0) {
+    p = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  if (p != MAP_FAILED) {
+    posix_madvise(p, len, POSIX_MADV_SEQUENTIAL);
+    t->mapped = 1;
+  } else if ((p = read_all(fd, &len)) == NULL) {
+    free(t);
+    close(fd);
+    errno = ENOMEM;
+    return NULL;
+  }
+  close(fd);
+
+  t->start = t->pos = (const char *)p;
+  t->end = t->start + len;
+  if (len >= MAGIC_LEN && memcmp(t->start, MAGIC, MAGIC_LEN) == 0) {
+    t->binary = 1;
+    t->pos += MAGIC_LEN;
+  }
+  return t;
+}
+
+void trace_close(trace_t *t) {
+  if (t->mapped) {
+    munmap((void *)t->start, t->end - t->start);
+  } else {
+    free((void *)t->start);
+  }
+  free(t);
+}
+
+int trace_is_binary(const trace_t *t) { return t->binary; }
+
+uint64_t trace_bytes(const trace_t *t) { return t->end - t->start; }
+
+// Value of a hex digit, or 16 or more for anything else
+static inline unsigned hex_digit(char c) {
+  unsigned d = (unsigned)(c - '0');
+  if (d < 10) {
+    return d;
+  }
+  d = (unsigned)((c | 0x20) - 'a');
+  return d < 6 ? d + 10 : 16;
+}
+
+static int next_text(trace_t *t, trace_rec_t *r) {
+  const char *p = t->pos;
+  const char *end = t->end;
+
+  for (;;) {
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r')) {
+      ++p;
+    }
+    if (p == end) {
+      t->pos = p;
+      return 0;
+    }
+    char op = *p++;
+    if ((op == 'I' || op == 'L' || op == 'S' || op == 'M') && p < end &&
+        *p == ' ') {
+      while (p < end && *p == ' ') {
+        ++p;
+      }
+      uint64_t addr = 0;
+      const char *digits = p;
+      unsigned d;
+      while (p < end && (d = hex_digit(*p)) < 16) {
+        addr = addr << 4 | d;
+        ++p;
+      }
+      if (p != digits && p < end && *p == ',') {
+        int size = 0;
+        digits = ++p;
+        while (p < end && *p >= '0' && *p <= '9') {
+          size = size * 10 + (*p++ - '0');
+        }
+        if (p != digits) {
+          while (p < end && *p != '\n') {
+            ++p;
+          }
+          t->pos = p;
+          r->op = op;
+          r->size = size;
+          r->addr = addr;
+          return 1;
+        }
+      }
+    }
+    // Not an access: skip the line
+    while (p < end && *p != '\n') {
+      ++p;
+    }
+  }
+}
+
+// Decode a varint at p; returns the byte after it, or NULL if it is cut off
+// or longer than 64 bits
+static inline const unsigned char *get_varint(const unsigned char *p,
+                                              const unsigned char *end,
+                                              uint64_t *v) {
+  uint64_t x = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    unsigned char c = *p++;
+    x |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80)) {
+      *v = x;
+      return p;
+    }
+  }
+  return NULL;
+}
+
+static int next_binary(trace_t *t, trace_rec_t *r) {
+  const unsigned char *p = (const unsigned char *)t->pos;
+  const unsigned char *end = (const unsigned char *)t->end;
+  uint64_t size, delta;
+
+  if (p == end) {
+    return 0;
+  }
+  unsigned h = *p++;
+  if (h >> 5) {
+    return -1;
+  }
+  if (((h >> 2) & 7) == SIZE_VARINT) {
+    if ((p = get_varint(p, end, &size)) == NULL) {
+      return -1;
+    }
+  } else {
+    size = (uint64_t)1 << ((h >> 2) & 7);
+  }
+  if ((p = get_varint(p, end, &delta)) == NULL) {
+    return -1;
+  }
+  int kind = (h & 3) == 0;
+  t->prev[kind] += (delta >> 1) ^ -(delta & 1);
+  t->pos = (const char *)p;
+  r->op = ops[h & 3];
+  r->size = (int)size;
+  r->addr = t->prev[kind];
+  return 1;
+}
+
+int trace_next(trace_t *t, trace_rec_t *r) {
+  return t->binary ? next_binary(t, r) : next_text(t, r);
+}
+
+trace_writer_t *trace_create(const char *path) {
+  trace_writer_t *w = (trace_writer_t *)calloc(1, sizeof(trace_writer_t));
+  if (w == NULL) {
+    return NULL;
+  }
+  if ((w->fp = fopen(path, "wb")) == NULL) {
+    free(w);
+    return NULL;
+  }
+  memcpy(w->buf, MAGIC, MAGIC_LEN);
+  w->len = MAGIC_LEN;
+  return w;
+}
+
+static inline unsigned char *put_varint(unsigned char *p, uint64_t v) {
+  while (v >= 0x80) {
+    *p++ = (unsigned char)(v | 0x80);
+    v >>= 7;
+  }
+  *p++ = (unsigned char)v;
+  return p;
+}
+
+int trace_write(trace_writer_t *w, const trace_rec_t *r) {
+  if (w->len > WRITE_BUF - MAX_RECORD) {
+    if (fwrite(w->buf, 1, w->len, w->fp) != w->len) {
+      return -1;
+    }
+    w->len = 0;
+  }
+
+  unsigned op;
+  for (op = 0; op < 4 && ops[op] != r->op; ++op) {
+  }
+  if (op == 4) {
+    errno = EINVAL;
+    return -1;
+  }
+  unsigned code = SIZE_VARINT;
+  for (unsigned n = 0; n < SIZE_VARINT; ++n) {
+    if (r->size == 1 << n) {
+      code = n;
+    }
+  }
+  unsigned char *p = w->buf + w->len;
+  *p++ = (unsigned char)(op | code << 2);
+  if (code == SIZE_VARINT) {
+    p = put_varint(p, (uint64_t)(unsigned)r->size);
+  }
+  int kind = op == 0;
+  int64_t delta = (int64_t)(r->addr - w->prev[kind]);
+  w->prev[kind] = r->addr;
+  p = put_varint(p, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+  w->len = p - w->buf;
+  return 0;
+}
+
+int trace_finish(trace_writer_t *w) {
+  int res = 0;
+  if (fwrite(w->buf, 1, w->len, w->fp) != w->len) {
+    res = -1;
+  }
+  if (fclose(w->fp) != 0) {
+    res = -1;
+  }
+  free(w);
+  return res;
+}
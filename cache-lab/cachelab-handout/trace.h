@@ -0,0 +1,63 @@
+// trace.h - Readers and a writer for the memory traces csim replays
+//
+// Two formats are read, told apart by the first bytes of the file:
+//
+// - The text format of valgrind's lackey tool, one access per line:
+//   "I 0400d7d4,8", " L 7ff0005c8,8", " S ...", " M ...". Lines that are
+//   not accesses, such as valgrind's own messages, are skipped.
+//
+// - A binary format, written by trace_create/trace_write (csim-conv
+//   converts between the two). After the 8-byte magic "CSIMTRC1", each
+//   record is a header byte followed by varints (LEB128):
+//
+//     bits 0-1 of the header: the op, 0 = I, 1 = L, 2 = S, 3 = M
+//     bits 2-4: the size is 1 << n for n < 7; for 7 a varint size follows
+//     bits 5-7: zero
+//     then the zigzag-encoded difference between the address and that of
+//     the previous record of the same kind (instruction or data)
+//
+//   A data access near the previous one takes two or three bytes, against
+//   about twenty in text.
+//
+// The file is mapped with mmap and parsed in place, so reading costs
+// about as much as touching the bytes once.
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// One access
+typedef struct {
+  char op;       // 'I', 'L', 'S' or 'M'
+  int size;      // bytes accessed
+  uint64_t addr; // address of the first byte
+} trace_rec_t;
+
+typedef struct trace trace_t;
+typedef struct trace_writer trace_writer_t;
+
+// Open a trace in either format; NULL (with errno set) on failure
+trace_t *trace_open(const char *path);
+
+// Read the next record into r. Returns 1 for a record, 0 at the end of the
+// trace and -1 if a binary trace is corrupt.
+int trace_next(trace_t *t, trace_rec_t *r);
+
+// 1 if the trace is in the binary format
+int trace_is_binary(const trace_t *t);
+
+// Size of the trace file in bytes
+uint64_t trace_bytes(const trace_t *t);
+
+void trace_close(trace_t *t);
+
+// Create a binary trace; NULL (with errno set) on failure
+trace_writer_t *trace_create(const char *path);
+
+// Append a record; returns 0, or -1 on a write error
+int trace_write(trace_writer_t *w, const trace_rec_t *r);
+
+// Flush and close; returns 0, or -1 on a write error
+int trace_finish(trace_writer_t *w);
+
+#endif
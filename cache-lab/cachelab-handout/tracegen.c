@@ -5,6 +5,12 @@
  * The beginning and end of each registered transpose function's trace
  * is indicated by reading from "marker" addresses. These two marker
  * addresses are recorded in file for later use.
+ *
+ * Built with -DMEMREC and -fsanitize=thread (tracegen-rec), it needs no
+ * valgrind: memrec.c records the accesses between the markers straight
+ * into a cache with -s, -E and -b, prints the counts and leaves them in
+ * .csim_results like csim does. -t also writes the filtered trace, and
+ * -m a map of A and B for csim -a.
  */
 
 #include <stdlib.h>
@@ -14,6 +20,9 @@
 #include <getopt.h>
 #include "cachelab.h"
 #include <string.h>
+#ifdef MEMREC
+#include "memrec.h"
+#endif
 
 /* External variables declared in cachelab.c */
 extern trans_func_t func_list[MAX_TRANS_FUNCS];
@@ -51,7 +60,14 @@ int main(int argc, char* argv[]){
 
     char c;
     int selectedFunc=-1;
+#ifdef MEMREC
+    int s=5, E=1, b=5;
+    char *trace_file=NULL;
+    char *map_file=NULL;
+    while( (c=getopt(argc,argv,"M:N:F:s:E:b:t:m:")) != -1){
+#else
     while( (c=getopt(argc,argv,"M:N:F:")) != -1){
+#endif
         switch(c){
         case 'M':
             M = atoi(optarg);
@@ -62,6 +78,23 @@ int main(int argc, char* argv[]){
         case 'F':
             selectedFunc = atoi(optarg);
             break;
+#ifdef MEMREC
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 't':
+            trace_file = optarg;
+            break;
+        case 'm':
+            map_file = optarg;
+            break;
+#endif
         case '?':
         default:
             printf("./tracegen failed to parse its options.\n");
@@ -84,6 +117,25 @@ int main(int argc, char* argv[]){
             (unsigned long long int) &MARKER_END );
     fclose(marker_fp);
 
+#ifdef MEMREC
+    /* A is used as an N x M array and B as an M x N one (see attrib.h) */
+    if (map_file) {
+        FILE* map_fp = fopen(map_file, "w");
+        assert(map_fp);
+        fprintf(map_fp, "A %llx %d %d\nB %llx %d %d\n",
+                (unsigned long long int) A, N * M * 4, M * 4,
+                (unsigned long long int) B, M * N * 4, N * 4);
+        fclose(map_fp);
+    }
+
+    /* Only the first function is recorded, as test-trans only keeps the
+       first window of the trace */
+    if (memrec_open(s, E, b, &MARKER_START, &MARKER_END, trace_file) < 0) {
+        printf("./tracegen-rec cannot create the cache or the trace file.\n");
+        exit(1);
+    }
+#endif
+
     if (-1==selectedFunc) {
         /* Invoke registered transpose functions */
         for (i=0; i < func_counter; i++) {
@@ -101,6 +153,11 @@ int main(int argc, char* argv[]){
             return selectedFunc+1;
 
     }
+#ifdef MEMREC
+    uint64_t hits, misses, evictions;
+    memrec_close(&hits, &misses, &evictions);
+    printSummary(hits, misses, evictions);
+#endif
     return 0;
 }
 
@@ -0,0 +1,366 @@
+// trans-tune.c - Search transpose blockings against the cache simulator
+//
+// Usage: ./trans-tune [-h] [-M <cols>] [-N <rows>] [-s <num>] [-E <num>]
+//                     [-b <num>] [-T <ms>] [-n <num>] [-o <file>]
+//
+// Every variant of tune.c's transpose (see tune.h) is run once through
+// memrec.c on a cache with -s, -E and -b, as test-trans would count it,
+// and timed on the host for -T milliseconds. The variants are
+//
+//   tiles th x tw with th, tw in 1, 2, 4, 8, 16, 32
+//   regs in 1, 2, 4, 8 temporaries, at most tw
+//   tiles visited by rows or by columns
+//   copy then swap in B, for square tiles
+//
+// The table lists the -n variants with the fewest misses (the faster
+// first among equals), then the misses of trans and transpose_submit. With
+// -o the best variant is written as a transpose function with the
+// signature of trans.c, for M x N and this cache, to paste into trans.c.
+// Like the code in trans.c it uses at most 12 int locals, and it makes the
+// same accesses as the variant, so test-trans counts the same misses plus
+// the few of its own around the call.
+#define _POSIX_C_SOURCE 200112L
+#include "memrec.h"
+#include "tune.h"
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// From trans.c, built for memrec.c
+void trans(int M, int N, int A[N][M], int B[M][N]);
+void transpose_submit(int M, int N, int A[N][M], int B[M][N]);
+
+// One variant and how it did
+typedef struct {
+  tune_params_t p;
+  uint64_t hits, misses, evictions;
+  double ns;  // per call on the host
+  int correct;
+} variant_t;
+
+static int M = 32, N = 32;
+static int s = 5, E = 1, b = 5;
+static int *A, *B;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// 1 if B is the transpose of A
+static int check(void) {
+  for (int i = 0; i < N; ++i) {
+    for (int j = 0; j < M; ++j) {
+      if (A[i * M + j] != B[j * N + i]) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+// Count the accesses of one call of the instrumented tune.c, or of f if
+// v is NULL; returns 1 if B came out right
+static int simulate(variant_t *v, void (*f)(int M, int N, int A[N][M],
+                                            int B[M][N]),
+                    uint64_t *hits, uint64_t *misses, uint64_t *evictions) {
+  memset(B, 0, (size_t)M * N * sizeof(int));
+  if (memrec_open(s, E, b, NULL, NULL, NULL) < 0) {
+    fputs("trans-tune: cannot create the cache\n", stderr);
+    exit(EXIT_FAILURE);
+  }
+  // The parameters go on the stack, whose accesses are not counted
+  tune_params_t p = v != NULL ? v->p : (tune_params_t){1, 1, 1, 0, 0};
+  memrec_start();
+  if (v != NULL) {
+    tune_kernel_rec(&p, M, N, A, B);
+  } else {
+    f(M, N, (int(*)[M])A, (int(*)[N])B);
+  }
+  memrec_stop();
+  memrec_close(hits, misses, evictions);
+  return check();
+}
+
+// Mean time of a call of the plain tune.c over about secs seconds
+static double time_variant(const variant_t *v, double secs) {
+  long calls = 0, batch = 1;
+  double start = now(), elapsed;
+  do {
+    for (long i = 0; i < batch; ++i) {
+      tune_kernel(&v->p, M, N, A, B);
+    }
+    calls += batch;
+    batch *= 2;
+    elapsed = now() - start;
+  } while (elapsed < secs);
+  return elapsed / calls * 1e9;
+}
+
+static void describe(const tune_params_t *p, char *buf, size_t len) {
+  snprintf(buf, len, "%dx%d r%d %s%s", p->th, p->tw, p->regs,
+           p->col_order ? "cols" : "rows", p->copy ? " copy" : "");
+}
+
+// Fewest misses first, then fastest
+static int cmp_variant(const void *x, const void *y) {
+  const variant_t *a = (const variant_t *)x;
+  const variant_t *c = (const variant_t *)y;
+  if (a->correct != c->correct) {
+    return c->correct - a->correct;
+  }
+  if (a->misses != c->misses) {
+    return a->misses < c->misses ? -1 : 1;
+  }
+  return a->ns < c->ns ? -1 : a->ns > c->ns;
+}
+
+// The temporaries v0.. for a group of r elements: loads, then stores
+static void emit_group(FILE *fp, const char *indent, int r, const char *load,
+                       const char *store) {
+  for (int k = 0; k < r; ++k) {
+    char plus[16] = "";
+    if (k > 0) {
+      snprintf(plus, sizeof(plus), " + %d", k);
+    }
+    fprintf(fp, "%sv%d = ", indent, k);
+    fprintf(fp, load, plus);
+    fputs(";\n", fp);
+  }
+  for (int k = 0; k < r; ++k) {
+    char plus[16] = "";
+    if (k > 0) {
+      snprintf(plus, sizeof(plus), " + %d", k);
+    }
+    fputs(indent, fp);
+    fprintf(fp, store, plus);
+    fprintf(fp, " = v%d;\n", k);
+  }
+}
+
+// Write v as a transpose function of trans.c for this M, N and cache
+static void emit(const variant_t *v, const char *path) {
+  const tune_params_t *p = &v->p;
+  char name[64], what[64];
+  FILE *fp = fopen(path, "w");
+
+  if (fp == NULL) {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+  snprintf(name, sizeof(name), "trans_tuned_%dx%d", M, N);
+  describe(p, what, sizeof(what));
+  fprintf(fp, "/*\n");
+  fprintf(fp, " * %s - Written by trans-tune for s=%d, E=%d, b=%d\n", name, s,
+          E, b);
+  fprintf(fp, " *     (%s): %" PRIu64 " misses in simulation. Register it with\n",
+          what, v->misses);
+  fprintf(fp, " *     registerTransFunction(%s, %s_desc);\n", name, name);
+  fprintf(fp, " */\n");
+  fprintf(fp, "char %s_desc[] = \"Tuned %dx%d, s=%d E=%d b=%d\";\n", name, M,
+          N, s, E, b);
+  fprintf(fp, "void %s(int M, int N, int A[N][M], int B[M][N]) {\n", name);
+  fprintf(fp, "  int ti, tj, i, j");
+  for (int k = 0; k < p->regs; ++k) {
+    fprintf(fp, ", v%d", k);
+  }
+  fprintf(fp, ";\n\n");
+  if (p->col_order) {
+    fprintf(fp, "  for (tj = 0; tj < M; tj += %d) {\n", p->tw);
+    fprintf(fp, "    for (ti = 0; ti < N; ti += %d) {\n", p->th);
+  } else {
+    fprintf(fp, "  for (ti = 0; ti < N; ti += %d) {\n", p->th);
+    fprintf(fp, "    for (tj = 0; tj < M; tj += %d) {\n", p->tw);
+  }
+  if (p->copy) {
+    fprintf(fp, "      if (ti + %d <= N && tj + %d <= M) {\n", p->th, p->tw);
+    fprintf(fp, "        for (i = 0; i < %d; ++i) {\n", p->th);
+    fprintf(fp, "          for (j = 0; j < %d; j += %d) {\n", p->tw, p->regs);
+    emit_group(fp, "            ", p->regs, "A[ti + i][tj + j%s]",
+               "B[tj + i][ti + j%s]");
+    fprintf(fp, "          }\n");
+    fprintf(fp, "        }\n");
+    fprintf(fp, "        for (i = 1; i < %d; ++i) {\n", p->th);
+    fprintf(fp, "          for (j = 0; j < i; ++j) {\n");
+    fprintf(fp, "            v0 = B[tj + i][ti + j];\n");
+    fprintf(fp, "            B[tj + i][ti + j] = B[tj + j][ti + i];\n");
+    fprintf(fp, "            B[tj + j][ti + i] = v0;\n");
+    fprintf(fp, "          }\n");
+    fprintf(fp, "        }\n");
+    fprintf(fp, "        continue;\n");
+    fprintf(fp, "      }\n");
+  }
+  fprintf(fp, "      for (i = ti; i < ti + %d && i < N; ++i) {\n", p->th);
+  fprintf(fp, "        for (j = tj; j < tj + %d && j < M; j += %d) {\n", p->tw,
+          p->regs);
+  if (p->regs > 1) {
+    fprintf(fp, "          if (j + %d > M) {\n", p->regs);
+    fprintf(fp, "            for (; j < M; ++j) {\n");
+    fprintf(fp, "              B[j][i] = A[i][j];\n");
+    fprintf(fp, "            }\n");
+    fprintf(fp, "            break;\n");
+    fprintf(fp, "          }\n");
+  }
+  emit_group(fp, "          ", p->regs, "A[i][j%s]", "B[j%s][i]");
+  fprintf(fp, "        }\n");
+  fprintf(fp, "      }\n");
+  fprintf(fp, "    }\n");
+  fprintf(fp, "  }\n");
+  fprintf(fp, "}\n");
+  if (fclose(fp) != 0) {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+}
+
+static void printUsage() {
+  puts("Usage: ./trans-tune [-h] [-M <cols>] [-N <rows>] [-s <num>] "
+       "[-E <num>]");
+  puts("                    [-b <num>] [-T <ms>] [-n <num>] [-o <file>]");
+  puts("Options:");
+  puts("  -h         Print this help message.");
+  puts("  -M <num>   Columns of A (default 32).");
+  puts("  -N <num>   Rows of A (default 32).");
+  puts("  -s <num>   Number of set index bits (default 5).");
+  puts("  -E <num>   Number of lines per set (default 1).");
+  puts("  -b <num>   Number of block offset bits (default 5).");
+  puts("  -T <ms>    Time each variant for this long (default 20).");
+  puts("  -n <num>   Variants to list (default 10).");
+  puts("  -o <file>  Write the best variant there as C.");
+  puts("");
+  puts("Examples:");
+  puts(" linux>  ./trans-tune -M 61 -N 67 -o tuned.c");
+  puts(" linux>  ./trans-tune -M 64 -N 64 -s 6 -E 8 -b 6 -T 5");
+}
+
+int main(int argc, char *argv[]) {
+  int ms = 20, top = 10;
+  char *out = NULL;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "hM:N:s:E:b:T:n:o:")) != -1) {
+    switch (opt) {
+    case 'M':
+      M = atoi(optarg);
+      break;
+    case 'N':
+      N = atoi(optarg);
+      break;
+    case 's':
+      s = atoi(optarg);
+      break;
+    case 'E':
+      E = atoi(optarg);
+      break;
+    case 'b':
+      b = atoi(optarg);
+      break;
+    case 'T':
+      ms = atoi(optarg);
+      break;
+    case 'n':
+      top = atoi(optarg);
+      break;
+    case 'o':
+      out = optarg;
+      break;
+    case 'h':
+      printUsage();
+      exit(EXIT_SUCCESS);
+    default:
+      printUsage();
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (M <= 0 || N <= 0 || ms <= 0 || top < 0) {
+    printUsage();
+    exit(EXIT_FAILURE);
+  }
+
+  // A, then B at the next multiple of 4 KB, as in tracegen
+  size_t bytes = (size_t)M * N * sizeof(int);
+  size_t gap = (bytes + 4095) & ~(size_t)4095;
+  void *mem;
+  if (posix_memalign(&mem, 4096, 2 * gap) != 0) {
+    fputs("trans-tune: out of memory\n", stderr);
+    exit(EXIT_FAILURE);
+  }
+  A = (int *)mem;
+  B = (int *)((char *)mem + gap);
+  for (size_t i = 0; i < (size_t)M * N; ++i) {
+    A[i] = (int)i;
+  }
+
+  // All the variants
+  static const int sizes[] = {1, 2, 4, 8, 16, 32};
+  variant_t *vs = (variant_t *)calloc(6 * 6 * 4 * 2 * 2, sizeof(variant_t));
+  int n = 0;
+  for (int a = 0; a < 6; ++a) {
+    for (int c = 0; c < 6; ++c) {
+      for (int regs = 1; regs <= TUNE_MAX_REGS && regs <= sizes[c];
+           regs *= 2) {
+        for (int order = 0; order < 2; ++order) {
+          for (int copy = 0; copy < 2; ++copy) {
+            if (copy && (sizes[a] != sizes[c] || sizes[a] == 1)) {
+              continue;
+            }
+            tune_params_t p = {sizes[a], sizes[c], regs, order, copy};
+            vs[n++].p = p;
+          }
+        }
+      }
+    }
+  }
+
+  printf("%d x %d, s=%d E=%d b=%d, %d variants\n", N, M, s, E, b, n);
+  double start = now();
+  for (int i = 0; i < n; ++i) {
+    variant_t *v = &vs[i];
+    v->correct = simulate(v, NULL, &v->hits, &v->misses, &v->evictions);
+    v->ns = time_variant(v, ms * 1e-3);
+  }
+  double secs = now() - start;
+  qsort(vs, n, sizeof(variant_t), cmp_variant);
+
+  int fastest = 0;
+  for (int i = 1; i < n; ++i) {
+    if (vs[i].correct && vs[i].ns < vs[fastest].ns) {
+      fastest = i;
+    }
+  }
+  printf("%-20s %12s %12s %12s %10s\n", "variant", "hits", "misses",
+         "evictions", "ns/call");
+  for (int i = 0; i < n && i < top; ++i) {
+    char what[64];
+    describe(&vs[i].p, what, sizeof(what));
+    printf("%-20s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %10.0f\n", what,
+           vs[i].hits, vs[i].misses, vs[i].evictions, vs[i].ns);
+  }
+  void (*base[])(int M, int N, int A[N][M], int B[M][N]) = {trans,
+                                                           transpose_submit};
+  const char *names[] = {"trans", "transpose_submit"};
+  for (int i = 0; i < 2; ++i) {
+    uint64_t hits, misses, evictions;
+    if (simulate(NULL, base[i], &hits, &misses, &evictions)) {
+      printf("%-20s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %10s\n",
+             names[i], hits, misses, evictions, "-");
+    }
+  }
+
+  char what[64];
+  describe(&vs[0].p, what, sizeof(what));
+  printf("best: %s, %" PRIu64 " misses\n", what, vs[0].misses);
+  describe(&vs[fastest].p, what, sizeof(what));
+  printf("fastest on this host: %s, %.0f ns\n", what, vs[fastest].ns);
+  printf("# %.2f s\n", secs);
+  if (out != NULL) {
+    emit(&vs[0], out);
+  }
+  free(vs);
+  free(mem);
+  return 0;
+}
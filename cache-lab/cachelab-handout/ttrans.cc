@@ -0,0 +1,195 @@
+// ttrans.cc - Compile-time specialized transposes (see ttrans.h)
+//
+// Built twice like xpose.c: as is for xpose-bench, and with
+// -fsanitize=thread for xpose-bench-rec. It uses no part of the C++
+// runtime, so the C programs link it with gcc.
+#include "ttrans.h"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#define INLINE inline __attribute__((always_inline))
+
+namespace {
+
+// A blocking, as in tune.h
+template <int TH, int TW, int R, bool ColOrder, bool Copy> struct Plan {
+  static_assert(TH > 0 && TW > 0 && R > 0 && TW % R == 0,
+                "the temporaries must divide the tile width");
+  static_assert(!Copy || TH == TW, "copy then swap needs square tiles");
+  static constexpr int th = TH, tw = TW, regs = R;
+  static constexpr bool col_order = ColOrder, copy = Copy;
+};
+
+using GenericPlan = Plan<8, 8, 8, false, false>;
+
+// The plan of a shape; see the table in ttrans.h
+template <typename T, int M, int N> struct PlanFor {
+  using type = GenericPlan;
+};
+template <> struct PlanFor<uint32_t, 32, 32> {
+  using type = Plan<8, 8, 8, false, true>;
+};
+template <> struct PlanFor<uint32_t, 64, 64> {
+  using type = Plan<4, 4, 4, false, true>;
+};
+template <> struct PlanFor<uint32_t, 61, 67> {
+  using type = Plan<8, 16, 8, true, false>;
+};
+
+// R elements of a row of A into registers, then down a column of B
+template <typename T, int R, std::size_t... K>
+INLINE void move(const T *a, T *b, int ldb, std::index_sequence<K...>) {
+  T v[R] = {a[K]...};
+  ((b[K * ldb] = v[K]), ...);
+}
+
+// R elements of a row of A into registers, then along a row of B
+template <typename T, int R, std::size_t... K>
+INLINE void copy(const T *a, T *b, std::index_sequence<K...>) {
+  T v[R] = {a[K]...};
+  ((b[K] = v[K]), ...);
+}
+
+// Row I of a full tile: its groups G of P::regs elements
+template <typename T, class P, int I, std::size_t... G>
+INLINE void tile_row(const T *a, int lda, T *b, int ldb,
+                     std::index_sequence<G...>) {
+  if constexpr (P::copy) {
+    (copy<T, P::regs>(a + I * lda + G * P::regs, b + I * ldb + G * P::regs,
+                      std::make_index_sequence<P::regs>()),
+     ...);
+  } else {
+    (move<T, P::regs>(a + I * lda + G * P::regs, b + G * P::regs * ldb + I,
+                      ldb, std::make_index_sequence<P::regs>()),
+     ...);
+  }
+}
+
+// Swap element X of the tile in B with its mirror, if it is below the
+// diagonal
+template <typename T, int TH, std::size_t X> INLINE void swap(T *b, int ldb) {
+  constexpr int i = X / TH, j = X % TH;
+  if constexpr (j < i) {
+    T t = b[i * ldb + j];
+    b[i * ldb + j] = b[j * ldb + i];
+    b[j * ldb + i] = t;
+  }
+}
+
+template <typename T, class P, std::size_t... I, std::size_t... X>
+INLINE void full_tile(const T *a, int lda, T *b, int ldb,
+                      std::index_sequence<I...>, std::index_sequence<X...>) {
+  (tile_row<T, P, I>(a, lda, b, ldb,
+                     std::make_index_sequence<P::tw / P::regs>()),
+   ...);
+  if constexpr (P::copy) {
+    // The copy must reach B before the swaps read it back; without the
+    // barrier the compiler forwards the values and drops the copy, which
+    // turns this back into a plain transpose of the tile
+    __asm__ __volatile__("" ::: "memory");
+    (swap<T, P::th, X>(b, ldb), ...);
+  }
+}
+
+// Tile (ti, tj): rows ti.. of A, columns tj..
+template <typename T, class P>
+INLINE void tile(int M, int N, const T *A, T *B, int ti, int tj) {
+  if (ti + P::th <= N && tj + P::tw <= M) {
+    full_tile<T, P>(A + ti * M + tj, M, B + tj * N + ti, N,
+                    std::make_index_sequence<P::th>(),
+                    std::make_index_sequence<P::copy ? P::th * P::th : 0>());
+    return;
+  }
+  // A tile cut by the edge: groups of regs while they fit, then single
+  // elements, as in tune.c
+  for (int i = ti; i < ti + P::th && i < N; ++i) {
+    int j = tj;
+    for (; j + P::regs <= tj + P::tw && j + P::regs <= M; j += P::regs) {
+      move<T, P::regs>(A + i * M + j, B + j * N + i, N,
+                       std::make_index_sequence<P::regs>());
+    }
+    for (; j < tj + P::tw && j < M; ++j) {
+      B[j * N + i] = A[i * M + j];
+    }
+  }
+}
+
+template <typename T, class P>
+INLINE void kernel(int M, int N, const T *A, T *B) {
+  if constexpr (P::col_order) {
+    for (int tj = 0; tj < M; tj += P::tw) {
+      for (int ti = 0; ti < N; ti += P::th) {
+        tile<T, P>(M, N, A, B, ti, tj);
+      }
+    }
+  } else {
+    for (int ti = 0; ti < N; ti += P::th) {
+      for (int tj = 0; tj < M; tj += P::tw) {
+        tile<T, P>(M, N, A, B, ti, tj);
+      }
+    }
+  }
+}
+
+// The kernel with M and N fixed, so that they fold into every index
+template <typename T, int M, int N> void fixed(const void *A, void *B) {
+  kernel<T, typename PlanFor<T, M, N>::type>(M, N, (const T *)A, (T *)B);
+}
+
+template <typename T> void generic(int M, int N, const void *A, void *B) {
+  kernel<T, GenericPlan>(M, N, (const T *)A, (T *)B);
+}
+
+typedef void (*Fn)(const void *, void *);
+
+struct Entry {
+  int M, N, width;
+  Fn fn;
+};
+
+const Entry entries[] = {
+    {32, 32, 4, fixed<uint32_t, 32, 32>},
+    {64, 64, 4, fixed<uint32_t, 64, 64>},
+    {61, 67, 4, fixed<uint32_t, 61, 67>},
+    {1024, 1024, 4, fixed<uint32_t, 1024, 1024>},
+    {1024, 1024, 8, fixed<uint64_t, 1024, 1024>},
+};
+
+// Not instrumented, so that xpose-bench-rec counts only the kernel's
+// accesses
+__attribute__((no_sanitize_thread)) Fn find(int M, int N, int width) {
+  for (const Entry &e : entries) {
+    if (e.M == M && e.N == N && e.width == width) {
+      return e.fn;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace
+
+extern "C" int ttrans(int M, int N, const void *A, void *B, int width) {
+  if (Fn fn = find(M, N, width)) {
+    fn(A, B);
+    return 0;
+  }
+  return ttrans_generic(M, N, A, B, width);
+}
+
+extern "C" int ttrans_generic(int M, int N, const void *A, void *B,
+                              int width) {
+  if (width != 4 && width != 8) {
+    return -1;
+  }
+  if (width == 4) {
+    generic<uint32_t>(M, N, A, B);
+  } else {
+    generic<uint64_t>(M, N, A, B);
+  }
+  return 0;
+}
+
+extern "C" int ttrans_specialized(int M, int N, int width) {
+  return find(M, N, width) != nullptr;
+}
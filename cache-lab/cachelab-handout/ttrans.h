@@ -0,0 +1,47 @@
+// ttrans.h - Transposes specialized at compile time for fixed shapes
+//
+// ttrans.cc is C++: one template kernel, parameterized by the element
+// type and a blocking plan with the fields of tune.h (tile height and
+// width, temporaries per row, tile order, copy-then-swap). It is
+// instantiated for the shapes below with M and N as constants, so every
+// index is a constant offset and each tile is unrolled completely: a row
+// of a tile is loaded into `regs` locals, which the compiler keeps in
+// registers, and stored down a column of B, as the v1..v8 of
+// transpose_submit do by hand.
+//
+//   shape     element  plan
+//   32 x 32   4 bytes  8 x 8 tiles, 8 temporaries, copy then swap
+//   64 x 64   4 bytes  4 x 4 tiles, 4 temporaries, copy then swap
+//   61 x 67   4 bytes  8 x 16 tiles by columns, 8 temporaries
+//   1024^2    4 bytes  8 x 8 tiles, 8 temporaries
+//   1024^2    8 bytes  8 x 8 tiles, 8 temporaries
+//
+// The lab's three plans are trans-tune's best for its cache. For 1024^2,
+// 16 x 16 tiles were no faster on the host and have five times the misses
+// in a 32 KB 8-way cache, where 16 rows 4 KB apart share a set. ttrans picks
+// the instance for (M, N, width) at run time. Other shapes use the same
+// kernel with run-time M and N and 8 x 8 tiles of 8 temporaries. Either
+// way, A is N x M and B is M x N, both row-major, as in trans.c.
+#ifndef TTRANS_H
+#define TTRANS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Transpose A into B for elements of width bytes (4 or 8); returns 0, or
+// -1 for another width
+int ttrans(int M, int N, const void *A, void *B, int width);
+
+// ttrans with the run-time shape, even where an instance exists, for
+// comparison
+int ttrans_generic(int M, int N, const void *A, void *B, int width);
+
+// 1 if ttrans has an instance specialized for this shape and width
+int ttrans_specialized(int M, int N, int width);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+// tune.c - The parameterized transpose of trans-tune (see tune.h)
+//
+// Built twice, the second time with -DTUNE_KERNEL=tune_kernel_rec and
+// -fsanitize=thread, so that one program can both time a variant and
+// count its misses.
+#include "tune.h"
+
+#ifndef TUNE_KERNEL
+#define TUNE_KERNEL tune_kernel
+#endif
+
+// Tile (ti, tj): rows ti.. of A, columns tj..
+static void tile(const tune_params_t *p, int M, int N, const int *A, int *B,
+                 int ti, int tj) {
+  int v[TUNE_MAX_REGS];
+  int r = p->regs;
+
+  if (p->copy && ti + p->th <= N && tj + p->tw <= M) {
+    for (int i = 0; i < p->th; ++i) {
+      for (int j = 0; j < p->tw; j += r) {
+        for (int k = 0; k < r; ++k) {
+          v[k] = A[(ti + i) * M + tj + j + k];
+        }
+        for (int k = 0; k < r; ++k) {
+          B[(tj + i) * N + ti + j + k] = v[k];
+        }
+      }
+    }
+    for (int i = 1; i < p->th; ++i) {
+      for (int j = 0; j < i; ++j) {
+        v[0] = B[(tj + i) * N + ti + j];
+        B[(tj + i) * N + ti + j] = B[(tj + j) * N + ti + i];
+        B[(tj + j) * N + ti + i] = v[0];
+      }
+    }
+    return;
+  }
+  for (int i = ti; i < ti + p->th && i < N; ++i) {
+    for (int j = tj; j < tj + p->tw && j < M; j += r) {
+      if (j + r > M) {
+        for (; j < M; ++j) {
+          B[j * N + i] = A[i * M + j];
+        }
+        break;
+      }
+      for (int k = 0; k < r; ++k) {
+        v[k] = A[i * M + j + k];
+      }
+      for (int k = 0; k < r; ++k) {
+        B[(j + k) * N + i] = v[k];
+      }
+    }
+  }
+}
+
+void TUNE_KERNEL(const tune_params_t *p, int M, int N, const int *A, int *B) {
+  if (p->col_order) {
+    for (int tj = 0; tj < M; tj += p->tw) {
+      for (int ti = 0; ti < N; ti += p->th) {
+        tile(p, M, N, A, B, ti, tj);
+      }
+    }
+  } else {
+    for (int ti = 0; ti < N; ti += p->th) {
+      for (int tj = 0; tj < M; tj += p->tw) {
+        tile(p, M, N, A, B, ti, tj);
+      }
+    }
+  }
+}
@@ -0,0 +1,37 @@
+// tune.h - A transpose with its blocking as run-time parameters
+//
+// trans-tune searches these parameters. A is N x M and B is M x N, both
+// row-major, as in trans.c. The matrix is cut into th x tw tiles of A,
+// visited row by row of tiles or, with col_order, column by column.
+// Within a tile each row of A is read regs elements at a time into
+// temporaries, which are then stored down a column of B; this is what the
+// v1..v8 locals of transpose_submit do with regs = 8.
+//
+// With copy (square tiles only), a whole tile is instead copied row for
+// row into its place in B and then transposed there by swapping across
+// the diagonal, which keeps the rows of A and B that share a set from
+// evicting each other; this is the 32x32 case of transpose_submit. Tiles
+// cut by the edge of the matrix fall back to the first method.
+//
+// Elements that do not fill a group of regs at the edge of the matrix are
+// moved one at a time. The code trans-tune emits for a variant makes the
+// same accesses in the same order.
+#ifndef TUNE_H
+#define TUNE_H
+
+#define TUNE_MAX_REGS 8
+
+typedef struct {
+  int th, tw;     // tile rows and columns of A
+  int regs;       // temporaries, 1 to TUNE_MAX_REGS, dividing tw
+  int col_order;  // visit the tiles column by column
+  int copy;       // copy then swap in B (th == tw)
+} tune_params_t;
+
+// The same code compiled twice: plainly, and with -fsanitize=thread for
+// memrec.c
+void tune_kernel(const tune_params_t *p, int M, int N, const int *A, int *B);
+void tune_kernel_rec(const tune_params_t *p, int M, int N, const int *A,
+                     int *B);
+
+#endif
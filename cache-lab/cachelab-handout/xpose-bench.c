@@ -0,0 +1,296 @@
+// xpose-bench.c - Compare xpose.c with the transpose functions of trans.c
+//
+// Usage: ./xpose-bench [-h] [-M <cols>] [-N <rows>] [-w <bytes>] [-j <num>]
+//                      [-r <num>]
+//        ./xpose-bench-rec [-h] [-M <cols>] [-N <rows>] [-w <bytes>]
+//                          [-s <num>] [-E <num>] [-b <num>]
+//
+// A is N x M and B is M x N, as in test-trans. Each row of the table is
+// one transpose: trans and transpose_submit from trans.c (for 4-byte
+// elements), xpose with each instruction set the host supports, xpose on
+// -j threads, xpose_square in place when M == N, and ttrans (for 4- and
+// 8-byte elements): its instance for the shape ("fixed"), if it has one,
+// and its kernel with run-time M and N ("generic"). Every result is
+// checked.
+//
+// xpose-bench times the calls and prints the best of -r runs.
+// xpose-bench-rec is the same program built with -DMEMREC, linked with
+// xpose.c and trans.c compiled with -fsanitize=thread (see memrec.h): it
+// runs each transpose once and prints the hits, misses and evictions of a
+// cache with -s, -E and -b (default the lab's 5, 1, 5). B starts a
+// multiple of 4 KB after A, as in tracegen, so the counts of trans and
+// transpose_submit are those of test-trans for the lab's sizes. The hooks
+// are not thread-safe, so -j is not offered there.
+#define _POSIX_C_SOURCE 200112L
+#include "ttrans.h"
+#include "xpose.h"
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef MEMREC
+#include "memrec.h"
+#endif
+
+// From trans.c
+void trans(int M, int N, int A[N][M], int B[M][N]);
+void transpose_submit(int M, int N, int A[N][M], int B[M][N]);
+
+// One transpose to measure
+typedef struct {
+  const char *name;
+  int kind;          // one of the K_ values
+  const char *isa;   // for K_XPOSE and K_SQUARE
+  int threads;
+} entry_t;
+
+#define K_TRANS 0
+#define K_SUBMIT 1
+#define K_XPOSE 2
+#define K_SQUARE 3
+#define K_TTRANS 4
+#define K_TTRANS_GENERIC 5
+
+static int M = 1024, N = 1024, width = 4;
+static char *A, *B;
+
+#ifndef MEMREC
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+#endif
+
+// Run one transpose; for K_SQUARE, B holds a copy of A beforehand
+static void call(const entry_t *e) {
+  switch (e->kind) {
+  case K_TRANS:
+    trans(M, N, (int(*)[M])A, (int(*)[N])B);
+    break;
+  case K_SUBMIT:
+    transpose_submit(M, N, (int(*)[M])A, (int(*)[N])B);
+    break;
+  case K_XPOSE:
+    xpose(B, N, A, M, N, M, width, e->threads);
+    break;
+  case K_SQUARE:
+    xpose_square(B, N, N, width, e->threads);
+    break;
+  case K_TTRANS:
+    ttrans(M, N, A, B, width);
+    break;
+  case K_TTRANS_GENERIC:
+    ttrans_generic(M, N, A, B, width);
+    break;
+  }
+}
+
+// Get B ready for a call: cleared, or a copy of A for the in-place one
+static void prepare(const entry_t *e) {
+  if (e->kind == K_SQUARE) {
+    memcpy(B, A, (size_t)M * N * width);
+  } else {
+    memset(B, 0, (size_t)M * N * width);
+  }
+}
+
+// 1 if B is the transpose of A
+static int check(void) {
+  for (int i = 0; i < N; ++i) {
+    for (int j = 0; j < M; ++j) {
+      if (memcmp(A + ((size_t)i * M + j) * width,
+                 B + ((size_t)j * N + i) * width, width) != 0) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+static void printUsage() {
+#ifdef MEMREC
+  puts("Usage: ./xpose-bench-rec [-h] [-M <cols>] [-N <rows>] [-w <bytes>]");
+  puts("                         [-s <num>] [-E <num>] [-b <num>]");
+#else
+  puts("Usage: ./xpose-bench [-h] [-M <cols>] [-N <rows>] [-w <bytes>] "
+       "[-j <num>]");
+  puts("                     [-r <num>]");
+#endif
+  puts("Options:");
+  puts("  -h         Print this help message.");
+  puts("  -M <num>   Columns of A (default 1024).");
+  puts("  -N <num>   Rows of A (default 1024).");
+  puts("  -w <num>   Element width: 1, 2, 4 or 8 bytes (default 4).");
+#ifdef MEMREC
+  puts("  -s <num>   Number of set index bits (default 5).");
+  puts("  -E <num>   Number of lines per set (default 1).");
+  puts("  -b <num>   Number of block offset bits (default 5).");
+  puts("");
+  puts("Examples:");
+  puts(" linux>  ./xpose-bench-rec -M 64 -N 64");
+  puts(" linux>  ./xpose-bench-rec -M 1000 -N 1000 -s 6 -E 8 -b 6");
+#else
+  puts("  -j <num>   Threads for the last xpose row (default 1: no row).");
+  puts("  -r <num>   Runs of each transpose (default 10).");
+  puts("");
+  puts("Examples:");
+  puts(" linux>  ./xpose-bench -M 4096 -N 4096 -j 4");
+  puts(" linux>  ./xpose-bench -M 1000 -N 3000 -w 8");
+#endif
+}
+
+int main(int argc, char *argv[]) {
+  int threads = 1, runs = 10;
+  int opt;
+#ifdef MEMREC
+  int s = 5, E = 1, b = 5;
+  const char *opts = "hM:N:w:s:E:b:";
+#else
+  const char *opts = "hM:N:w:j:r:";
+#endif
+
+  while ((opt = getopt(argc, argv, opts)) != -1) {
+    switch (opt) {
+    case 'M':
+      M = atoi(optarg);
+      break;
+    case 'N':
+      N = atoi(optarg);
+      break;
+    case 'w':
+      width = atoi(optarg);
+      break;
+    case 'j':
+      threads = atoi(optarg);
+      break;
+    case 'r':
+      runs = atoi(optarg);
+      break;
+#ifdef MEMREC
+    case 's':
+      s = atoi(optarg);
+      break;
+    case 'E':
+      E = atoi(optarg);
+      break;
+    case 'b':
+      b = atoi(optarg);
+      break;
+#endif
+    case 'h':
+      printUsage();
+      exit(EXIT_SUCCESS);
+    default:
+      printUsage();
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (M <= 0 || N <= 0 || threads <= 0 || runs <= 0 ||
+      (width != 1 && width != 2 && width != 4 && width != 8)) {
+    printUsage();
+    exit(EXIT_FAILURE);
+  }
+
+  // A, then B at the next multiple of 4 KB
+  size_t bytes = (size_t)M * N * width;
+  size_t gap = (bytes + 4095) & ~(size_t)4095;
+  void *mem;
+  if (posix_memalign(&mem, 4096, 2 * gap) != 0) {
+    fputs("xpose-bench: out of memory\n", stderr);
+    exit(EXIT_FAILURE);
+  }
+  A = (char *)mem;
+  B = A + gap;
+  uint64_t rng = 88172645463325252ULL;
+  for (size_t i = 0; i < bytes; ++i) {
+    rng ^= rng << 13; // xorshift64
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    A[i] = (char)rng;
+  }
+
+  entry_t entries[10];
+  int n = 0;
+  if (width == 4) {
+    entries[n++] = (entry_t){"trans", K_TRANS, NULL, 1};
+    entries[n++] = (entry_t){"transpose_submit", K_SUBMIT, NULL, 1};
+  }
+  const char *isas[] = {"scalar", "sse2", "avx2"};
+  const char *best = "scalar";
+  for (int i = 0; i < 3; ++i) {
+    if (xpose_use_isa(isas[i]) == 0) {
+      entries[n++] = (entry_t){"xpose", K_XPOSE, isas[i], 1};
+      best = isas[i];
+    }
+  }
+  if (threads > 1) {
+    entries[n++] = (entry_t){"xpose", K_XPOSE, best, threads};
+  }
+  if (M == N) {
+    entries[n++] = (entry_t){"xpose_square", K_SQUARE, best, threads};
+  }
+  if ((width == 4 || width == 8) && ttrans_specialized(M, N, width)) {
+    entries[n++] = (entry_t){"ttrans", K_TTRANS, "fixed", 1};
+  }
+  if (width == 4 || width == 8) {
+    entries[n++] = (entry_t){"ttrans", K_TTRANS_GENERIC, "generic", 1};
+  }
+
+#ifdef MEMREC
+  printf("%d x %d, %d-byte elements, s=%d E=%d b=%d\n", N, M, width, s, E, b);
+  printf("%-18s %-7s %12s %12s %12s\n", "transpose", "isa", "hits", "misses",
+         "evictions");
+#else
+  printf("%d x %d, %d-byte elements, best of %d runs\n", N, M, width, runs);
+  printf("%-18s %-7s %7s %10s %10s %10s\n", "transpose", "isa", "threads",
+         "ms", "ns/elem", "GB/s");
+#endif
+  for (int i = 0; i < n; ++i) {
+    entry_t *e = &entries[i];
+    if (e->kind != K_TTRANS && e->kind != K_TTRANS_GENERIC &&
+        e->isa != NULL) {
+      xpose_use_isa(e->isa);
+    }
+#ifdef MEMREC
+    uint64_t hits, misses, evictions;
+    prepare(e);
+    if (memrec_open(s, E, b, NULL, NULL, NULL) < 0) {
+      fputs("xpose-bench-rec: cannot create the cache\n", stderr);
+      exit(EXIT_FAILURE);
+    }
+    memrec_start();
+    call(e);
+    memrec_stop();
+    memrec_close(&hits, &misses, &evictions);
+#else
+    double best_secs = 0;
+    for (int r = 0; r < runs; ++r) {
+      prepare(e);
+      double start = now();
+      call(e);
+      double secs = now() - start;
+      if (r == 0 || secs < best_secs) {
+        best_secs = secs;
+      }
+    }
+#endif
+    if (!check()) {
+      // transpose_submit only handles the lab's sizes
+      printf("%-18s %-7s (wrong result)\n", e->name, e->isa ? e->isa : "-");
+      continue;
+    }
+#ifdef MEMREC
+    printf("%-18s %-7s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n", e->name,
+           e->isa ? e->isa : "-", hits, misses, evictions);
+#else
+    printf("%-18s %-7s %7d %10.3f %10.3f %10.2f\n", e->name,
+           e->isa ? e->isa : "-", e->threads, best_secs * 1e3,
+           best_secs * 1e9 / ((double)M * N), 2.0 * bytes / best_secs / 1e9);
+#endif
+  }
+  free(mem);
+  return 0;
+}
@@ -0,0 +1,509 @@
+// xpose.c - Cache-oblivious transpose with SIMD tile kernels (see xpose.h)
+#define _POSIX_C_SOURCE 200112L
+#include "xpose.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define XPOSE_X86
+#endif
+
+// Pieces with both sides at most this many elements are cut into tiles.
+// A multiple of every tile size.
+#define LEAF 32
+
+// Threads get bands of a multiple of this many elements, so that no two
+// of them write to the same host line
+#define BAND_ALIGN 64
+
+// Transpose one k x k tile; the strides are in bytes
+typedef void (*tile_fn)(char *dst, size_t ldd, const char *src, size_t lds);
+
+// The kernel for one element width. fn is NULL for the scalar loop.
+typedef struct {
+  int k;
+  tile_fn fn;
+} kernel_t;
+
+// What the recursion needs to know
+typedef struct {
+  size_t w;  // element width in bytes
+  int k;     // tile size
+  tile_fn fn;
+} ctx_t;
+
+// The kernels of each instruction set, indexed by log2 of the width
+typedef struct {
+  const char *name;
+  kernel_t kernels[4];
+} isa_t;
+
+#ifdef __SSE2__
+static void tile8_sse2(char *d, size_t ldd, const char *s, size_t lds) {
+  __m128i r0 = _mm_loadl_epi64((const __m128i *)s);
+  __m128i r1 = _mm_loadl_epi64((const __m128i *)(s + lds));
+  __m128i r2 = _mm_loadl_epi64((const __m128i *)(s + 2 * lds));
+  __m128i r3 = _mm_loadl_epi64((const __m128i *)(s + 3 * lds));
+  __m128i r4 = _mm_loadl_epi64((const __m128i *)(s + 4 * lds));
+  __m128i r5 = _mm_loadl_epi64((const __m128i *)(s + 5 * lds));
+  __m128i r6 = _mm_loadl_epi64((const __m128i *)(s + 6 * lds));
+  __m128i r7 = _mm_loadl_epi64((const __m128i *)(s + 7 * lds));
+  __m128i t0 = _mm_unpacklo_epi8(r0, r1);
+  __m128i t1 = _mm_unpacklo_epi8(r2, r3);
+  __m128i t2 = _mm_unpacklo_epi8(r4, r5);
+  __m128i t3 = _mm_unpacklo_epi8(r6, r7);
+  __m128i u0 = _mm_unpacklo_epi16(t0, t1);
+  __m128i u1 = _mm_unpackhi_epi16(t0, t1);
+  __m128i u2 = _mm_unpacklo_epi16(t2, t3);
+  __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+  __m128i v0 = _mm_unpacklo_epi32(u0, u2); // columns 0 and 1
+  __m128i v1 = _mm_unpackhi_epi32(u0, u2);
+  __m128i v2 = _mm_unpacklo_epi32(u1, u3);
+  __m128i v3 = _mm_unpackhi_epi32(u1, u3);
+  _mm_storel_epi64((__m128i *)d, v0);
+  _mm_storel_epi64((__m128i *)(d + ldd), _mm_srli_si128(v0, 8));
+  _mm_storel_epi64((__m128i *)(d + 2 * ldd), v1);
+  _mm_storel_epi64((__m128i *)(d + 3 * ldd), _mm_srli_si128(v1, 8));
+  _mm_storel_epi64((__m128i *)(d + 4 * ldd), v2);
+  _mm_storel_epi64((__m128i *)(d + 5 * ldd), _mm_srli_si128(v2, 8));
+  _mm_storel_epi64((__m128i *)(d + 6 * ldd), v3);
+  _mm_storel_epi64((__m128i *)(d + 7 * ldd), _mm_srli_si128(v3, 8));
+}
+
+static void tile16_sse2(char *d, size_t ldd, const char *s, size_t lds) {
+  __m128i r0 = _mm_loadu_si128((const __m128i *)s);
+  __m128i r1 = _mm_loadu_si128((const __m128i *)(s + lds));
+  __m128i r2 = _mm_loadu_si128((const __m128i *)(s + 2 * lds));
+  __m128i r3 = _mm_loadu_si128((const __m128i *)(s + 3 * lds));
+  __m128i r4 = _mm_loadu_si128((const __m128i *)(s + 4 * lds));
+  __m128i r5 = _mm_loadu_si128((const __m128i *)(s + 5 * lds));
+  __m128i r6 = _mm_loadu_si128((const __m128i *)(s + 6 * lds));
+  __m128i r7 = _mm_loadu_si128((const __m128i *)(s + 7 * lds));
+  __m128i t0 = _mm_unpacklo_epi16(r0, r1);
+  __m128i t1 = _mm_unpackhi_epi16(r0, r1);
+  __m128i t2 = _mm_unpacklo_epi16(r2, r3);
+  __m128i t3 = _mm_unpackhi_epi16(r2, r3);
+  __m128i t4 = _mm_unpacklo_epi16(r4, r5);
+  __m128i t5 = _mm_unpackhi_epi16(r4, r5);
+  __m128i t6 = _mm_unpacklo_epi16(r6, r7);
+  __m128i t7 = _mm_unpackhi_epi16(r6, r7);
+  __m128i u0 = _mm_unpacklo_epi32(t0, t2); // rows 0-3 of columns 0 and 1
+  __m128i u1 = _mm_unpackhi_epi32(t0, t2);
+  __m128i u2 = _mm_unpacklo_epi32(t1, t3);
+  __m128i u3 = _mm_unpackhi_epi32(t1, t3);
+  __m128i u4 = _mm_unpacklo_epi32(t4, t6); // rows 4-7 of columns 0 and 1
+  __m128i u5 = _mm_unpackhi_epi32(t4, t6);
+  __m128i u6 = _mm_unpacklo_epi32(t5, t7);
+  __m128i u7 = _mm_unpackhi_epi32(t5, t7);
+  _mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi64(u0, u4));
+  _mm_storeu_si128((__m128i *)(d + ldd), _mm_unpackhi_epi64(u0, u4));
+  _mm_storeu_si128((__m128i *)(d + 2 * ldd), _mm_unpacklo_epi64(u1, u5));
+  _mm_storeu_si128((__m128i *)(d + 3 * ldd), _mm_unpackhi_epi64(u1, u5));
+  _mm_storeu_si128((__m128i *)(d + 4 * ldd), _mm_unpacklo_epi64(u2, u6));
+  _mm_storeu_si128((__m128i *)(d + 5 * ldd), _mm_unpackhi_epi64(u2, u6));
+  _mm_storeu_si128((__m128i *)(d + 6 * ldd), _mm_unpacklo_epi64(u3, u7));
+  _mm_storeu_si128((__m128i *)(d + 7 * ldd), _mm_unpackhi_epi64(u3, u7));
+}
+
+static void tile32_sse2(char *d, size_t ldd, const char *s, size_t lds) {
+  __m128i r0 = _mm_loadu_si128((const __m128i *)s);
+  __m128i r1 = _mm_loadu_si128((const __m128i *)(s + lds));
+  __m128i r2 = _mm_loadu_si128((const __m128i *)(s + 2 * lds));
+  __m128i r3 = _mm_loadu_si128((const __m128i *)(s + 3 * lds));
+  __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+  __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+  __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+  __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+  _mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi64(t0, t1));
+  _mm_storeu_si128((__m128i *)(d + ldd), _mm_unpackhi_epi64(t0, t1));
+  _mm_storeu_si128((__m128i *)(d + 2 * ldd), _mm_unpacklo_epi64(t2, t3));
+  _mm_storeu_si128((__m128i *)(d + 3 * ldd), _mm_unpackhi_epi64(t2, t3));
+}
+
+static void tile64_sse2(char *d, size_t ldd, const char *s, size_t lds) {
+  __m128i r0 = _mm_loadu_si128((const __m128i *)s);
+  __m128i r1 = _mm_loadu_si128((const __m128i *)(s + lds));
+  _mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi64(r0, r1));
+  _mm_storeu_si128((__m128i *)(d + ldd), _mm_unpackhi_epi64(r0, r1));
+}
+#endif
+
+#ifdef XPOSE_X86
+__attribute__((target("avx2"))) static void
+tile32_avx2(char *d, size_t ldd, const char *s, size_t lds) {
+  __m256 r0 = _mm256_loadu_ps((const float *)s);
+  __m256 r1 = _mm256_loadu_ps((const float *)(s + lds));
+  __m256 r2 = _mm256_loadu_ps((const float *)(s + 2 * lds));
+  __m256 r3 = _mm256_loadu_ps((const float *)(s + 3 * lds));
+  __m256 r4 = _mm256_loadu_ps((const float *)(s + 4 * lds));
+  __m256 r5 = _mm256_loadu_ps((const float *)(s + 5 * lds));
+  __m256 r6 = _mm256_loadu_ps((const float *)(s + 6 * lds));
+  __m256 r7 = _mm256_loadu_ps((const float *)(s + 7 * lds));
+  __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+  __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+  __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+  __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+  __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+  __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+  __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+  __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+  __m256 u0 = _mm256_shuffle_ps(t0, t2, 0x44); // rows 0-3, columns 0 and 4
+  __m256 u1 = _mm256_shuffle_ps(t0, t2, 0xee);
+  __m256 u2 = _mm256_shuffle_ps(t1, t3, 0x44);
+  __m256 u3 = _mm256_shuffle_ps(t1, t3, 0xee);
+  __m256 u4 = _mm256_shuffle_ps(t4, t6, 0x44); // rows 4-7, columns 0 and 4
+  __m256 u5 = _mm256_shuffle_ps(t4, t6, 0xee);
+  __m256 u6 = _mm256_shuffle_ps(t5, t7, 0x44);
+  __m256 u7 = _mm256_shuffle_ps(t5, t7, 0xee);
+  _mm256_storeu_ps((float *)d, _mm256_permute2f128_ps(u0, u4, 0x20));
+  _mm256_storeu_ps((float *)(d + ldd), _mm256_permute2f128_ps(u1, u5, 0x20));
+  _mm256_storeu_ps((float *)(d + 2 * ldd), _mm256_permute2f128_ps(u2, u6, 0x20));
+  _mm256_storeu_ps((float *)(d + 3 * ldd), _mm256_permute2f128_ps(u3, u7, 0x20));
+  _mm256_storeu_ps((float *)(d + 4 * ldd), _mm256_permute2f128_ps(u0, u4, 0x31));
+  _mm256_storeu_ps((float *)(d + 5 * ldd), _mm256_permute2f128_ps(u1, u5, 0x31));
+  _mm256_storeu_ps((float *)(d + 6 * ldd), _mm256_permute2f128_ps(u2, u6, 0x31));
+  _mm256_storeu_ps((float *)(d + 7 * ldd), _mm256_permute2f128_ps(u3, u7, 0x31));
+}
+
+__attribute__((target("avx2"))) static void
+tile64_avx2(char *d, size_t ldd, const char *s, size_t lds) {
+  __m256d r0 = _mm256_loadu_pd((const double *)s);
+  __m256d r1 = _mm256_loadu_pd((const double *)(s + lds));
+  __m256d r2 = _mm256_loadu_pd((const double *)(s + 2 * lds));
+  __m256d r3 = _mm256_loadu_pd((const double *)(s + 3 * lds));
+  __m256d t0 = _mm256_unpacklo_pd(r0, r1); // columns 0 and 2 of rows 0-1
+  __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+  __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+  __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+  _mm256_storeu_pd((double *)d, _mm256_permute2f128_pd(t0, t2, 0x20));
+  _mm256_storeu_pd((double *)(d + ldd), _mm256_permute2f128_pd(t1, t3, 0x20));
+  _mm256_storeu_pd((double *)(d + 2 * ldd), _mm256_permute2f128_pd(t0, t2, 0x31));
+  _mm256_storeu_pd((double *)(d + 3 * ldd), _mm256_permute2f128_pd(t1, t3, 0x31));
+}
+#endif
+
+static const isa_t isas[] = {
+    {"scalar", {{1, NULL}, {1, NULL}, {1, NULL}, {1, NULL}}},
+#ifdef __SSE2__
+    {"sse2",
+     {{8, tile8_sse2}, {8, tile16_sse2}, {4, tile32_sse2}, {2, tile64_sse2}}},
+#endif
+#ifdef XPOSE_X86
+    {"avx2",
+     {{8, tile8_sse2}, {8, tile16_sse2}, {8, tile32_avx2}, {4, tile64_avx2}}},
+#endif
+};
+#define NUM_ISAS ((int)(sizeof(isas) / sizeof(isas[0])))
+
+static const isa_t *isa = NULL;
+static pthread_once_t isa_once = PTHREAD_ONCE_INIT;
+
+static int supported(const isa_t *x) {
+#ifdef XPOSE_X86
+  if (strcmp(x->name, "avx2") == 0) {
+    return __builtin_cpu_supports("avx2");
+  }
+#endif
+  return 1;
+}
+
+// The widest instruction set the host supports, or the one XPOSE_ISA names
+static void pick_isa(void) {
+  const char *want = getenv("XPOSE_ISA");
+
+  isa = &isas[0];
+  for (int i = 1; i < NUM_ISAS && supported(&isas[i]); ++i) {
+    isa = &isas[i];
+    if (want != NULL && strcmp(want, isa->name) == 0) {
+      return;
+    }
+  }
+  if (want != NULL && strcmp(want, "scalar") == 0) {
+    isa = &isas[0];
+  }
+}
+
+int xpose_use_isa(const char *name) {
+  pthread_once(&isa_once, pick_isa);
+  for (int i = 0; i < NUM_ISAS; ++i) {
+    if (strcmp(name, isas[i].name) == 0 && supported(&isas[i])) {
+      isa = &isas[i];
+      return 0;
+    }
+  }
+  return -1;
+}
+
+const char *xpose_isa(void) {
+  pthread_once(&isa_once, pick_isa);
+  return isa->name;
+}
+
+// Element-wise transpose of a rows x cols piece; strides in bytes
+#define SCALAR(T)                                                              \
+  for (size_t i = 0; i < rows; ++i) {                                          \
+    const T *s = (const T *)(src + i * lds);                                   \
+    for (size_t j = 0; j < cols; ++j) {                                        \
+      *(T *)(dst + j * ldd + i * sizeof(T)) = s[j];                            \
+    }                                                                          \
+  }
+
+static void scalar(const ctx_t *cx, char *dst, size_t ldd, const char *src,
+                   size_t lds, size_t rows, size_t cols) {
+  switch (cx->w) {
+  case 1:
+    SCALAR(uint8_t);
+    break;
+  case 2:
+    SCALAR(uint16_t);
+    break;
+  case 4:
+    SCALAR(uint32_t);
+    break;
+  default:
+    SCALAR(uint64_t);
+    break;
+  }
+}
+
+// Copy n elements. gcc turns the loops into memcpy, except in the build
+// for memrec.c, which disables that so the accesses are seen.
+#define COPY(T)                                                                \
+  for (size_t i = 0; i < n; ++i) {                                             \
+    ((T *)dst)[i] = ((const T *)src)[i];                                       \
+  }
+
+static void copy(const ctx_t *cx, char *dst, const char *src, size_t n) {
+  switch (cx->w) {
+  case 1:
+    COPY(uint8_t);
+    break;
+  case 2:
+    COPY(uint16_t);
+    break;
+  case 4:
+    COPY(uint32_t);
+    break;
+  default:
+    COPY(uint64_t);
+    break;
+  }
+}
+
+// Cut a piece into tiles, and do the edges one element at a time
+static void leaf(const ctx_t *cx, char *dst, size_t ldd, const char *src,
+                 size_t lds, size_t rows, size_t cols) {
+  if (cx->fn == NULL) {
+    scalar(cx, dst, ldd, src, lds, rows, cols);
+    return;
+  }
+  size_t k = (size_t)cx->k, w = cx->w;
+  size_t full_rows = rows / k * k, full_cols = cols / k * k;
+  for (size_t i = 0; i < full_rows; i += k) {
+    for (size_t j = 0; j < full_cols; j += k) {
+      cx->fn(dst + j * ldd + i * w, ldd, src + i * lds + j * w, lds);
+    }
+  }
+  scalar(cx, dst + full_cols * ldd, ldd, src + full_cols * w, lds, full_rows,
+         cols - full_cols);
+  scalar(cx, dst + full_rows * w, ldd, src + full_rows * lds, lds,
+         rows - full_rows, cols);
+}
+
+// Split point of a side longer than LEAF, on a tile boundary
+static size_t half(size_t n) { return (n / 2 + 7) & ~(size_t)7; }
+
+static void rec(const ctx_t *cx, char *dst, size_t ldd, const char *src,
+                size_t lds, size_t rows, size_t cols) {
+  if (rows <= LEAF && cols <= LEAF) {
+    leaf(cx, dst, ldd, src, lds, rows, cols);
+  } else if (rows >= cols) {
+    size_t h = half(rows);
+    rec(cx, dst, ldd, src, lds, h, cols);
+    rec(cx, dst + h * cx->w, ldd, src + h * lds, lds, rows - h, cols);
+  } else {
+    size_t h = half(cols);
+    rec(cx, dst, ldd, src, lds, rows, h);
+    rec(cx, dst + h * ldd, ldd, src + h * cx->w, lds, rows, cols - h);
+  }
+}
+
+// Exchange the rows x cols block p with the cols x rows block q, each
+// becoming the transpose of the other. Both have row stride ld.
+static void swap(const ctx_t *cx, char *p, char *q, size_t ld, size_t rows,
+                 size_t cols) {
+  if (rows <= LEAF && cols <= LEAF) {
+    uint64_t buf[LEAF * LEAF];
+    size_t row = rows * cx->w;
+    leaf(cx, (char *)buf, row, p, ld, rows, cols);
+    leaf(cx, p, ld, q, ld, cols, rows);
+    for (size_t j = 0; j < cols; ++j) {
+      copy(cx, q + j * ld, (char *)buf + j * row, rows);
+    }
+  } else if (rows >= cols) {
+    size_t h = half(rows);
+    swap(cx, p, q, ld, h, cols);
+    swap(cx, p + h * ld, q + h * cx->w, ld, rows - h, cols);
+  } else {
+    size_t h = half(cols);
+    swap(cx, p, q, ld, rows, h);
+    swap(cx, p + h * cx->w, q + h * ld, ld, rows, cols - h);
+  }
+}
+
+// In-place transpose of the n x n block at a
+static void diag(const ctx_t *cx, char *a, size_t ld, size_t n) {
+  if (n <= LEAF) {
+    uint64_t buf[LEAF * LEAF];
+    size_t row = n * cx->w;
+    leaf(cx, (char *)buf, row, a, ld, n, n);
+    for (size_t i = 0; i < n; ++i) {
+      copy(cx, a + i * ld, (char *)buf + i * row, n);
+    }
+    return;
+  }
+  size_t h = half(n);
+  diag(cx, a, ld, h);
+  diag(cx, a + h * ld + h * cx->w, ld, n - h);
+  swap(cx, a + h * cx->w, a + h * ld, ld, h, n - h);
+}
+
+// One call, shared by its threads
+typedef struct {
+  ctx_t cx;
+  char *dst;
+  const char *src;
+  size_t ldd, lds;  // in bytes
+  size_t rows, cols;
+  size_t band;      // elements per band
+  int square;
+  int threads;
+} work_t;
+
+typedef struct {
+  const work_t *wk;
+  int id;
+} part_t;
+
+// Thread id does every threads-th band: the columns of the source (rows
+// of the destination), or for a square matrix the blocks on and above the
+// diagonal of a grid of bands
+static void run_part(const work_t *wk, int id) {
+  size_t w = wk->cx.w, band = wk->band;
+  size_t bands = (wk->cols + band - 1) / band;
+
+  if (!wk->square) {
+    for (size_t b = id; b < bands; b += wk->threads) {
+      size_t c0 = b * band, c1 = c0 + band < wk->cols ? c0 + band : wk->cols;
+      rec(&wk->cx, wk->dst + c0 * wk->ldd, wk->ldd, wk->src + c0 * w, wk->lds,
+          wk->rows, c1 - c0);
+    }
+    return;
+  }
+  size_t job = 0;
+  for (size_t bi = 0; bi < bands; ++bi) {
+    for (size_t bj = bi; bj < bands; ++bj, ++job) {
+      if (job % wk->threads != (size_t)id) {
+        continue;
+      }
+      size_t i0 = bi * band, j0 = bj * band;
+      size_t ni = i0 + band < wk->cols ? band : wk->cols - i0;
+      size_t nj = j0 + band < wk->cols ? band : wk->cols - j0;
+      if (bi == bj) {
+        diag(&wk->cx, wk->dst + i0 * wk->ldd + i0 * w, wk->ldd, ni);
+      } else {
+        swap(&wk->cx, wk->dst + i0 * wk->ldd + j0 * w,
+             wk->dst + j0 * wk->ldd + i0 * w, wk->ldd, ni, nj);
+      }
+    }
+  }
+}
+
+static void *thread_main(void *arg) {
+  part_t *pt = (part_t *)arg;
+  run_part(pt->wk, pt->id);
+  return NULL;
+}
+
+// Run the parts on wk->threads threads, the caller being one of them. A
+// part whose thread cannot be started is run by the caller.
+static void run(work_t *wk) {
+  if (wk->threads <= 1) {
+    wk->threads = 1;
+    wk->band = wk->cols;
+    run_part(wk, 0);
+    return;
+  }
+  size_t band = (wk->cols + wk->threads - 1) / wk->threads;
+  wk->band = (band + BAND_ALIGN - 1) / BAND_ALIGN * BAND_ALIGN;
+
+  pthread_t tids[wk->threads];
+  part_t parts[wk->threads];
+  int started[wk->threads];
+  for (int t = 1; t < wk->threads; ++t) {
+    parts[t].wk = wk;
+    parts[t].id = t;
+    started[t] = pthread_create(&tids[t], NULL, thread_main, &parts[t]) == 0;
+  }
+  run_part(wk, 0);
+  for (int t = 1; t < wk->threads; ++t) {
+    if (started[t]) {
+      pthread_join(tids[t], NULL);
+    } else {
+      run_part(wk, t);
+    }
+  }
+}
+
+static int setup(work_t *wk, size_t width, int threads) {
+  int lg = width == 1 ? 0 : width == 2 ? 1 : width == 4 ? 2 : width == 8 ? 3 : -1;
+  if (lg < 0) {
+    return -1;
+  }
+  pthread_once(&isa_once, pick_isa);
+  wk->cx.w = width;
+  wk->cx.k = isa->kernels[lg].k;
+  wk->cx.fn = isa->kernels[lg].fn;
+  wk->threads = threads;
+  return 0;
+}
+
+int xpose(void *dst, size_t ldd, const void *src, size_t lds, size_t rows,
+          size_t cols, size_t width, int threads) {
+  work_t wk;
+
+  if (setup(&wk, width, threads) < 0 || ldd < rows || lds < cols) {
+    return -1;
+  }
+  wk.dst = (char *)dst;
+  wk.src = (const char *)src;
+  wk.ldd = ldd * width;
+  wk.lds = lds * width;
+  wk.rows = rows;
+  wk.cols = cols;
+  wk.square = 0;
+  if (rows > 0 && cols > 0) {
+    run(&wk);
+  }
+  return 0;
+}
+
+int xpose_square(void *a, size_t lda, size_t n, size_t width, int threads) {
+  work_t wk;
+
+  if (setup(&wk, width, threads) < 0 || lda < n) {
+    return -1;
+  }
+  wk.dst = (char *)a;
+  wk.src = (const char *)a;
+  wk.ldd = wk.lds = lda * width;
+  wk.rows = wk.cols = n;
+  wk.square = 1;
+  if (n > 0) {
+    run(&wk);
+  }
+  return 0;
+}
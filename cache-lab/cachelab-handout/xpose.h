@@ -0,0 +1,48 @@
+// xpose.h - Matrix transpose for any size and element width
+//
+// transpose_submit in trans.c handles three sizes of int matrices and is
+// tuned for the 1 KB direct-mapped cache of the lab. This is the general
+// version. Matrices are row-major, with elements of 1, 2, 4 or 8 bytes and
+// a row stride that may exceed the row length.
+//
+// The transpose is cache-oblivious. The matrix is halved along its longer
+// side until the pieces are a few tiles wide, so at some depth a piece of
+// the source and of the destination fit in every level of cache, whatever
+// their sizes. The pieces are then cut into square tiles that a kernel
+// transposes in registers:
+//
+//   width   avx2   sse2   scalar
+//   1       -      8x8    1x1
+//   2       -      8x8    1x1
+//   4       8x8    4x4    1x1
+//   8       4x4    2x2    1x1
+//
+// The widest kernel the host supports is used, unless XPOSE_ISA names
+// another ("scalar", "sse2" or "avx2"). Edges that do not fill a tile are
+// transposed element by element.
+#ifndef XPOSE_H
+#define XPOSE_H
+
+#include <stddef.h>
+
+// Transpose the rows x cols matrix src, whose rows are lds elements apart,
+// into the cols x rows matrix dst, whose rows are ldd elements apart. The
+// matrices must not overlap. With threads > 1 the work is split into bands
+// run by that many threads (the caller runs the bands of a thread that
+// cannot be started). Returns 0, or -1 if width is not 1, 2, 4 or 8 or a
+// stride is shorter than its row.
+int xpose(void *dst, size_t ldd, const void *src, size_t lds, size_t rows,
+          size_t cols, size_t width, int threads);
+
+// Transpose the n x n matrix a, with rows lda elements apart, in place.
+// Returns 0 or -1 as xpose does.
+int xpose_square(void *a, size_t lda, size_t n, size_t width, int threads);
+
+// Use the kernels of the named instruction set. Returns 0, or -1 if the
+// name is unknown or the host does not support it.
+int xpose_use_isa(const char *name);
+
+// The instruction set in use: "scalar", "sse2" or "avx2"
+const char *xpose_isa(void);
+
+#endif
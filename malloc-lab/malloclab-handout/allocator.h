@@ -0,0 +1,27 @@
+/*
+ * allocator.h - A table of entry points for every malloc package that
+ *     mmbench can run side by side
+ *
+ * Each mm-*.c variant defines the same mm_init/mm_malloc/... symbols,
+ * so the Makefile compiles it once more for mmbench with its entry
+ * points renamed to bench_<variant>_init and so on (see BENCH_RENAME).
+ * To add a variant, list it in VARIANTS in the Makefile and add a line
+ * for it to the registry in allocators.c. A package without memalign
+ * or calloc leaves it NULL: mmbench then skips the traces with memalign
+ * requests and serves calloc with malloc and memset.
+ */
+#include <stddef.h>
+
+typedef struct {
+    char *name;                          /* name printed in the table */
+    int uses_memlib;                     /* heap lives in memlib.c? */
+    int (*init)(void);
+    void *(*malloc)(size_t size);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, size_t size);
+    void *(*memalign)(size_t align, size_t size); /* NULL if there is none */
+    void *(*calloc)(size_t nmemb, size_t size);   /* NULL if there is none */
+} allocator_t;
+
+/* The registry, terminated by an entry whose name is NULL */
+extern allocator_t allocators[];
@@ -0,0 +1,62 @@
+/*
+ * allocators.c - The registry of malloc packages run by mmbench
+ */
+#include <stdlib.h>
+
+#include "allocator.h"
+
+/* Declare the renamed entry points of one mm-*.c variant */
+#define DECLARE_VARIANT(v)				\
+    extern int bench_##v##_init(void);			\
+    extern void *bench_##v##_malloc(size_t size);	\
+    extern void bench_##v##_free(void *ptr);		\
+    extern void *bench_##v##_realloc(void *ptr, size_t size)
+
+/* ... and of a variant that also has mm_memalign and mm_calloc */
+#define DECLARE_FULL_VARIANT(v)						\
+    DECLARE_VARIANT(v);							\
+    extern void *bench_##v##_memalign(size_t align, size_t size);	\
+    extern void *bench_##v##_calloc(size_t nmemb, size_t size)
+
+/* The registry entry of one mm-*.c variant */
+#define VARIANT(name, v)						\
+    {name, 1, bench_##v##_init, bench_##v##_malloc, bench_##v##_free,	\
+     bench_##v##_realloc, NULL, NULL}
+#define FULL_VARIANT(name, v)						\
+    {name, 1, bench_##v##_init, bench_##v##_malloc, bench_##v##_free,	\
+     bench_##v##_realloc, bench_##v##_memalign, bench_##v##_calloc}
+
+DECLARE_FULL_VARIANT(mm);
+DECLARE_VARIANT(mm_segregated);
+DECLARE_VARIANT(mm_explicit);
+DECLARE_VARIANT(mm_implicit);
+
+static int libc_init(void);
+static void *libc_memalign(size_t align, size_t size);
+
+allocator_t allocators[] = {
+    FULL_VARIANT("mm", mm),
+    VARIANT("segregated", mm_segregated),
+    VARIANT("explicit", mm_explicit),
+    VARIANT("implicit", mm_implicit),
+    {"libc", 0, libc_init, malloc, free, realloc, libc_memalign, calloc},
+    {NULL}
+};
+
+/*
+ * libc_init - The libc package needs no initialization
+ */
+static int libc_init(void)
+{
+    return 0;
+}
+
+/*
+ * libc_memalign - posix_memalign in the shape of mm_memalign
+ */
+static void *libc_memalign(size_t align, size_t size)
+{
+    void *p;
+
+    return posix_memalign(&p, align, size) == 0 ? p : NULL;
+}
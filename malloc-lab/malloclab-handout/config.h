@@ -10,9 +10,11 @@
 
 /*
  * This is the default path where the driver will look for the
- * default tracefiles. You can override it at runtime with the -t flag.
+ * default tracefiles: the repo's traces directory, seen from this one,
+ * where mdriver is built and run. You can override it at runtime with
+ * the -t flag.
  */
-#define TRACEDIR "/afs/cs/project/ics2/im/labs/malloclab/traces/"
+#define TRACEDIR "../traces/"
 
 /*
  * This is the list of default tracefiles in TRACEDIR that the driver
@@ -62,6 +64,11 @@
  */
 #define MAX_HEAP (20*(1<<20))  /* 20 MB */
 
+/* 
+ * Maximum size in bytes of the region handed out by mem_map
+ */
+#define MAX_MAP (20*(1<<20))  /* 20 MB */
+
 /*****************************************************************************
  * Set exactly one of these USE_xxx constants to "1" to select a timing method
  *****************************************************************************/
@@ -0,0 +1,220 @@
+/*
+ * heapstat.c - Fragmentation analysis for the malloc driver
+ *
+ * While the driver replays a trace, hs_sample() walks the heap with
+ * mm_walk() every so many operations and splits it into
+ *
+ *   payload   bytes the trace asked for in its live blocks,
+ *   meta      headers, footers and slab run headers of those blocks,
+ *   padding   the rest of the allocated blocks (alignment, minimum
+ *             block size, unused slab slots): internal fragmentation,
+ *   free      free blocks: external fragmentation,
+ *
+ * along with the number of free blocks, the largest one, and a
+ * histogram of free block sizes per free list. Each sample can be
+ * written as a CSV row for plotting; hs_summary() prints the averages
+ * over a trace and the histogram at the point where the most memory
+ * sat in free blocks.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "heapstat.h"
+
+/* What one walk of the heap found */
+typedef struct {
+    int opnum;                  /* op after which the walk was done */
+    size_t heap;                /* heap size */
+    size_t payload;             /* bytes asked for by the trace */
+    size_t alloc;               /* bytes in allocated blocks ... */
+    size_t meta;                /* ... of which headers and footers */
+    size_t free;                /* bytes in free blocks */
+    size_t free_blocks;         /* number of free blocks */
+    size_t largest;             /* largest free block */
+    size_t hist[HS_NLISTS][HS_NBUCKETS]; /* free blocks by list and size */
+} sample_t;
+
+static FILE *csv = NULL;        /* CSV output, or NULL */
+static sample_t cur;            /* the walk in progress */
+static sample_t worst;          /* the sample with the most free bytes */
+static int num_lists;           /* lists seen in this trace */
+
+/* Running sums over the samples of the current trace */
+static int num_samples;
+static double sum_internal, sum_meta, sum_external;
+static size_t min_largest, max_largest;
+static double sum_largest;
+
+static char *bucket_names[HS_NBUCKETS] = {
+    "<64", "<256", "<1K", "<4K", "<16K", "<64K", "<256K", ">=256K"
+};
+
+static void visit(void *bp, size_t size, size_t meta, int alloc, int list);
+static void reset(void);
+
+/*
+ * hs_open - Open the CSV file and write its header
+ */
+void hs_open(char *csvfile)
+{
+    int i, k;
+
+    reset();
+    if (csvfile == NULL)
+	return;
+    if ((csv = fopen(csvfile, "w")) == NULL) {
+	fprintf(stderr, "Could not open %s for writing\n", csvfile);
+	exit(1);
+    }
+    fprintf(csv, "trace,op,heap,payload,alloc,meta,padding,free,"
+	    "free_blocks,largest_free");
+    for (k = 0; k < HS_NBUCKETS; k++)
+	fprintf(csv, ",free%s", bucket_names[k]);
+    for (i = 0; i < HS_NLISTS; i++)
+	fprintf(csv, ",list%d", i);
+    fprintf(csv, "\n");
+}
+
+/*
+ * hs_sample - Walk the heap and record what it holds
+ */
+void hs_sample(int tracenum, int opnum, size_t payload)
+{
+    size_t internal, total;
+    int i, k;
+
+    memset(&cur, 0, sizeof(cur));
+    cur.opnum = opnum;
+    cur.heap = mem_heapsize();
+    cur.payload = payload;
+    mm_walk(visit);
+
+    /* Update the running sums */
+    internal = cur.alloc - cur.payload;
+    if (cur.alloc > 0) {
+	sum_internal += (double)internal / cur.alloc;
+	sum_meta += (double)cur.meta / cur.alloc;
+    }
+    if (cur.alloc + cur.free > 0)
+	sum_external += (double)cur.free / (cur.alloc + cur.free);
+    sum_largest += cur.largest;
+    if (num_samples == 0 || cur.largest < min_largest)
+	min_largest = cur.largest;
+    if (cur.largest > max_largest)
+	max_largest = cur.largest;
+    if (num_samples == 0 || cur.free > worst.free)
+	worst = cur;
+    num_samples++;
+
+    if (csv == NULL)
+	return;
+    fprintf(csv, "%d,%d,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu", tracenum, opnum,
+	    (unsigned long)cur.heap, (unsigned long)cur.payload,
+	    (unsigned long)cur.alloc, (unsigned long)cur.meta,
+	    (unsigned long)(internal - cur.meta), (unsigned long)cur.free,
+	    (unsigned long)cur.free_blocks, (unsigned long)cur.largest);
+    for (k = 0; k < HS_NBUCKETS; k++) {
+	for (total = 0, i = 0; i < HS_NLISTS; i++)
+	    total += cur.hist[i][k];
+	fprintf(csv, ",%lu", (unsigned long)total);
+    }
+    for (i = 0; i < HS_NLISTS; i++) {
+	for (total = 0, k = 0; k < HS_NBUCKETS; k++)
+	    total += cur.hist[i][k];
+	fprintf(csv, ",%lu", (unsigned long)total);
+    }
+    fprintf(csv, "\n");
+}
+
+/*
+ * hs_summary - Print the averages over the samples of a trace and the
+ *     free block histogram of the sample with the most free bytes
+ */
+void hs_summary(int tracenum)
+{
+    int i, k;
+
+    if (num_samples == 0)
+	return;
+    printf("Trace %d heap layout over %d samples:\n", tracenum, num_samples);
+    printf("  internal fragmentation %5.1f%% of allocated bytes "
+	   "(headers/footers %.1f%%, padding %.1f%%)\n",
+	   100 * sum_internal / num_samples, 100 * sum_meta / num_samples,
+	   100 * (sum_internal - sum_meta) / num_samples);
+    printf("  external fragmentation %5.1f%% of heap blocks are free\n",
+	   100 * sum_external / num_samples);
+    printf("  largest free block     min %.1fKB, avg %.1fKB, max %.1fKB\n",
+	   min_largest / 1024.0, sum_largest / num_samples / 1024.0,
+	   max_largest / 1024.0);
+    printf("  most free bytes after op %d: %.1fKB in %lu blocks, "
+	   "largest %.1fKB\n", worst.opnum, worst.free / 1024.0,
+	   (unsigned long)worst.free_blocks, worst.largest / 1024.0);
+
+    if (worst.free_blocks > 0) {
+	printf("  %6s", "list");
+	for (k = 0; k < HS_NBUCKETS; k++)
+	    printf("%8s", bucket_names[k]);
+	printf("\n");
+	for (i = 0; i < num_lists; i++) {
+	    printf("  %6d", i);
+	    for (k = 0; k < HS_NBUCKETS; k++)
+		printf("%8lu", (unsigned long)worst.hist[i][k]);
+	    printf("\n");
+	}
+    }
+    reset();
+}
+
+/*
+ * hs_close - Close the CSV file
+ */
+void hs_close(void)
+{
+    if (csv != NULL)
+	fclose(csv);
+    csv = NULL;
+}
+
+/*
+ * visit - Account for one block of the heap; called by mm_walk()
+ */
+static void visit(void *bp, size_t size, size_t meta, int alloc, int list)
+{
+    int k;
+    size_t limit;
+
+    if (alloc) {
+	cur.alloc += size;
+	cur.meta += meta;
+	return;
+    }
+
+    cur.free += size;
+    cur.free_blocks++;
+    if (size > cur.largest)
+	cur.largest = size;
+    for (k = 0, limit = 64; k < HS_NBUCKETS - 1 && size >= limit; k++)
+	limit *= 4;
+    if (list < 0)
+	list = 0;
+    if (list >= HS_NLISTS)
+	list = HS_NLISTS - 1;
+    if (list >= num_lists)
+	num_lists = list + 1;
+    cur.hist[list][k]++;
+}
+
+/*
+ * reset - Forget the samples of the previous trace
+ */
+static void reset(void)
+{
+    num_samples = 0;
+    num_lists = 0;
+    sum_internal = sum_meta = sum_external = sum_largest = 0;
+    min_largest = max_largest = 0;
+    memset(&worst, 0, sizeof(worst));
+}
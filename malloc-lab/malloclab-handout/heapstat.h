@@ -0,0 +1,24 @@
+/*
+ * heapstat.h - prototypes for the routines in heapstat.c that analyze
+ *     the fragmentation of the heap with mm_walk
+ */
+
+/* Free lists tracked separately; higher list indexes share the last */
+#define HS_NLISTS   8
+
+/* Free block size buckets: <64, <256, <1K, ... <256K, >=256K */
+#define HS_NBUCKETS 8
+
+/* hs_open - Start the analysis, writing one CSV row per sample to
+   csvfile unless it is NULL */
+void hs_open(char *csvfile);
+
+/* hs_sample - Walk the heap after op opnum of trace tracenum, when the
+   live blocks inside the heap hold payload bytes */
+void hs_sample(int tracenum, int opnum, size_t payload);
+
+/* hs_summary - Print what the samples of trace tracenum showed */
+void hs_summary(int tracenum);
+
+/* hs_close - Finish the analysis */
+void hs_close(void);
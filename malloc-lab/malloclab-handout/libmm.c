@@ -0,0 +1,185 @@
+/*
+ * libmm.c - The malloc interface of the C library on top of mm.c, built
+ *     with memsys.c into libmm.so so that real programs can run on it.
+ *
+ * Usage:
+ *     unix> LD_PRELOAD=./libmm.so <program> ...
+ *
+ * mm.c is not thread-safe, so one mutex serializes every call. The
+ * heap is created on the first call. Fork handlers hold the mutex
+ * across fork() so that the child never inherits it locked by a thread
+ * that does not exist in the child.
+ */
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+static pthread_mutex_t mm_lock = PTHREAD_MUTEX_INITIALIZER;
+static int mm_ready = 0;      /* set once mm_init has succeeded */
+
+static void libmm_init(void);
+static int lock_mm(void);
+static void unlock_mm(void);
+static void lock_for_fork(void);
+static void *aligned_alloc_locked(size_t align, size_t size);
+
+/*
+ * libmm_init - Install the fork handlers. Not done in lock_mm, since
+ *     pthread_atfork may itself call malloc.
+ */
+__attribute__((constructor))
+static void libmm_init(void)
+{
+    pthread_atfork(lock_for_fork, unlock_mm, unlock_mm);
+}
+
+void *malloc(size_t size)
+{
+    void *p;
+
+    if (!lock_mm())
+	return NULL;
+    p = mm_malloc(size ? size : 1); /* malloc(0) must return a block */
+    unlock_mm();
+    if (p == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+void free(void *ptr)
+{
+    if (ptr == NULL || !lock_mm())
+	return;
+    mm_free(ptr);
+    unlock_mm();
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (nmemb == 0 || size == 0)
+	nmemb = size = 1;
+    if (!lock_mm())
+	return NULL;
+    p = mm_calloc(nmemb, size);
+    unlock_mm();
+    if (p == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    void *p;
+
+    if (ptr == NULL)
+	return malloc(size);
+    if (!lock_mm())
+	return NULL;
+    p = mm_realloc(ptr, size);
+    unlock_mm();
+    if (p == NULL && size != 0)
+	errno = ENOMEM;
+    return p;
+}
+
+int posix_memalign(void **memptr, size_t align, size_t size)
+{
+    void *p;
+
+    if (align == 0 || align % sizeof(void *) != 0 ||
+	(align & (align - 1)) != 0)
+	return EINVAL;
+    if ((p = aligned_alloc_locked(align, size)) == NULL)
+	return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+    void *p;
+
+    if (align == 0 || (align & (align - 1)) != 0) {
+	errno = EINVAL;
+	return NULL;
+    }
+    if ((p = aligned_alloc_locked(align, size)) == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+void *memalign(size_t align, size_t size)
+{
+    return aligned_alloc(align, size);
+}
+
+void *valloc(size_t size)
+{
+    return aligned_alloc(getpagesize(), size);
+}
+
+void *pvalloc(size_t size)
+{
+    size_t page = getpagesize();
+
+    return aligned_alloc(page, (size + page - 1) / page * page);
+}
+
+size_t malloc_usable_size(void *ptr)
+{
+    size_t size;
+
+    if (ptr == NULL || !lock_mm())
+	return 0;
+    size = mm_usable_size(ptr);
+    unlock_mm();
+    return size;
+}
+
+/*
+ * aligned_alloc_locked - mm_memalign under the lock
+ */
+static void *aligned_alloc_locked(size_t align, size_t size)
+{
+    void *p;
+
+    if (!lock_mm())
+	return NULL;
+    p = mm_memalign(align, size ? size : 1);
+    unlock_mm();
+    return p;
+}
+
+/*
+ * lock_mm - Take the lock, creating the heap on the first call; returns
+ *     0 if the heap could not be created
+ */
+static int lock_mm(void)
+{
+    pthread_mutex_lock(&mm_lock);
+    if (!mm_ready) {
+	mem_init();
+	if (mm_init() < 0) {
+	    pthread_mutex_unlock(&mm_lock);
+	    return 0;
+	}
+	mm_ready = 1;
+    }
+    return 1;
+}
+
+static void unlock_mm(void)
+{
+    pthread_mutex_unlock(&mm_lock);
+}
+
+static void lock_for_fork(void)
+{
+    pthread_mutex_lock(&mm_lock);
+}
@@ -0,0 +1,275 @@
+/*
+ * lprof.c - Per-operation latency profiles for the malloc driver
+ *
+ * The driver brackets every call with lp_start() and lp_stop(), which
+ * read the cycle counter. The cycles of each call are kept per
+ * operation type and size class, and lp_print() reports the median,
+ * the 99th percentile and the maximum in ns, converted with the clock
+ * rate that mhz() in clock.c measures.
+ *
+ * On Linux, lp_init() can also open an instruction and a cache miss
+ * counter with perf_event_open(2). While they are switched on with
+ * lp_set_counters(), lp_start() and lp_stop() read them instead of
+ * the cycle counter, and lp_print() adds their average per call.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "clock.h"
+#include "lprof.h"
+
+#define OVHD_RUNS 1000  /* empty start/stop pairs used to find the overhead */
+
+/* The profile of one operation type and size class */
+typedef struct {
+    unsigned long long *cycles; /* cycles of every call */
+    int len, cap;               /* used and allocated length of cycles */
+    double instrs, misses;      /* counter totals ... */
+    int counted;                /* ... over this many calls */
+} cell_t;
+
+static cell_t cells[LP_NOPS][LP_NCLASSES];
+
+static char *op_names[LP_NOPS] = {"malloc", "free", "realloc", "memalign",
+				  "calloc"};
+static char *class_names[LP_NCLASSES] = {
+    "<=64", "<=512", "<=4K", "<=32K", "<=256K", ">256K"
+};
+
+static double cpu_mhz;                /* clock rate from mhz() */
+static unsigned long long overhead;   /* cycles of an empty start/stop */
+static unsigned long long start_cyc;  /* cycle counter at lp_start() */
+
+static int counters_on = 0;           /* read perf counters, not cycles */
+static int perf_fd = -1;              /* leader of the counter group */
+static unsigned long long start_vals[2]; /* counters at lp_start() */
+
+static int size_class(int size);
+static int read_counters(unsigned long long vals[2]);
+static int cmp_cycles(const void *a, const void *b);
+
+/*
+ * lp_init - Measure the clock rate and the overhead of a start/stop
+ *     pair, and optionally open the hardware counters
+ */
+int lp_init(int use_counters)
+{
+    unsigned long long t;
+    int i;
+#ifdef __linux__
+    struct perf_event_attr attr;
+    int fd;
+#endif
+
+    cpu_mhz = mhz(0);
+
+    overhead = ~0ULL;
+    for (i = 0; i < OVHD_RUNS; i++) {
+	t = read_counter();
+	t = read_counter() - t;
+	if (t < overhead)
+	    overhead = t;
+    }
+
+    if (!use_counters)
+	return 1;
+#ifdef __linux__
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.disabled = 1;
+    perf_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (perf_fd >= 0) {
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 0;
+	fd = syscall(__NR_perf_event_open, &attr, 0, -1, perf_fd, 0);
+	if (fd < 0) {
+	    close(perf_fd);
+	    perf_fd = -1;
+	}
+	else
+	    ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+    return perf_fd >= 0;
+}
+
+/*
+ * lp_set_counters - Switch between timing and counting
+ */
+void lp_set_counters(int on)
+{
+    counters_on = on && perf_fd >= 0;
+}
+
+/*
+ * lp_start - Remember the counters before an operation
+ */
+void lp_start(void)
+{
+    if (counters_on)
+	read_counters(start_vals);
+    else
+	start_cyc = read_counter();
+}
+
+/*
+ * lp_stop - Charge the cycles or counts since lp_start() to op
+ */
+void lp_stop(int op, int size)
+{
+    unsigned long long t, vals[2];
+    cell_t *c = &cells[op][size_class(size)];
+
+    if (counters_on) {
+	if (read_counters(vals)) {
+	    c->instrs += vals[0] - start_vals[0];
+	    c->misses += vals[1] - start_vals[1];
+	    c->counted++;
+	}
+	return;
+    }
+
+    t = read_counter() - start_cyc;
+    t = (t > overhead) ? t - overhead : 0;
+    if (c->len == c->cap) {
+	c->cap = (c->cap == 0) ? 1024 : 2 * c->cap;
+	c->cycles = realloc(c->cycles, c->cap * sizeof(unsigned long long));
+	if (c->cycles == NULL) {
+	    fprintf(stderr, "lp_stop: out of memory\n");
+	    exit(1);
+	}
+    }
+    c->cycles[c->len++] = t;
+}
+
+/*
+ * lp_print - Print p50/p99/max latency per operation and size class
+ */
+void lp_print(void)
+{
+    int op, k, n;
+    cell_t *c;
+    double ns = 1e3 / cpu_mhz;  /* ns per cycle */
+
+    printf("Latency per call (ns, %.0f MHz clock, %llu cycles overhead "
+	   "removed):\n", cpu_mhz, overhead);
+    printf("%-8s%8s%9s%9s%9s%11s", "op", "size", "calls", "p50", "p99", "max");
+    if (perf_fd >= 0)
+	printf("%9s%9s", "instrs", "misses");
+    printf("\n");
+
+    for (op = 0; op < LP_NOPS; op++) {
+	for (k = 0; k < LP_NCLASSES; k++) {
+	    c = &cells[op][k];
+	    if ((n = c->len) == 0)
+		continue;
+	    qsort(c->cycles, n, sizeof(unsigned long long), cmp_cycles);
+	    printf("%-8s%8s%9d%9.0f%9.0f%11.0f", op_names[op], class_names[k], n,
+		   c->cycles[(n - 1) / 2] * ns,
+		   c->cycles[(n - 1) * 99 / 100] * ns,
+		   c->cycles[n - 1] * ns);
+	    if (perf_fd >= 0 && c->counted > 0)
+		printf("%9.0f%9.2f", c->instrs / c->counted,
+		       c->misses / c->counted);
+	    printf("\n");
+	}
+    }
+}
+
+/*
+ * lp_quantile - Pool the cycles of all operations and pick the
+ *     q-quantile
+ */
+double lp_quantile(double q)
+{
+    unsigned long long *all, result;
+    int op, k, n = 0;
+    cell_t *c;
+
+    for (op = 0; op < LP_NOPS; op++)
+	for (k = 0; k < LP_NCLASSES; k++)
+	    n += cells[op][k].len;
+    if (n == 0)
+	return 0;
+    if ((all = malloc(n * sizeof(unsigned long long))) == NULL) {
+	fprintf(stderr, "lp_quantile: out of memory\n");
+	exit(1);
+    }
+    for (n = 0, op = 0; op < LP_NOPS; op++) {
+	for (k = 0; k < LP_NCLASSES; k++) {
+	    c = &cells[op][k];
+	    memcpy(all + n, c->cycles, c->len * sizeof(unsigned long long));
+	    n += c->len;
+	}
+    }
+    qsort(all, n, sizeof(unsigned long long), cmp_cycles);
+    result = all[(int)((n - 1) * q)];
+    free(all);
+    return result * 1e3 / cpu_mhz;
+}
+
+/*
+ * lp_reset - Empty every cell, keeping its storage
+ */
+void lp_reset(void)
+{
+    int op, k;
+
+    for (op = 0; op < LP_NOPS; op++) {
+	for (k = 0; k < LP_NCLASSES; k++) {
+	    cells[op][k].len = 0;
+	    cells[op][k].instrs = cells[op][k].misses = 0;
+	    cells[op][k].counted = 0;
+	}
+    }
+}
+
+/*
+ * size_class - Map a request size to its size class
+ */
+static int size_class(int size)
+{
+    int k, limit;
+
+    for (k = 0, limit = 64; k < LP_NCLASSES - 1; k++, limit *= 8)
+	if (size <= limit)
+	    return k;
+    return LP_NCLASSES - 1;
+}
+
+/*
+ * read_counters - Read the instruction and cache miss counters
+ */
+static int read_counters(unsigned long long vals[2])
+{
+    struct {
+	unsigned long long nr;
+	unsigned long long values[2];
+    } buf;
+
+    if (read(perf_fd, &buf, sizeof(buf)) != sizeof(buf) || buf.nr != 2)
+	return 0;
+    vals[0] = buf.values[0];
+    vals[1] = buf.values[1];
+    return 1;
+}
+
+static int cmp_cycles(const void *a, const void *b)
+{
+    unsigned long long x = *(unsigned long long *)a;
+    unsigned long long y = *(unsigned long long *)b;
+
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,45 @@
+/*
+ * lprof.h - prototypes for the routines in lprof.c that profile the
+ *     latency of single malloc, free, realloc, memalign and calloc calls
+ */
+
+/* Operation types */
+#define LP_MALLOC   0
+#define LP_FREE     1
+#define LP_REALLOC  2
+#define LP_MEMALIGN 3
+#define LP_CALLOC   4
+#define LP_NOPS     5
+
+/* Size classes: <=64, <=512, <=4K, <=32K, <=256K and larger */
+#define LP_NCLASSES 6
+
+/*
+ * lp_init - Measure the clock rate and the timing overhead. If
+ *     use_counters is set, also open the instruction and cache miss
+ *     counters; returns 0 if they are unavailable, 1 otherwise.
+ */
+int lp_init(int use_counters);
+
+/*
+ * lp_set_counters - When set, lp_start/lp_stop read the hardware
+ *     counters instead of the cycle counter, since the two system
+ *     calls per operation would distort the latencies.
+ */
+void lp_set_counters(int on);
+
+/* lp_start - Called right before an operation */
+void lp_start(void);
+
+/* lp_stop - Called right after an operation of type op on size bytes */
+void lp_stop(int op, int size);
+
+/* lp_print - Print the profile of all operations seen so far */
+void lp_print(void);
+
+/* lp_quantile - Return the q-quantile (0 <= q <= 1) in ns of the
+   latency of all operations seen so far, regardless of type and size */
+double lp_quantile(double q);
+
+/* lp_reset - Forget all operations seen so far */
+void lp_reset(void);
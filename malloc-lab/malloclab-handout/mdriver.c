@@ -7,6 +7,7 @@
  * Copyright (c) 2002, R. Bryant and D. O'Hallaron, All rights reserved.
  * May not be used, modified, or copied without permission.
  */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -15,12 +16,23 @@
 #include <assert.h>
 #include <float.h>
 #include <time.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #include "mm.h"
 #include "memlib.h"
 #include "fsecs.h"
+#include "lprof.h"
+#include "heapstat.h"
+#include "trace.h"
 #include "config.h"
 
+/* Only mm.c defines mm_memalign and mm_calloc. As weak references they
+   are NULL when mdriver is built with one of the other mm-*.c variants */
+#pragma weak mm_memalign
+#pragma weak mm_calloc
+
 /**********************
  * Constants and macros
  **********************/
@@ -30,6 +42,10 @@
 #define HDRLINES       4 /* number of header lines in a trace file */
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
 
+/* Returns true if p lies in the mem_map area rather than the heap */
+#define IN_MAP(p) ((char *)(p) >= (char *)mem_map_lo() && \
+		   (char *)(p) <= (char *)mem_map_hi())
+
 /* Returns true if p is ALIGNMENT-byte aligned */
 #define IS_ALIGNED(p)  ((((unsigned int)(p)) % ALIGNMENT) == 0)
 
@@ -44,24 +60,6 @@ typedef struct range_t {
     struct range_t *next;  /* next list element */
 } range_t;
 
-/* Characterizes a single trace operation (allocator request) */
-typedef struct {
-    enum {ALLOC, FREE, REALLOC} type; /* type of request */
-    int index;                        /* index for free() to use later */
-    int size;                         /* byte size of alloc/realloc request */
-} traceop_t;
-
-/* Holds the information for one trace file*/
-typedef struct {
-    int sugg_heapsize;   /* suggested heap size (unused) */
-    int num_ids;         /* number of alloc/realloc ids */
-    int num_ops;         /* number of distinct requests */
-    int weight;          /* weight for this trace (unused) */
-    traceop_t *ops;      /* array of requests */
-    char **blocks;       /* array of ptrs returned by malloc/realloc... */
-    size_t *block_sizes; /* ... and a corresponding array of payload sizes */
-} trace_t;
-
 /* 
  * Holds the params to the xxx_speed functions, which are timed by fcyc. 
  * This struct is necessary because fcyc accepts only a pointer array
@@ -78,20 +76,36 @@ typedef struct {
     double ops;      /* number of ops (malloc/free/realloc) in the trace */
     int valid;       /* was the trace processed correctly by the allocator? */
     double secs;     /* number of secs needed to run the trace */
+    int unsupported; /* does the trace need a call the package lacks? */
 
     /* defined only for the student malloc package */
     double util;     /* space utilization for this trace (always 0 for libc) */
+    double peak;     /* peak heap plus mapped bytes (always 0 for libc) */
+    double final;    /* heap plus mapped bytes at the end (always 0 for libc) */
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t; 
 
+/* What a worker process sends back to main over its pipe */
+typedef struct {
+    stats_t stats;   /* stats for the worker's trace */
+    int errors;      /* number of errors the worker found */
+} result_t;
+
 /********************
  * Global variables
  *******************/
 int verbose = 0;        /* global flag for verbose output */
 static int errors = 0;  /* number of errs found when running student malloc */
+static int profile = 0; /* If set, profile every mm call (set by -L/-P) */
+static int counters = 0;/* If set, read hardware counters too (set by -P) */
+static int frag_every = 0; /* If set, walk the heap every so many ops (-F) */
 char msg[MAXLINE];      /* for whenever we need to compose an error message */
 
+/* The mm function behind each request type, for error messages */
+static char *op_names[] = {"mm_malloc", "mm_free", "mm_realloc", 
+			   "mm_memalign", "mm_calloc"};
+
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
 
@@ -111,10 +125,6 @@ static int add_range(range_t **ranges, char *lo, int size,
 static void remove_range(range_t **ranges, char *lo);
 static void clear_ranges(range_t **ranges);
 
-/* These functions read, allocate, and free storage for traces */
-static trace_t *read_trace(char *tracedir, char *filename);
-static void free_trace(trace_t *trace);
-
 /* Routines for evaluating the correctness and speed of libc malloc */
 static int eval_libc_valid(trace_t *trace, int tracenum);
 static void eval_libc_speed(void *ptr);
@@ -124,6 +134,22 @@ static void eval_libc_speed(void *ptr);
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
 static void eval_mm_speed(void *ptr);
+static void eval_mm_latency(trace_t *trace);
+
+/* These functions evaluate one trace, and the whole set in parallel */
+static stats_t eval_libc_trace(char *tracefile, int tracenum);
+static stats_t eval_mm_trace(char *tracefile, int tracenum);
+static void eval_traces(stats_t (*eval)(char *, int), char **tracefiles,
+			int n, stats_t *stats, int jobs);
+static void run_worker(stats_t (*eval)(char *, int), char *tracefile,
+		       int tracenum, int slot, int fd);
+static int num_cores(void);
+static void pin_to_core(int slot);
+
+/* These functions carry out an ALLOC, MEMALIGN or CALLOC request */
+static int mm_supports(trace_t *trace);
+static char *mm_alloc_op(traceop_t *op);
+static char *libc_alloc_op(traceop_t *op);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
@@ -141,33 +167,32 @@ int main(int argc, char **argv)
     char c;
     char **tracefiles = NULL;  /* null-terminated array of trace file names */
     int num_tracefiles = 0;    /* the number of traces in that array */
-    trace_t *trace = NULL;     /* stores a single trace file in memory */
-    range_t *ranges = NULL;    /* keeps track of block extents for one trace */
     stats_t *libc_stats = NULL;/* libc stats for each trace */
     stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
-    speed_t speed_params;      /* input parameters to the xx_speed routines */ 
 
     int team_check = 1;  /* If set, check team structure (reset by -a) */
     int run_libc = 0;    /* If set, run libc malloc (set by -l) */
     int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+    int jobs = 1;        /* Traces evaluated in parallel (set by -j) */
+    char *frag_csv = NULL; /* CSV file for the heap samples (set by -C) */
 
     /* temporaries used to compute the performance index */
     double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
-    int numcorrect;
+    int numcorrect, numrun;
     
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt(argc, argv, "f:t:j:F:C:hvVgalLP")) != EOF) {
         switch (c) {
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
 	    break;
-        case 'f': /* Use one specific trace file only (relative to curr dir) */
+        case 'f': /* Use one specific trace file only (path as given) */
             num_tracefiles = 1;
             if ((tracefiles = realloc(tracefiles, 2*sizeof(char *))) == NULL)
 		unix_error("ERROR: realloc failed in main");
-	    strcpy(tracedir, "./"); 
+	    strcpy(tracedir, ""); 
             tracefiles[0] = strdup(optarg);
             tracefiles[1] = NULL;
             break;
@@ -178,12 +203,28 @@ int main(int argc, char **argv)
 	    if (tracedir[strlen(tracedir)-1] != '/') 
 		strcat(tracedir, "/"); /* path always ends with "/" */
 	    break;
+        case 'j': /* Evaluate up to this many traces in parallel */
+            jobs = atoi(optarg);
+            break;
+        case 'F': /* Analyze the heap layout every so many ops */
+            frag_every = atoi(optarg);
+            break;
+        case 'C': /* Write the heap layout samples to a CSV file */
+            frag_csv = optarg;
+            break;
         case 'a': /* Don't check team structure */
             team_check = 0;
             break;
         case 'l': /* Run libc malloc */
             run_libc = 1;
             break;
+        case 'L': /* Profile the latency of every mm call */
+            profile = 1;
+            break;
+        case 'P': /* Profile with hardware counters as well */
+            profile = 1;
+            counters = 1;
+            break;
         case 'v': /* Print per-trace performance breakdown */
             verbose = 1;
             break;
@@ -238,6 +279,18 @@ int main(int argc, char **argv)
     /* Initialize the timing package */
     init_fsecs();
 
+    /* 
+     * Give every parallel worker a core of its own. The latency profile
+     * and the heap layout analysis are gathered in this process, so both
+     * run the traces serially.
+     */
+    if (frag_csv != NULL && frag_every <= 0)
+	frag_every = 100;
+    if (jobs <= 0 || jobs > num_cores())
+	jobs = num_cores();
+    if (profile || frag_every > 0)
+	jobs = 1;
+
     /*
      * Optionally run and evaluate the libc malloc package 
      */
@@ -251,20 +304,8 @@ int main(int argc, char **argv)
 	    unix_error("libc_stats calloc in main failed");
 	
 	/* Evaluate the libc malloc package using the K-best scheme */
-	for (i=0; i < num_tracefiles; i++) {
-	    trace = read_trace(tracedir, tracefiles[i]);
-	    libc_stats[i].ops = trace->num_ops;
-	    if (verbose > 1)
-		printf("Checking libc malloc for correctness, ");
-	    libc_stats[i].valid = eval_libc_valid(trace, i);
-	    if (libc_stats[i].valid) {
-		speed_params.trace = trace;
-		if (verbose > 1)
-		    printf("and performance.\n");
-		libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
-	    }
-	    free_trace(trace);
-	}
+	eval_traces(eval_libc_trace, tracefiles, num_tracefiles, libc_stats,
+		    jobs);
 
 	/* Display the libc results in a compact table */
 	if (verbose) {
@@ -284,29 +325,26 @@ int main(int argc, char **argv)
     if (mm_stats == NULL)
 	unix_error("mm_stats calloc in main failed");
     
-    /* Initialize the simulated memory system in memlib.c */
-    mem_init(); 
+    /* Initialize the simulated memory system in memlib.c (each parallel
+       worker initializes its own) */
+    if (jobs == 1)
+	mem_init(); 
 
-    /* Evaluate student's mm malloc package using the K-best scheme */
-    for (i=0; i < num_tracefiles; i++) {
-	trace = read_trace(tracedir, tracefiles[i]);
-	mm_stats[i].ops = trace->num_ops;
+    /* Calibrate the per-call profiler */
+    if (profile) {
 	if (verbose > 1)
-	    printf("Checking mm_malloc for correctness, ");
-	mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
-	if (mm_stats[i].valid) {
-	    if (verbose > 1)
-		printf("efficiency, ");
-	    mm_stats[i].util = eval_mm_util(trace, i, &ranges);
-	    speed_params.trace = trace;
-	    speed_params.ranges = ranges;
-	    if (verbose > 1)
-		printf("and performance.\n");
-	    mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
-	}
-	free_trace(trace);
+	    printf("Calibrating the latency profiler\n");
+	if (!lp_init(counters) && counters)
+	    printf("Hardware counters unavailable, profiling latency only\n");
     }
 
+    /* Evaluate student's mm malloc package using the K-best scheme */
+    if (frag_every > 0)
+	hs_open(frag_csv);
+    eval_traces(eval_mm_trace, tracefiles, num_tracefiles, mm_stats, jobs);
+    if (frag_every > 0)
+	hs_close();
+
     /* Display the mm results in a compact table */
     if (verbose) {
 	printf("\nResults for mm malloc:\n");
@@ -314,6 +352,12 @@ int main(int argc, char **argv)
 	printf("\n");
     }
 
+    /* Display the latency profile of the mm calls */
+    if (profile && errors == 0) {
+	lp_print();
+	printf("\n");
+    }
+
     /* 
      * Accumulate the aggregate statistics for the student's mm package 
      */
@@ -321,19 +365,27 @@ int main(int argc, char **argv)
     ops = 0;
     util = 0;
     numcorrect = 0;
+    numrun = 0;
     for (i=0; i < num_tracefiles; i++) {
+	if (mm_stats[i].unsupported)
+	    continue;
+	numrun++;
 	secs += mm_stats[i].secs;
 	ops += mm_stats[i].ops;
 	util += mm_stats[i].util;
 	if (mm_stats[i].valid)
 	    numcorrect++;
     }
-    avg_mm_util = util/num_tracefiles;
+    avg_mm_util = numrun > 0 ? util/numrun : 0;
 
     /* 
      * Compute and print the performance index 
      */
-    if (errors == 0) {
+    if (numrun == 0) {
+	perfindex = 0.0;
+	printf("No trace could be run\n");
+    }
+    else if (errors == 0) {
 	avg_mm_throughput = ops/secs;
 
 	p1 = UTIL_WEIGHT * avg_mm_util;
@@ -395,9 +447,10 @@ static int add_range(range_t **ranges, char *lo, int size,
         return 0;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
-	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    /* The payload must lie within the extent of the heap or the mem_map area */
+    if (((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
+	 (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) &&
+	((lo < (char *)mem_map_lo()) || (hi > (char *)mem_map_hi()))) {
 	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
 		lo, hi, mem_heap_lo(), mem_heap_hi());
 	malloc_error(tracenum, opnum, msg);
@@ -464,108 +517,6 @@ static void clear_ranges(range_t **ranges)
 }
 
 
-/**********************************************
- * The following routines manipulate tracefiles
- *********************************************/
-
-/*
- * read_trace - read a trace file and store it in memory
- */
-static trace_t *read_trace(char *tracedir, char *filename)
-{
-    FILE *tracefile;
-    trace_t *trace;
-    char type[MAXLINE];
-    char path[MAXLINE];
-    unsigned index, size;
-    unsigned max_index = 0;
-    unsigned op_index;
-
-    if (verbose > 1)
-	printf("Reading tracefile: %s\n", filename);
-
-    /* Allocate the trace record */
-    if ((trace = (trace_t *) malloc(sizeof(trace_t))) == NULL)
-	unix_error("malloc 1 failed in read_trance");
-	
-    /* Read the trace file header */
-    strcpy(path, tracedir);
-    strcat(path, filename);
-    if ((tracefile = fopen(path, "r")) == NULL) {
-	sprintf(msg, "Could not open %s in read_trace", path);
-	unix_error(msg);
-    }
-    fscanf(tracefile, "%d", &(trace->sugg_heapsize)); /* not used */
-    fscanf(tracefile, "%d", &(trace->num_ids));     
-    fscanf(tracefile, "%d", &(trace->num_ops));     
-    fscanf(tracefile, "%d", &(trace->weight));        /* not used */
-    
-    /* We'll store each request line in the trace in this array */
-    if ((trace->ops = 
-	 (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
-	unix_error("malloc 2 failed in read_trace");
-
-    /* We'll keep an array of pointers to the allocated blocks here... */
-    if ((trace->blocks = 
-	 (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
-	unix_error("malloc 3 failed in read_trace");
-
-    /* ... along with the corresponding byte sizes of each block */
-    if ((trace->block_sizes = 
-	 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
-	unix_error("malloc 4 failed in read_trace");
-    
-    /* read every request line in the trace file */
-    index = 0;
-    op_index = 0;
-    while (fscanf(tracefile, "%s", type) != EOF) {
-	switch(type[0]) {
-	case 'a':
-	    fscanf(tracefile, "%u %u", &index, &size);
-	    trace->ops[op_index].type = ALLOC;
-	    trace->ops[op_index].index = index;
-	    trace->ops[op_index].size = size;
-	    max_index = (index > max_index) ? index : max_index;
-	    break;
-	case 'r':
-	    fscanf(tracefile, "%u %u", &index, &size);
-	    trace->ops[op_index].type = REALLOC;
-	    trace->ops[op_index].index = index;
-	    trace->ops[op_index].size = size;
-	    max_index = (index > max_index) ? index : max_index;
-	    break;
-	case 'f':
-	    fscanf(tracefile, "%ud", &index);
-	    trace->ops[op_index].type = FREE;
-	    trace->ops[op_index].index = index;
-	    break;
-	default:
-	    printf("Bogus type character (%c) in tracefile %s\n", 
-		   type[0], path);
-	    exit(1);
-	}
-	op_index++;
-	
-    }
-    fclose(tracefile);
-    assert(max_index == trace->num_ids - 1);
-    assert(trace->num_ops == op_index);
-    
-    return trace;
-}
-
-/*
- * free_trace - Free the trace record and the three arrays it points
- *              to, all of which were allocated in read_trace().
- */
-void free_trace(trace_t *trace)
-{
-    free(trace->ops);         /* free the three arrays... */
-    free(trace->blocks);      
-    free(trace->block_sizes);
-    free(trace);              /* and the trace record itself... */
-}
-
 /**********************************************************************
  * The following functions evaluate the correctness, space utilization,
  * and throughput of the libc and mm malloc packages.
@@ -601,13 +552,31 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 
         switch (trace->ops[i].type) {
 
-        case ALLOC: /* mm_malloc */
+        case ALLOC:    /* mm_malloc */
+        case MEMALIGN: /* mm_memalign */
+        case CALLOC:   /* mm_calloc */
 
 	    /* Call the student's malloc */
-	    if ((p = mm_malloc(size)) == NULL) {
-		malloc_error(tracenum, i, "mm_malloc failed.");
+	    if ((p = mm_alloc_op(&trace->ops[i])) == NULL) {
+		sprintf(msg, "%s failed.", op_names[trace->ops[i].type]);
+		malloc_error(tracenum, i, msg);
+		return 0;
+	    }
+
+	    /* mm_memalign must honor the alignment, mm_calloc must zero */
+	    if (trace->ops[i].type == MEMALIGN && 
+		(size_t)p % trace->ops[i].align != 0) {
+		malloc_error(tracenum, i, "mm_memalign returned a misaligned block");
 		return 0;
 	    }
+	    if (trace->ops[i].type == CALLOC) {
+		for (j = 0; j < size; j++) {
+		    if (p[j] != 0) {
+			malloc_error(tracenum, i, "mm_calloc did not zero the block");
+			return 0;
+		    }
+		}
+	    }
 	    
 	    /* 
 	     * Test the range of the new block for correctness and add it 
@@ -653,7 +622,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    oldsize = trace->block_sizes[index];
 	    if (size < oldsize) oldsize = size;
 	    for (j = 0; j < oldsize; j++) {
-	      if (newp[j] != (index & 0xFF)) {
+	      if ((unsigned char)newp[j] != (index & 0xFF)) {
 		malloc_error(tracenum, i, "mm_realloc did not preserve the "
 			     "data from old block");
 		return 0;
@@ -688,12 +657,11 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  * eval_mm_util - Evaluate the space utilization of the student's package
  *   The idea is to remember the high water mark "hwm" of the heap for 
  *   an optimal allocator, i.e., no gaps and no internal fragmentation.
- *   Utilization is the ratio hwm/heapsize, where heapsize is the 
- *   size of the heap in bytes after running the student's malloc 
- *   package on the trace. Note that our implementation of mem_sbrk() 
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap. 
- *   
+ *   Utilization is the ratio hwm/peaksize, where peaksize is the 
+ *   largest footprint (heap plus mem_map regions) in bytes reached 
+ *   while running the student's malloc package on the trace. Since 
+ *   mem_sbrk() can decrement the brk pointer and mem_unmap() can 
+ *   release regions, the final footprint may be smaller than the peak.
  */
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 {   
@@ -702,6 +670,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
     int size, newsize, oldsize;
     int max_total_size = 0;
     int total_size = 0;
+    size_t heap_size = 0; /* total size of the blocks inside the heap */
     char *p;
     char *newp, *oldp;
 
@@ -713,11 +682,13 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
     for (i = 0;  i < trace->num_ops;  i++) {
         switch (trace->ops[i].type) {
 
-        case ALLOC: /* mm_alloc */
+        case ALLOC:    /* mm_alloc */
+        case MEMALIGN: /* mm_memalign */
+        case CALLOC:   /* mm_calloc */
 	    index = trace->ops[i].index;
 	    size = trace->ops[i].size;
 
-	    if ((p = mm_malloc(size)) == NULL) 
+	    if ((p = mm_alloc_op(&trace->ops[i])) == NULL) 
 		app_error("mm_malloc failed in eval_mm_util");
 	    
 	    /* Remember region and size */
@@ -727,6 +698,8 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    /* Keep track of current total size
 	     * of all allocated blocks */
 	    total_size += size;
+	    if (!IN_MAP(p))
+		heap_size += size;
 	    
 	    /* Update statistics */
 	    max_total_size = (total_size > max_total_size) ?
@@ -749,6 +722,10 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    /* Keep track of current total size
 	     * of all allocated blocks */
 	    total_size += (newsize - oldsize);
+	    if (!IN_MAP(oldp))
+		heap_size -= oldsize;
+	    if (!IN_MAP(newp))
+		heap_size += newsize;
 	    
 	    /* Update statistics */
 	    max_total_size = (total_size > max_total_size) ?
@@ -760,6 +737,8 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    size = trace->block_sizes[index];
 	    p = trace->blocks[index];
 	    
+	    if (!IN_MAP(p))
+		heap_size -= size;
 	    mm_free(p);
 	    
 	    /* Keep track of current total size
@@ -772,9 +751,14 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    app_error("Nonexistent request type in eval_mm_util");
 
         }
+
+	/* Sample the heap layout for the fragmentation analysis */
+	if (frag_every > 0 && 
+	    (i % frag_every == 0 || i == trace->num_ops - 1))
+	    hs_sample(tracenum, i, heap_size);
     }
 
-    return ((double)max_total_size / (double)mem_heapsize());
+    return ((double)max_total_size / (double)mem_peaksize());
 }
 
 
@@ -805,6 +789,14 @@ static void eval_mm_speed(void *ptr)
             trace->blocks[index] = p;
             break;
 
+        case MEMALIGN: /* mm_memalign */
+        case CALLOC:   /* mm_calloc */
+            index = trace->ops[i].index;
+            if ((p = mm_alloc_op(&trace->ops[i])) == NULL)
+		app_error("mm_memalign/mm_calloc error in eval_mm_speed");
+            trace->blocks[index] = p;
+            break;
+
 	case REALLOC: /* mm_realloc */
 	    index = trace->ops[i].index;
             newsize = trace->ops[i].size;
@@ -825,6 +817,287 @@ static void eval_mm_speed(void *ptr)
         }
 }
 
+/*
+ * eval_mm_latency - Run the trace once more, timing every mm call
+ *    on its own with the latency profiler in lprof.c.
+ */
+static void eval_mm_latency(trace_t *trace)
+{
+    int i, index, size;
+    char *p;
+
+    /* Reset the heap and initialize the mm package */
+    mem_reset_brk();
+    if (mm_init() < 0) 
+	app_error("mm_init failed in eval_mm_latency");
+
+    /* Interpret each trace request */
+    for (i = 0;  i < trace->num_ops;  i++) {
+	index = trace->ops[i].index;
+        switch (trace->ops[i].type) {
+
+        case ALLOC: /* mm_malloc */
+            size = trace->ops[i].size;
+	    lp_start();
+            p = mm_malloc(size);
+	    lp_stop(LP_MALLOC, size);
+            if (p == NULL)
+		app_error("mm_malloc error in eval_mm_latency");
+            trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+            break;
+
+        case MEMALIGN: /* mm_memalign */
+        case CALLOC:   /* mm_calloc */
+            size = trace->ops[i].size;
+	    lp_start();
+            p = mm_alloc_op(&trace->ops[i]);
+	    lp_stop(trace->ops[i].type == CALLOC ? LP_CALLOC : LP_MEMALIGN, size);
+            if (p == NULL)
+		app_error("mm_memalign/mm_calloc error in eval_mm_latency");
+            trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+            break;
+
+	case REALLOC: /* mm_realloc */
+            size = trace->ops[i].size;
+	    lp_start();
+            p = mm_realloc(trace->blocks[index], size);
+	    lp_stop(LP_REALLOC, size);
+            if (p == NULL)
+		app_error("mm_realloc error in eval_mm_latency");
+            trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+            break;
+
+        case FREE: /* mm_free */
+	    lp_start();
+            mm_free(trace->blocks[index]);
+	    lp_stop(LP_FREE, trace->block_sizes[index]);
+            break;
+
+	default:
+	    app_error("Nonexistent request type in eval_mm_latency");
+        }
+    }
+}
+
+/*
+ * eval_mm_trace - Evaluate the correctness, space utilization and
+ *    speed of the student's package on one trace.
+ */
+static stats_t eval_mm_trace(char *tracefile, int tracenum)
+{
+    stats_t stats;
+    trace_t *trace;
+    range_t *ranges = NULL;
+    speed_t speed_params;
+
+    memset(&stats, 0, sizeof(stats));
+    trace = read_trace(tracedir, tracefile);
+    stats.ops = trace->num_ops;
+    if (!mm_supports(trace)) {
+	printf("Trace %d (%s) unsupported: the package has no mm_memalign\n",
+	       tracenum, tracefile);
+	stats.unsupported = 1;
+	free_trace(trace);
+	return stats;
+    }
+    if (verbose > 1)
+	printf("Checking mm_malloc for correctness, ");
+    stats.valid = eval_mm_valid(trace, tracenum, &ranges);
+    if (stats.valid) {
+	if (verbose > 1)
+	    printf("efficiency, ");
+	stats.util = eval_mm_util(trace, tracenum, &ranges);
+	stats.peak = mem_peaksize();
+	stats.final = mem_heapsize() + mem_mapsize();
+	speed_params.trace = trace;
+	speed_params.ranges = ranges;
+	if (verbose > 1)
+	    printf("and performance.\n");
+	stats.secs = fsecs(eval_mm_speed, &speed_params);
+	if (frag_every > 0)
+	    hs_summary(tracenum);
+	if (profile) {
+	    lp_set_counters(0);
+	    eval_mm_latency(trace);
+	    if (counters) {
+		lp_set_counters(1);
+		eval_mm_latency(trace);
+	    }
+	}
+    }
+    clear_ranges(&ranges);
+    free_trace(trace);
+    return stats;
+}
+
+/*
+ * eval_libc_trace - Evaluate the correctness and speed of the libc
+ *    malloc package on one trace.
+ */
+static stats_t eval_libc_trace(char *tracefile, int tracenum)
+{
+    stats_t stats;
+    trace_t *trace;
+    speed_t speed_params;
+
+    memset(&stats, 0, sizeof(stats));
+    trace = read_trace(tracedir, tracefile);
+    stats.ops = trace->num_ops;
+    if (verbose > 1)
+	printf("Checking libc malloc for correctness, ");
+    stats.valid = eval_libc_valid(trace, tracenum);
+    if (stats.valid) {
+	speed_params.trace = trace;
+	if (verbose > 1)
+	    printf("and performance.\n");
+	stats.secs = fsecs(eval_libc_speed, &speed_params);
+    }
+    free_trace(trace);
+    return stats;
+}
+
+/*
+ * eval_traces - Evaluate each of the n traces with eval and store the
+ *    results in stats. With jobs > 1, every trace is evaluated by a
+ *    worker process of its own, at most jobs at a time, each pinned to
+ *    a different core so that the timing runs don't disturb each other.
+ *    A worker sends its stats back over a pipe; a worker that dies
+ *    without doing so leaves its trace marked invalid.
+ */
+static void eval_traces(stats_t (*eval)(char *, int), char **tracefiles,
+			int n, stats_t *stats, int jobs)
+{
+    int i, slot, status, fd[2];
+    int running = 0;   /* number of live workers */
+    pid_t pid, *pids;  /* pid of the worker in each slot, 0 if free */
+    int *slot_trace;   /* trace evaluated in each slot */
+    int *slot_fd;      /* read end of the pipe of each slot */
+    result_t result;
+
+    if (jobs <= 1) {
+	for (i=0; i < n; i++)
+	    stats[i] = eval(tracefiles[i], i);
+	return;
+    }
+
+    if ((pids = (pid_t *)calloc(jobs, sizeof(pid_t))) == NULL ||
+	(slot_trace = (int *)calloc(jobs, sizeof(int))) == NULL ||
+	(slot_fd = (int *)calloc(jobs, sizeof(int))) == NULL)
+	unix_error("calloc in eval_traces failed");
+
+    /* Don't let the workers inherit (and repeat) buffered output */
+    fflush(stdout);
+
+    i = 0;
+    while (i < n || running > 0) {
+	/* Start a worker in a free slot */
+	if (i < n && running < jobs) {
+	    for (slot = 0; pids[slot] != 0; slot++)
+		;
+	    if (pipe(fd) < 0)
+		unix_error("pipe in eval_traces failed");
+	    if ((pid = fork()) < 0)
+		unix_error("fork in eval_traces failed");
+	    if (pid == 0) {
+		close(fd[0]);
+		run_worker(eval, tracefiles[i], i, slot, fd[1]);
+	    }
+	    close(fd[1]);
+	    pids[slot] = pid;
+	    slot_trace[slot] = i;
+	    slot_fd[slot] = fd[0];
+	    running++;
+	    i++;
+	    continue;
+	}
+
+	/* Collect the results of a finished worker */
+	if ((pid = wait(&status)) < 0)
+	    unix_error("wait in eval_traces failed");
+	for (slot = 0; slot < jobs && pids[slot] != pid; slot++)
+	    ;
+	if (slot == jobs)
+	    continue;
+	if (read(slot_fd[slot], &result, sizeof(result)) == sizeof(result)) {
+	    stats[slot_trace[slot]] = result.stats;
+	    errors += result.errors;
+	}
+	else {
+	    errors++;
+	    printf("ERROR [trace %d]: evaluation process died\n", 
+		   slot_trace[slot]);
+	}
+	close(slot_fd[slot]);
+	pids[slot] = 0;
+	running--;
+    }
+
+    free(pids);
+    free(slot_trace);
+    free(slot_fd);
+}
+
+/*
+ * run_worker - Body of a worker process: evaluate one trace on a
+ *    fresh heap, pinned to the core of the given slot, and write the
+ *    result to fd.
+ */
+static void run_worker(stats_t (*eval)(char *, int), char *tracefile,
+		       int tracenum, int slot, int fd)
+{
+    result_t result;
+
+    pin_to_core(slot);
+    mem_init();
+    errors = 0;
+    result.stats = eval(tracefile, tracenum);
+    result.errors = errors;
+    fflush(stdout);
+    if (write(fd, &result, sizeof(result)) != sizeof(result))
+	unix_error("write in run_worker failed");
+    exit(0);
+}
+
+/*
+ * num_cores - Return the number of cores this process may run on
+ */
+static int num_cores(void)
+{
+#ifdef __linux__
+    cpu_set_t allowed;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+	return CPU_COUNT(&allowed);
+#endif
+    return (int)sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+/*
+ * pin_to_core - Restrict the calling process to the slot-th core it
+ *    may run on. A no-op where affinity can't be set.
+ */
+static void pin_to_core(int slot)
+{
+#ifdef __linux__
+    cpu_set_t allowed, one;
+    int cpu;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+	return;
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+	if (CPU_ISSET(cpu, &allowed) && slot-- == 0) {
+	    CPU_ZERO(&one);
+	    CPU_SET(cpu, &one);
+	    sched_setaffinity(0, sizeof(one), &one);
+	    return;
+	}
+    }
+#endif
+}
+
 /*
  * eval_libc_valid - We run this function to make sure that the
  *    libc malloc can run to completion on the set of traces.
@@ -839,8 +1112,10 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
     for (i = 0;  i < trace->num_ops;  i++) {
         switch (trace->ops[i].type) {
 
-        case ALLOC: /* malloc */
-	    if ((p = malloc(trace->ops[i].size)) == NULL) {
+        case ALLOC:    /* malloc */
+        case MEMALIGN: /* posix_memalign */
+        case CALLOC:   /* calloc */
+	    if ((p = libc_alloc_op(&trace->ops[i])) == NULL) {
 		malloc_error(tracenum, i, "libc malloc failed");
 		unix_error("System message");
 	    }
@@ -891,6 +1166,14 @@ static void eval_libc_speed(void *ptr)
 	    trace->blocks[index] = p;
 	    break;
 
+        case MEMALIGN: /* posix_memalign */
+        case CALLOC:   /* calloc */
+	    index = trace->ops[i].index;
+	    if ((p = libc_alloc_op(&trace->ops[i])) == NULL)
+		unix_error("posix_memalign/calloc failed in eval_libc_speed");
+	    trace->blocks[index] = p;
+	    break;
+
 	case REALLOC: /* realloc */
 	    index = trace->ops[i].index;
 	    newsize = trace->ops[i].size;
@@ -910,6 +1193,56 @@ static void eval_libc_speed(void *ptr)
     }
 }
 
+/*
+ * mm_supports - Return true unless the trace has MEMALIGN requests and
+ *    the mm package has no mm_memalign. A missing mm_calloc is replaced
+ *    by mm_malloc and memset, as mmbench does.
+ */
+static int mm_supports(trace_t *trace)
+{
+    return mm_memalign != NULL || !trace->memalign;
+}
+
+/*
+ * mm_alloc_op - Carry out an ALLOC, MEMALIGN or CALLOC request with the
+ *    mm package
+ */
+static char *mm_alloc_op(traceop_t *op)
+{
+    char *p;
+
+    switch (op->type) {
+    case MEMALIGN:
+	return mm_memalign(op->align, op->size);
+    case CALLOC:
+	if (mm_calloc != NULL)
+	    return mm_calloc(1, op->size);
+	if ((p = mm_malloc(op->size)) != NULL)
+	    memset(p, 0, op->size);
+	return p;
+    default:
+	return mm_malloc(op->size);
+    }
+}
+
+/*
+ * libc_alloc_op - Carry out an ALLOC, MEMALIGN or CALLOC request with the
+ *    libc package
+ */
+static char *libc_alloc_op(traceop_t *op)
+{
+    void *p;
+
+    switch (op->type) {
+    case MEMALIGN:
+	return posix_memalign(&p, op->align, op->size) == 0 ? p : NULL;
+    case CALLOC:
+	return calloc(1, op->size);
+    default:
+	return malloc(op->size);
+    }
+}
+
 /*************************************
  * Some miscellaneous helper routines
  ************************************/
@@ -924,22 +1257,34 @@ static void printresults(int n, stats_t *stats)
     double secs = 0;
     double ops = 0;
     double util = 0;
+    double peak = 0;
+    double final = 0;
+    int counted = 0;   /* traces the package could run */
 
     /* Print the individual results for each trace */
-    printf("%5s%7s %5s%8s%10s%6s\n", 
-	   "trace", " valid", "util", "ops", "secs", "Kops");
+    printf("%5s%7s %5s%8s%10s%6s%8s%8s\n", 
+	   "trace", " valid", "util", "ops", "secs", "Kops", "peakKB", "finalKB");
     for (i=0; i < n; i++) {
+	if (stats[i].unsupported) {
+	    printf("%2d%12s\n", i, "unsupported");
+	    continue;
+	}
+	counted++;
 	if (stats[i].valid) {
-	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f\n", 
+	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f%8.0f%8.0f\n", 
 		   i,
 		   "yes",
 		   stats[i].util*100.0,
 		   stats[i].ops,
 		   stats[i].secs,
-		   (stats[i].ops/1e3)/stats[i].secs);
+		   (stats[i].ops/1e3)/stats[i].secs,
+		   stats[i].peak/1024,
+		   stats[i].final/1024);
 	    secs += stats[i].secs;
 	    ops += stats[i].ops;
 	    util += stats[i].util;
+	    peak += stats[i].peak;
+	    final += stats[i].final;
 	}
 	else {
 	    printf("%2d%10s%6s%8s%10s%6s\n", 
@@ -953,13 +1298,15 @@ static void printresults(int n, stats_t *stats)
     }
 
     /* Print the aggregate results for the set of traces */
-    if (errors == 0) {
-	printf("%12s%5.0f%%%8.0f%10.6f%6.0f\n", 
+    if (errors == 0 && counted > 0) {
+	printf("%12s%5.0f%%%8.0f%10.6f%6.0f%8.0f%8.0f\n", 
 	       "Total       ",
-	       (util/n)*100.0,
+	       (util/counted)*100.0,
 	       ops, 
 	       secs,
-	       (ops/1e3)/secs);
+	       (ops/1e3)/secs,
+	       peak/1024,
+	       final/1024);
     }
     else {
 	printf("%12s%6s%8s%10s%6s\n", 
@@ -1004,13 +1351,19 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvValLP] [-f <file>] [-t <dir>] [-j <n>] "
+	    "[-F <n>] [-C <file>]\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-a         Don't check the team structure.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
+    fprintf(stderr, "\t-C <file>  Write the heap layout samples to <file> as CSV.\n");
+    fprintf(stderr, "\t-F <n>     Analyze the heap layout every n ops.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-j <n>     Evaluate up to n traces in parallel (0: one per core).\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-L         Print p50/p99/max latency of every mm call.\n");
+    fprintf(stderr, "\t-P         Like -L, adding instructions and cache misses.\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
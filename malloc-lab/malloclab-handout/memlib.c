@@ -18,6 +18,15 @@
 static char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */ 
+static char *mem_clean_brk;  /* highest brk so far; the heap is zero above */
+static char *mem_map_area;   /* storage backing the mem_map regions */
+static char *mem_map_start;  /* first page of the mem_map region */
+static char *mem_map_used;   /* one flag per mem_map page, set if mapped */
+static size_t mem_map_pages; /* number of pages in the mem_map region */
+static size_t mem_mapped;    /* bytes currently mapped by mem_map */
+static size_t mem_peak;      /* largest heap plus mapped size so far */
+
+static void mem_update_peak(void);
 
 /* 
  * mem_init - initialize the memory system model
@@ -25,13 +34,26 @@ static char *mem_max_addr;   /* largest legal heap address */
 void mem_init(void)
 {
     /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
+    if ((mem_start_brk = (char *)calloc(MAX_HEAP, 1)) == NULL) {
 	fprintf(stderr, "mem_init_vm: malloc error\n");
 	exit(1);
     }
 
     mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
     mem_brk = mem_start_brk;                  /* heap is empty initially */
+    mem_clean_brk = mem_start_brk;
+
+    /* allocate the page-aligned storage we will use to model mmap */
+    mem_map_pages = MAX_MAP / mem_pagesize();
+    if ((mem_map_area = (char *)malloc(MAX_MAP + mem_pagesize())) == NULL ||
+	(mem_map_used = (char *)calloc(mem_map_pages, 1)) == NULL) {
+	fprintf(stderr, "mem_init_vm: malloc error\n");
+	exit(1);
+    }
+    mem_map_start = mem_map_area + mem_pagesize() - 
+	(size_t)mem_map_area % mem_pagesize();
+    mem_mapped = 0;
+    mem_peak = 0;
 }
 
 /* 
@@ -40,34 +62,97 @@ void mem_init(void)
 void mem_deinit(void)
 {
     free(mem_start_brk);
+    free(mem_map_area);
+    free(mem_map_used);
 }
 
 /*
- * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ * mem_reset_brk - reset the simulated brk pointer to make an empty heap,
+ *    drop every mem_map region, and start a new peak measurement
  */
 void mem_reset_brk()
 {
     mem_brk = mem_start_brk;
+    memset(mem_map_used, 0, mem_map_pages);
+    mem_mapped = 0;
+    mem_peak = 0;
 }
 
 /* 
  * mem_sbrk - simple model of the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    by incr bytes and returns the start address of the new area. A
+ *    negative incr shrinks the heap, but never below its first byte.
  */
 void *mem_sbrk(int incr) 
 {
     char *old_brk = mem_brk;
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+    if ( ((mem_brk + incr) < mem_start_brk) || 
+	 ((mem_brk + incr) > mem_max_addr)) {
 	errno = ENOMEM;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
     }
     mem_brk += incr;
+    if (mem_brk > mem_clean_brk)
+	mem_clean_brk = mem_brk;
+    mem_update_peak();
     return (void *)old_brk;
 }
 
+/*
+ * mem_map - simple model of an anonymous mmap. Returns a zeroed,
+ *    page-aligned region of len bytes (rounded up to whole pages) that
+ *    lies outside the heap, or (void *)-1 if the mem_map region is
+ *    exhausted.
+ */
+void *mem_map(size_t len)
+{
+    size_t pages = (len + mem_pagesize() - 1) / mem_pagesize();
+    size_t i, run = 0;
+
+    /* first fit over the page flags */
+    for (i = 0; i < mem_map_pages && run < pages; i++) 
+	run = mem_map_used[i] ? 0 : run + 1;
+
+    if (pages == 0 || run < pages) {
+	errno = ENOMEM;
+	fprintf(stderr, "ERROR: mem_map failed. Ran out of memory...\n");
+	return (void *)-1;
+    }
+    memset(mem_map_used + i - pages, 1, pages);
+    memset(mem_map_start + (i - pages) * mem_pagesize(), 0,
+	   pages * mem_pagesize());
+    mem_mapped += pages * mem_pagesize();
+    mem_update_peak();
+    return (void *)(mem_map_start + (i - pages) * mem_pagesize());
+}
+
+/*
+ * mem_unmap - simple model of munmap. Releases the pages of [addr,
+ *    addr+len), which may be any page-aligned part of a mapped region.
+ */
+int mem_unmap(void *addr, size_t len)
+{
+    size_t first = ((char *)addr - mem_map_start) / mem_pagesize();
+    size_t pages = (len + mem_pagesize() - 1) / mem_pagesize();
+    size_t i;
+
+    if (((char *)addr < mem_map_start) || 
+	(((char *)addr - mem_map_start) % mem_pagesize() != 0) ||
+	(first + pages > mem_map_pages)) {
+	errno = EINVAL;
+	return -1;
+    }
+    for (i = first; i < first + pages; i++) {
+	if (mem_map_used[i]) {
+	    mem_map_used[i] = 0;
+	    mem_mapped -= mem_pagesize();
+	}
+    }
+    return 0;
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
@@ -84,6 +169,16 @@ void *mem_heap_hi()
     return (void *)(mem_brk - 1);
 }
 
+/*
+ * mem_heap_clean - return the address from which the area above the brk
+ *    reads as zero: the highest brk so far, since the model never clears
+ *    memory the heap gave back
+ */
+void *mem_heap_clean()
+{
+    return (void *)mem_clean_brk;
+}
+
 /*
  * mem_heapsize() - returns the heap size in bytes
  */
@@ -92,6 +187,50 @@ size_t mem_heapsize()
     return (size_t)(mem_brk - mem_start_brk);
 }
 
+/*
+ * mem_map_lo - return address of the first byte that mem_map can hand out
+ */
+void *mem_map_lo()
+{
+    return (void *)mem_map_start;
+}
+
+/*
+ * mem_map_hi - return address of the last byte that mem_map can hand out
+ */
+void *mem_map_hi()
+{
+    return (void *)(mem_map_start + mem_map_pages * mem_pagesize() - 1);
+}
+
+/*
+ * mem_mapsize() - returns the number of bytes currently mapped
+ */
+size_t mem_mapsize()
+{
+    return mem_mapped;
+}
+
+/*
+ * mem_peaksize() - returns the largest heap plus mapped size since the
+ *    last mem_reset_brk
+ */
+size_t mem_peaksize()
+{
+    return mem_peak;
+}
+
+/*
+ * mem_update_peak - fold the current footprint into the peak
+ */
+static void mem_update_peak(void)
+{
+    size_t size = mem_heapsize() + mem_mapped;
+
+    if (size > mem_peak)
+	mem_peak = size;
+}
+
 /*
  * mem_pagesize() - returns the page size of the system
  */
@@ -3,9 +3,16 @@
 void mem_init(void);               
 void mem_deinit(void);
 void *mem_sbrk(int incr);
+void *mem_map(size_t len);            /* zeroed, as with mmap */
+int mem_unmap(void *addr, size_t len);
 void mem_reset_brk(void); 
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
+void *mem_heap_clean(void);           /* zero from here up, above the brk */
 size_t mem_heapsize(void);
+void *mem_map_lo(void);
+void *mem_map_hi(void);
+size_t mem_mapsize(void);
+size_t mem_peaksize(void);
 size_t mem_pagesize(void);
 
@@ -0,0 +1,233 @@
+/*
+ * memsys.c - memlib.h on top of the real virtual memory system, so that
+ *            mm.c can serve the malloc calls of a real process (libmm.so)
+ *
+ * The heap lives in one large region reserved with mmap at start-up,
+ * with MAP_NORESERVE so that only the pages the heap touches cost
+ * memory. mem_sbrk moves the break inside that region, and when the
+ * heap shrinks, the whole pages above the new break are given back
+ * with madvise(MADV_DONTNEED), so the resident set follows the heap,
+ * and the bytes around those pages are cleared, so that the heap grows
+ * over zeroed memory again (see mem_heap_clean).
+ * A private region rather than the real brk keeps us out of the way
+ * of anything else in the process that calls sbrk. mem_map and
+ * mem_unmap are plain anonymous mmap and munmap.
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <errno.h>
+
+#include "memlib.h"
+
+/* Address space reserved for the heap: 32 GB on 64-bit systems, and 256 MB
+   otherwise. The free list links of mm.c count double words in 32 bits, so
+   they reach 32 GB. Its block sizes fit one 32-bit header word, so a heap
+   larger than 4 GB is made of several blocks, each below 4 GB (MAX_BLKSIZE) */
+#define SYS_HEAP ((size_t)1 << (sizeof(void *) == 8 ? 35 : 28))
+#define MIN_HEAP ((size_t)1 << 24)  /* give up below this reservation */
+
+/* private variables */
+static char *mem_start_brk;  /* points to first byte of heap */
+static char *mem_brk;        /* points to last byte of heap */
+static char *mem_max_addr;   /* largest legal heap address */
+static char *mem_clean_brk;  /* the heap area is zero from here up */
+static size_t mem_mapped;    /* bytes currently mapped by mem_map */
+static size_t mem_peak;      /* largest heap plus mapped size so far */
+
+static void mem_update_peak(void);
+
+/*
+ * mem_init - reserve the address space of the heap, halving the
+ *    reservation until the system grants it
+ */
+void mem_init(void)
+{
+    size_t len;
+    void *p;
+
+    for (len = SYS_HEAP; len >= MIN_HEAP; len /= 2) {
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (p != MAP_FAILED)
+	    break;
+    }
+    if (len < MIN_HEAP) {
+	fprintf(stderr, "mem_init: mmap error\n");
+	exit(1);
+    }
+    mem_start_brk = (char *)p;
+    mem_max_addr = mem_start_brk + len;
+    mem_brk = mem_start_brk;
+    mem_clean_brk = mem_start_brk;
+    mem_mapped = 0;
+    mem_peak = 0;
+}
+
+/*
+ * mem_deinit - release the heap reservation
+ */
+void mem_deinit(void)
+{
+    munmap(mem_start_brk, mem_max_addr - mem_start_brk);
+}
+
+/*
+ * mem_reset_brk - empty the heap and give its pages back
+ */
+void mem_reset_brk()
+{
+    /* mem_sbrk takes an int, so a heap of over 2 GB goes in steps */
+    while (mem_brk - mem_start_brk > INT_MAX)
+	mem_sbrk(-INT_MAX);
+    mem_sbrk(-(int)(mem_brk - mem_start_brk));
+    mem_peak = 0;
+}
+
+/*
+ * mem_sbrk - move the break by incr bytes and return its old value.
+ *    Whole pages left above a lower break go back to the system, and
+ *    the bytes around them are cleared.
+ */
+void *mem_sbrk(int incr)
+{
+    char *old_brk = mem_brk;
+    char *lo, *hi;
+
+    if (((mem_brk + incr) < mem_start_brk) ||
+	((mem_brk + incr) > mem_max_addr)) {
+	errno = ENOMEM;
+	return (void *)-1;
+    }
+    mem_brk += incr;
+    if (incr < 0) {
+	lo = mem_start_brk + (mem_brk - mem_start_brk + mem_pagesize() - 1) /
+	    mem_pagesize() * mem_pagesize();
+	hi = mem_start_brk + (old_brk - mem_start_brk) / mem_pagesize() *
+	    mem_pagesize();
+	if (lo < hi) {
+	    memset(mem_brk, 0, lo - mem_brk);
+	    madvise(lo, hi - lo, MADV_DONTNEED);
+	    memset(hi, 0, old_brk - hi);
+	} else
+	    memset(mem_brk, 0, old_brk - mem_brk);
+	mem_clean_brk = mem_brk;
+    } else if (mem_brk > mem_clean_brk)
+	mem_clean_brk = mem_brk;
+    mem_update_peak();
+    return (void *)old_brk;
+}
+
+/*
+ * mem_map - map len bytes (rounded up to whole pages) outside the heap
+ */
+void *mem_map(size_t len)
+{
+    void *p;
+
+    len = (len + mem_pagesize() - 1) / mem_pagesize() * mem_pagesize();
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+	     -1, 0);
+    if (p == MAP_FAILED)
+	return (void *)-1;
+    mem_mapped += len;
+    mem_update_peak();
+    return p;
+}
+
+/*
+ * mem_unmap - unmap any page-aligned part of a mem_map region
+ */
+int mem_unmap(void *addr, size_t len)
+{
+    len = (len + mem_pagesize() - 1) / mem_pagesize() * mem_pagesize();
+    if (munmap(addr, len) < 0)
+	return -1;
+    mem_mapped -= len;
+    return 0;
+}
+
+/*
+ * mem_heap_lo - return address of the first heap byte
+ */
+void *mem_heap_lo()
+{
+    return (void *)mem_start_brk;
+}
+
+/*
+ * mem_heap_hi - return address of last heap byte
+ */
+void *mem_heap_hi()
+{
+    return (void *)(mem_brk - 1);
+}
+
+/*
+ * mem_heap_clean - return the address from which the area above the brk
+ *    reads as zero: the highest brk since the heap last shrank
+ */
+void *mem_heap_clean()
+{
+    return (void *)mem_clean_brk;
+}
+
+/*
+ * mem_heapsize() - returns the heap size in bytes
+ */
+size_t mem_heapsize()
+{
+    return (size_t)(mem_brk - mem_start_brk);
+}
+
+/*
+ * mem_map_lo, mem_map_hi - mappings may lie anywhere in the address space
+ */
+void *mem_map_lo()
+{
+    return (void *)0;
+}
+
+void *mem_map_hi()
+{
+    return (void *)~(size_t)0;
+}
+
+/*
+ * mem_mapsize() - returns the number of bytes currently mapped
+ */
+size_t mem_mapsize()
+{
+    return mem_mapped;
+}
+
+/*
+ * mem_peaksize() - returns the largest heap plus mapped size since the
+ *    last mem_reset_brk
+ */
+size_t mem_peaksize()
+{
+    return mem_peak;
+}
+
+/*
+ * mem_pagesize() - returns the page size of the system
+ */
+size_t mem_pagesize()
+{
+    return (size_t)getpagesize();
+}
+
+/*
+ * mem_update_peak - remember the largest footprint seen so far
+ */
+static void mem_update_peak(void)
+{
+    size_t size = mem_heapsize() + mem_mapped;
+
+    if (size > mem_peak)
+	mem_peak = size;
+}
@@ -0,0 +1,350 @@
+/*
+ * mgen.c - Generate a synthetic mdriver trace file from a size
+ *     distribution and a lifetime distribution.
+ *
+ * Usage: mgen [-h] [-n <n>] [-s <dist>] [-H <file>] [-l <dist>]
+ *             [-r <p>] [-S <seed>] [-o <file>]
+ *
+ * The generator performs n allocations. Each block draws its size from
+ * the size distribution and its lifetime, measured in allocations,
+ * from the lifetime distribution; it is freed once that many further
+ * allocations have happened. With probability p a live block is
+ * resized to a fresh size before the next allocation. Blocks still
+ * live after the last allocation are freed at the end. As in mtrace,
+ * the id of a freed block is reused by the next allocation.
+ *
+ * A distribution is written as one of
+ *     const:<v>              always v
+ *     uniform:<lo>:<hi>      uniform on [lo, hi]
+ *     exp:<mean>             exponential with the given mean
+ *     lognormal:<mu>:<sigma> exp(N(mu, sigma^2))
+ * and -H reads an empirical size histogram instead: one "<size> <weight>"
+ * pair per line, for instance taken from a recorded trace.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <math.h>
+
+#define MAXLINE  1024         /* max string size */
+#define MAXSIZE  (1 << 24)    /* largest block size we generate */
+#define MAXHIST  4096         /* max entries in a size histogram */
+
+/* A parsed distribution */
+typedef struct {
+    enum {CONST, UNIFORM, EXP, LOGNORMAL, HIST} kind;
+    double a, b;              /* parameters, meaning depends on kind */
+    int hist_len;             /* HIST: number of entries */
+    long hist_size[MAXHIST];  /* HIST: sizes */
+    double hist_cum[MAXHIST]; /* HIST: cumulative weights */
+} dist_t;
+
+/* A live block in the min-heap ordered by the time it dies */
+typedef struct {
+    long death;               /* allocation count at which it is freed */
+    int id;
+} event_t;
+
+/* The trace being built, kept in memory until the header is known */
+static char *ops = NULL;
+static size_t ops_len = 0, ops_cap = 0;
+static int num_ops = 0;
+
+/* The min-heap of live blocks */
+static event_t *heap = NULL;
+static int heap_len = 0;
+
+/* Ids of freed blocks, reused by later allocations */
+static int *free_ids = NULL;
+static int num_free_ids = 0;
+static int num_ids = 0;
+
+static void usage(void);
+static void app_error(char *msg);
+static void parse_dist(char *spec, dist_t *d);
+static void read_hist(char *path, dist_t *d);
+static double sample(dist_t *d);
+static double unit(void);
+static void emit(char *fmt, ...);
+static void heap_push(long death, int id);
+static event_t heap_pop(void);
+
+int main(int argc, char **argv)
+{
+    static dist_t size_dist, life_dist;
+    long n = 10000, t, size, life;
+    double p_realloc = 0.0;
+    unsigned seed = 1;
+    char *outname = NULL;
+    int c;
+    FILE *fp;
+    event_t e;
+    int id;
+
+    parse_dist("uniform:1:4096", &size_dist);
+    parse_dist("exp:100", &life_dist);
+
+    while ((c = getopt(argc, argv, "hn:s:H:l:r:S:o:")) != EOF) {
+	switch (c) {
+	case 'n':
+	    n = atol(optarg);
+	    break;
+	case 's':
+	    parse_dist(optarg, &size_dist);
+	    break;
+	case 'H':
+	    read_hist(optarg, &size_dist);
+	    break;
+	case 'l':
+	    parse_dist(optarg, &life_dist);
+	    break;
+	case 'r':
+	    p_realloc = atof(optarg);
+	    break;
+	case 'S':
+	    seed = (unsigned)atol(optarg);
+	    break;
+	case 'o':
+	    outname = optarg;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (n <= 0)
+	app_error("-n must be positive");
+    srand(seed);
+
+    if ((heap = malloc(n * sizeof(event_t))) == NULL ||
+	(free_ids = malloc(n * sizeof(int))) == NULL)
+	app_error("out of memory");
+
+    for (t = 0; t < n; t++) {
+	/* Free every block whose lifetime is over */
+	while (heap_len > 0 && heap[0].death <= t) {
+	    e = heap_pop();
+	    free_ids[num_free_ids++] = e.id;
+	    emit("f %d\n", e.id);
+	}
+
+	/* Occasionally resize one of the live blocks */
+	if (heap_len > 0 && unit() < p_realloc) {
+	    id = heap[rand() % heap_len].id;
+	    size = (long)sample(&size_dist);
+	    emit("r %d %ld\n", id, size);
+	}
+
+	/* Allocate the next block */
+	id = (num_free_ids > 0) ? free_ids[--num_free_ids] : num_ids++;
+	size = (long)sample(&size_dist);
+	life = (long)sample(&life_dist);
+	emit("a %d %ld\n", id, size);
+	heap_push(t + 1 + life, id);
+    }
+    while (heap_len > 0) {
+	e = heap_pop();
+	emit("f %d\n", e.id);
+    }
+
+    if (outname == NULL)
+	fp = stdout;
+    else if ((fp = fopen(outname, "w")) == NULL)
+	app_error("could not open the output file");
+    fprintf(fp, "%d\n%d\n%d\n%d\n", 0, num_ids, num_ops, 1);
+    fwrite(ops, 1, ops_len, fp);
+    if (fp != stdout)
+	fclose(fp);
+    return 0;
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mgen [-h] [-n <n>] [-s <dist>] [-H <file>] "
+	    "[-l <dist>] [-r <p>] [-S <seed>] [-o <file>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-n <n>     Number of allocations (default 10000).\n");
+    fprintf(stderr, "\t-s <dist>  Size distribution "
+	    "(default uniform:1:4096).\n");
+    fprintf(stderr, "\t-H <file>  Read a size histogram of "
+	    "\"<size> <weight>\" lines.\n");
+    fprintf(stderr, "\t-l <dist>  Lifetime distribution in allocations "
+	    "(default exp:100).\n");
+    fprintf(stderr, "\t-r <p>     Probability of a realloc per step "
+	    "(default 0).\n");
+    fprintf(stderr, "\t-S <seed>  Random seed (default 1).\n");
+    fprintf(stderr, "\t-o <file>  Output file (default stdout).\n");
+    fprintf(stderr, "Distributions: const:<v> uniform:<lo>:<hi> "
+	    "exp:<mean> lognormal:<mu>:<sigma>\n");
+}
+
+/*
+ * app_error - Report an error and exit
+ */
+static void app_error(char *msg)
+{
+    fprintf(stderr, "mgen: %s\n", msg);
+    exit(1);
+}
+
+/*
+ * parse_dist - Parse a distribution given on the command line
+ */
+static void parse_dist(char *spec, dist_t *d)
+{
+    if (sscanf(spec, "const:%lf", &d->a) == 1)
+	d->kind = CONST;
+    else if (sscanf(spec, "uniform:%lf:%lf", &d->a, &d->b) == 2)
+	d->kind = UNIFORM;
+    else if (sscanf(spec, "exp:%lf", &d->a) == 1)
+	d->kind = EXP;
+    else if (sscanf(spec, "lognormal:%lf:%lf", &d->a, &d->b) == 2)
+	d->kind = LOGNORMAL;
+    else {
+	fprintf(stderr, "mgen: bad distribution \"%s\"\n", spec);
+	exit(1);
+    }
+    if (d->kind == UNIFORM && d->b < d->a)
+	app_error("uniform distribution with hi < lo");
+}
+
+/*
+ * read_hist - Read an empirical size histogram
+ */
+static void read_hist(char *path, dist_t *d)
+{
+    char line[MAXLINE];
+    double weight, total = 0;
+    long size;
+    FILE *fp;
+
+    if ((fp = fopen(path, "r")) == NULL)
+	app_error("could not open the histogram file");
+    d->kind = HIST;
+    d->hist_len = 0;
+    while (fgets(line, MAXLINE, fp) != NULL) {
+	if (sscanf(line, "%ld %lf", &size, &weight) != 2 || weight <= 0)
+	    continue;
+	if (d->hist_len == MAXHIST)
+	    app_error("histogram has too many entries");
+	total += weight;
+	d->hist_size[d->hist_len] = size;
+	d->hist_cum[d->hist_len] = total;
+	d->hist_len++;
+    }
+    fclose(fp);
+    if (d->hist_len == 0)
+	app_error("histogram is empty");
+}
+
+/*
+ * sample - Draw one value from a distribution, clamped to [1, MAXSIZE]
+ */
+static double sample(dist_t *d)
+{
+    double u, x = 0;
+    int lo, hi, mid;
+
+    switch (d->kind) {
+    case CONST:
+	x = d->a;
+	break;
+    case UNIFORM:
+	x = d->a + unit() * (d->b - d->a + 1);
+	break;
+    case EXP:
+	x = -d->a * log(1.0 - unit());
+	break;
+    case LOGNORMAL: /* Box-Muller */
+	u = sqrt(-2.0 * log(1.0 - unit())) * cos(2 * M_PI * unit());
+	x = exp(d->a + d->b * u);
+	break;
+    case HIST:	    /* binary search the cumulative weights */
+	u = unit() * d->hist_cum[d->hist_len - 1];
+	for (lo = 0, hi = d->hist_len - 1; lo < hi; ) {
+	    mid = (lo + hi) / 2;
+	    if (d->hist_cum[mid] <= u)
+		lo = mid + 1;
+	    else
+		hi = mid;
+	}
+	x = d->hist_size[lo];
+	break;
+    }
+    if (x < 1)
+	x = 1;
+    if (x > MAXSIZE)
+	x = MAXSIZE;
+    return x;
+}
+
+/*
+ * unit - Return a uniform random number in [0, 1)
+ */
+static double unit(void)
+{
+    return rand() / ((double)RAND_MAX + 1);
+}
+
+/*
+ * emit - Append one operation to the trace body
+ */
+static void emit(char *fmt, ...)
+{
+    va_list ap;
+
+    if (ops_cap - ops_len < MAXLINE) {
+	ops_cap = (ops_cap == 0) ? (1 << 20) : 2 * ops_cap;
+	if ((ops = realloc(ops, ops_cap)) == NULL)
+	    app_error("out of memory");
+    }
+    va_start(ap, fmt);
+    ops_len += vsprintf(ops + ops_len, fmt, ap);
+    va_end(ap);
+    num_ops++;
+}
+
+/*
+ * heap_push - Insert a live block into the min-heap
+ */
+static void heap_push(long death, int id)
+{
+    int i = heap_len++, parent;
+
+    while (i > 0 && heap[parent = (i - 1) / 2].death > death) {
+	heap[i] = heap[parent];
+	i = parent;
+    }
+    heap[i].death = death;
+    heap[i].id = id;
+}
+
+/*
+ * heap_pop - Remove and return the block that dies first
+ */
+static event_t heap_pop(void)
+{
+    event_t top = heap[0], last = heap[--heap_len];
+    int i = 0, child;
+
+    while ((child = 2 * i + 1) < heap_len) {
+	if (child + 1 < heap_len && heap[child + 1].death < heap[child].death)
+	    child++;
+	if (heap[child].death >= last.death)
+	    break;
+	heap[i] = heap[child];
+	i = child;
+    }
+    heap[i] = last;
+    return top;
+}
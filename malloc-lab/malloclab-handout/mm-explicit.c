@@ -8,6 +8,7 @@
  * 4. Choose best adaptation as the input strategy.
  */
 #include <assert.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -40,15 +41,17 @@ team_t team = {
 #define ALIGN(size) (((size) + (ALIGNMENT - 1)) & ~0x7)
 
 /* Basic constants and macros */
-#define WSIZE 4             /* Word and header/footer size (bytes) */
-#define DSIZE 8             /* Double word size (bytes) */
-#define CHUNKSIZE (1 << 12) /* Extend heap by this amount (bytes) */
+#define WSIZE 4                   /* Word and header/footer size (bytes) */
+#define DSIZE 8                   /* Double word size (bytes) */
+#define CHUNKSIZE (1 << 12)       /* Extend heap by this amount (bytes) */
+#define MIN_BLKSIZE (2 * DSIZE)   /* Minimum block size (bytes) */
+#define MAX_REQUEST (INT_MAX / 2) /* Largest request one mem_sbrk can serve */
 
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 #define MIN(x, y) ((x) > (y) ? (y) : (x))
 
-/* Pack a size and allocated bit into a word */
-#define PACK(size, alloc) ((size) | (alloc))
+/* Pack a size, previous allocated bit and allocated bit into a word */
+#define PACK(size, prev_alloc, alloc) ((size) | ((prev_alloc) << 1) | (alloc))
 
 /* Read and write a word at address p */
 #define GET(p) (*(unsigned int *)(p))
@@ -57,21 +60,31 @@ team_t team = {
 /* Read the size and allocated fields from address p */
 #define GET_SIZE(p) (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
+#define GET_PREV_ALLOC(p) ((GET(p) >> 1) & 0x1)
 
-/* Given block ptr bp, compute address of its header and fotter */
+/* Set or clear the previous allocated bit of the header at address p */
+#define SET_PREV_ALLOC(p) PUT(p, GET(p) | 0x2)
+#define CLR_PREV_ALLOC(p) PUT(p, GET(p) & ~0x2)
+
+/* Given block ptr bp, compute address of its header and fotter
+ * (allocated blocks have no footer, their payload runs up to the next header) */
 #define HDRP(bp) ((char *)(bp) - WSIZE)
 #define FTRP(bp) ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
 
-/* Given block ptr bp, compute address of next and previous blocks */
+/* Given block ptr bp, compute address of next and previous blocks
+ * (PREV_BLKP is only valid when the previous block is free) */
 #define NEXT_BLKP(bp) ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp) ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 
-/* Given free block ptr bp, compute the offset from the base */
-#define GET_OFFSET(bp, base) ((char *)(bp) - (char *)(base))
+/* Given free block ptr bp, compute the offset from the base in double words,
+ * so that a 32-bit link can address a heap of up to 32 GB */
+#define GET_OFFSET(bp, base)                                                   \
+  ((unsigned int)(((char *)(bp) - (char *)(base)) / DSIZE))
 
 /* Given free block ptr bp, compute address of next and previous free blocks */
-#define NEXT_FREE_BLKP(bp, base) ((char *)(base) + GET(bp + WSIZE))
-#define PREV_FREE_BLKP(bp, base) ((char *)(base) + GET(bp))
+#define NEXT_FREE_BLKP(bp, base)                                               \
+  ((char *)(base) + (size_t)GET((char *)(bp) + WSIZE) * DSIZE)
+#define PREV_FREE_BLKP(bp, base) ((char *)(base) + (size_t)GET(bp) * DSIZE)
 
 static void *heap_listp; /* Prologue pointer */
 
@@ -91,12 +104,12 @@ int mm_init(void) {
   if ((heap_listp = mem_sbrk(6 * WSIZE)) == (void *)-1) {
     return -1;
   }
-  PUT(heap_listp, 0);                                /* Alignment padding */
-  PUT(heap_listp + (1 * WSIZE), PACK(2 * DSIZE, 1)); /* Prologue header */
-  PUT(heap_listp + (2 * WSIZE), 0);                  /* Prologue predecessor */
-  PUT(heap_listp + (3 * WSIZE), 0);                  /* Prologue successor */
-  PUT(heap_listp + (4 * WSIZE), PACK(2 * DSIZE, 1)); /* Prologue fotter */
-  PUT(heap_listp + (5 * WSIZE), PACK(0, 1));         /* Epilogue header */
+  PUT(heap_listp, 0);               /* Alignment padding */
+  PUT(heap_listp + (1 * WSIZE), PACK(2 * DSIZE, 1, 1)); /* Prologue header */
+  PUT(heap_listp + (2 * WSIZE), 0); /* Prologue predecessor */
+  PUT(heap_listp + (3 * WSIZE), 0); /* Prologue successor */
+  PUT(heap_listp + (4 * WSIZE), PACK(2 * DSIZE, 1, 1)); /* Prologue fotter */
+  PUT(heap_listp + (5 * WSIZE), PACK(0, 1, 1));         /* Epilogue header */
   heap_listp += (2 * WSIZE);
 
   /* Extend the empty heap with a free block of CHUNKSIZE bytes */
@@ -116,12 +129,12 @@ void *mm_malloc(size_t size) {
   char *bp;
 
   /* Ignore spurious requests */
-  if (size == 0) {
+  if (size == 0 || size > MAX_REQUEST) {
     return NULL;
   }
 
-  /* Adjust block size to include overhead and alignment reqs. */
-  asize = ALIGN(size) + DSIZE;
+  /* Adjust block size to include the header and alignment reqs. */
+  asize = MAX(ALIGN(size + WSIZE), MIN_BLKSIZE);
 
   /* Search the free list for a fit */
   if ((bp = find_fit(asize)) != NULL) {
@@ -143,9 +156,10 @@ void *mm_malloc(size_t size) {
  */
 void mm_free(void *ptr) {
   size_t size = GET_SIZE(HDRP(ptr));
+  size_t prev_alloc = GET_PREV_ALLOC(HDRP(ptr));
 
-  PUT(HDRP(ptr), PACK(size, 0));
-  PUT(FTRP(ptr), PACK(size, 0));
+  PUT(HDRP(ptr), PACK(size, prev_alloc, 0));
+  PUT(FTRP(ptr), PACK(size, prev_alloc, 0));
   coalesce(ptr);
 }
 
@@ -169,17 +183,36 @@ void *mm_realloc(void *ptr, size_t size) {
   if ((newptr = mm_malloc(size)) == NULL) {
     return NULL;
   }
-  memcpy(newptr, ptr, MIN(GET_SIZE(HDRP(ptr)) - DSIZE, size));
+  memcpy(newptr, ptr, MIN(GET_SIZE(HDRP(ptr)) - WSIZE, size));
   mm_free(ptr);
   return newptr;
 }
 
+/*
+ * mm_walk - Visit every block of the heap in address order. All free blocks
+ *     are on list 0.
+ */
+void mm_walk(mm_visit_t visit) {
+  char *bp;
+  size_t size;
+
+  for (bp = NEXT_BLKP(heap_listp); (size = GET_SIZE(HDRP(bp))) != 0;
+       bp = NEXT_BLKP(bp)) {
+    if (GET_ALLOC(HDRP(bp))) {
+      visit(bp, size, WSIZE, 1, -1);
+    } else {
+      visit(bp, size, 2 * WSIZE, 0, 0);
+    }
+  }
+}
+
 /*
  * extend_heap - Extend the heap with a free block of words words.
  */
 static void *extend_heap(size_t words) {
   char *bp;
   size_t size;
+  size_t prev_alloc;
 
   /* Allocate an even number of words to maintain alignment */
   size = (words % 2) ? (words + 1) * WSIZE : words * WSIZE;
@@ -187,9 +220,11 @@ static void *extend_heap(size_t words) {
     return NULL;
   }
 
-  PUT(HDRP(bp), PACK(size, 0));         /* Free block header */
-  PUT(FTRP(bp), PACK(size, 0));         /* Free block footer */
-  PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */
+  /* The old epilogue header becomes the free block header */
+  prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+  PUT(HDRP(bp), PACK(size, prev_alloc, 0)); /* Free block header */
+  PUT(FTRP(bp), PACK(size, prev_alloc, 0)); /* Free block footer */
+  PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 0, 1));  /* New epilogue header */
 
   /* Coalesce if the previous block was free */
   return coalesce(bp);
@@ -199,7 +234,7 @@ static void *extend_heap(size_t words) {
  * coalesce - Coalesce adjacent free blocks.
  */
 static void *coalesce(void *bp) {
-  size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
+  size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
   size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
   size_t size = GET_SIZE(HDRP(bp));
 
@@ -208,22 +243,23 @@ static void *coalesce(void *bp) {
   } else if (prev_alloc && !next_alloc) { /* Case 2 */
     remove_free_block(NEXT_BLKP(bp));
     size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
-    PUT(HDRP(bp), PACK(size, 0));
-    PUT(FTRP(bp), PACK(size, 0));
+    PUT(HDRP(bp), PACK(size, 1, 0));
+    PUT(FTRP(bp), PACK(size, 1, 0));
   } else if (!prev_alloc && next_alloc) { /* Case 3 */
     remove_free_block(PREV_BLKP(bp));
     size += GET_SIZE(HDRP(PREV_BLKP(bp)));
-    PUT(FTRP(bp), PACK(size, 0));
-    PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
     bp = PREV_BLKP(bp);
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)), 0));
+    PUT(FTRP(bp), GET(HDRP(bp)));
   } else { /* Case 4 */
     remove_free_block(NEXT_BLKP(bp));
     remove_free_block(PREV_BLKP(bp));
     size += GET_SIZE(HDRP(NEXT_BLKP(bp))) + GET_SIZE(HDRP(PREV_BLKP(bp)));
-    PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-    PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
     bp = PREV_BLKP(bp);
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)), 0));
+    PUT(FTRP(bp), GET(HDRP(bp)));
   }
+  CLR_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
   add_free_block(bp);
   return bp;
 }
@@ -247,18 +283,18 @@ static void *find_fit(size_t size) {
  */
 static void place(void *bp, size_t size) {
   size_t capacity = GET_SIZE(HDRP(bp));
+  size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
 
   remove_free_block(bp);
   /* Determine if this block can be cut */
-  if ((capacity - size) >= 2 * DSIZE) {
-    PUT(HDRP(bp), PACK(size, 1));
-    PUT(FTRP(bp), PACK(size, 1));
-    PUT(HDRP(NEXT_BLKP(bp)), PACK(capacity - size, 0));
-    PUT(FTRP(NEXT_BLKP(bp)), PACK(capacity - size, 0));
+  if ((capacity - size) >= MIN_BLKSIZE) {
+    PUT(HDRP(bp), PACK(size, prev_alloc, 1));
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(capacity - size, 1, 0));
+    PUT(FTRP(NEXT_BLKP(bp)), PACK(capacity - size, 1, 0));
     coalesce(NEXT_BLKP(bp));
   } else {
-    PUT(HDRP(bp), PACK(capacity, 1));
-    PUT(FTRP(bp), PACK(capacity, 1));
+    PUT(HDRP(bp), PACK(capacity, prev_alloc, 1));
+    SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
   }
 }
 
@@ -185,6 +185,25 @@ void *mm_realloc(void *ptr, size_t size) {
   return newptr;
 }
 
+/*
+ * mm_walk - Visit every block of the heap in address order. Allocated and
+ *     free blocks alike carry a header and a footer.
+ */
+void mm_walk(mm_visit_t visit) {
+  char *bp;
+  size_t size;
+
+  for (bp = NEXT_BLKP(heap_listp + 12 * WSIZE);
+       (size = GET_SIZE(HDRP(bp))) != 0; bp = NEXT_BLKP(bp)) {
+    if (GET_ALLOC(HDRP(bp))) {
+      visit(bp, size, DSIZE, 1, -1);
+    } else {
+      visit(bp, size, DSIZE, 0,
+            (int)(((char *)find_list(size) - (char *)heap_listp) / DSIZE));
+    }
+  }
+}
+
 /*
  * extend_heap - Extend the heap with a free block of words words.
  */
@@ -1,14 +1,20 @@
 /*
- * mm-segregated.c - Use segregated free list as the approach.
+ * mm.c - Use segregated free list as the approach.
  * 1. Use segregated free lists to record free blocks.
  * 2. After a free block is occupied, the remaining portion needs to be
  * processed.
  * 3. After freeing a block, the block needs to be merged with adjacent free
  * blocks.
  * 4. Choose best adaptation as the input strategy.
+ * 5. Serve small requests from page-sized slab runs of equal-size slots,
+ * which carry no per-object header.
+ * 6. Serve huge requests from their own mem_map region, and give trailing
+ * free space back with a negative mem_sbrk.
  */
 #include <assert.h>
+#include <limits.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -40,15 +46,40 @@ team_t team = {
 #define ALIGN(size) (((size) + (ALIGNMENT - 1)) & ~0x7)
 
 /* Basic constants and macros */
-#define WSIZE 4             /* Word and header/footer size (bytes) */
-#define DSIZE 8             /* Double word size (bytes) */
-#define CHUNKSIZE (1 << 12) /* Extend heap by this amount (bytes) */
+#define WSIZE 4                   /* Word and header/footer size (bytes) */
+#define DSIZE 8                   /* Double word size (bytes) */
+#define CHUNKSIZE (1 << 12)       /* Extend heap by this amount (bytes) */
+#define MIN_BLKSIZE (2 * DSIZE)   /* Minimum block size (bytes) */
+#define MAX_REQUEST (INT_MAX / 2) /* Largest request one mem_sbrk can serve */
+#define MAX_BLKSIZE ((size_t)UINT_MAX & ~(size_t)0x7) /* Largest header size */
+/* Largest request a mapping can serve: the mapping, rounded to pages of up to
+ * 64 KB, must fit in a header word */
+#define MAX_MAPPED ((size_t)UINT_MAX - (1 << 17))
+
+/* Extra bytes reserved when realloc grows a block of at least REALLOC_MIN
+ * bytes, so that repeatedly growing blocks are not moved on every call:
+ * one REALLOC_RATIO-th of the new size, up to REALLOC_HEADROOM. Override
+ * with -D. */
+#ifndef REALLOC_HEADROOM
+#define REALLOC_HEADROOM (1 << 7)
+#endif
+#ifndef REALLOC_RATIO
+#define REALLOC_RATIO 8
+#endif
+#ifndef REALLOC_MIN
+#define REALLOC_MIN (1 << 7)
+#endif
+
+/* Requests of at least MMAP_THRESHOLD bytes get their own mem_map region, and
+ * a free block of TRIM_THRESHOLD bytes at the end of the heap is released */
+#define MMAP_THRESHOLD (1 << 20)
+#define TRIM_THRESHOLD (1 << 16)
 
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 #define MIN(x, y) ((x) > (y) ? (y) : (x))
 
-/* Pack a size and allocated bit into a word */
-#define PACK(size, alloc) ((size) | (alloc))
+/* Pack a size, previous allocated bit and allocated bit into a word */
+#define PACK(size, prev_alloc, alloc) ((size) | ((prev_alloc) << 1) | (alloc))
 
 /* Read and write a word at address p */
 #define GET(p) (*(unsigned int *)(p))
@@ -57,26 +88,87 @@ team_t team = {
 /* Read the size and allocated fields from address p */
 #define GET_SIZE(p) (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
+#define GET_PREV_ALLOC(p) ((GET(p) >> 1) & 0x1)
+#define GET_MAPPED(p) (GET(p) & 0x4)
+
+/* Given mapped block ptr, compute the start of its mapping, which is the page
+ * holding its header */
+#define MAP_START(ptr)                                                         \
+  ((char *)((uintptr_t)HDRP(ptr) & ~(uintptr_t)(mem_pagesize() - 1)))
+
+/* Set or clear the previous allocated bit of the header at address p */
+#define SET_PREV_ALLOC(p) PUT(p, GET(p) | 0x2)
+#define CLR_PREV_ALLOC(p) PUT(p, GET(p) & ~0x2)
 
-/* Given block ptr bp, compute address of its header and fotter */
+/* Given block ptr bp, compute address of its header and fotter
+ * (allocated blocks have no footer, their payload runs up to the next header) */
 #define HDRP(bp) ((char *)(bp) - WSIZE)
 #define FTRP(bp) ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
 
-/* Given block ptr bp, compute address of next and previous blocks */
+/* Given block ptr bp, compute address of next and previous blocks
+ * (PREV_BLKP is only valid when the previous block is free) */
 #define NEXT_BLKP(bp) ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp) ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 
-/* Given free block ptr bp, compute the offset from the base */
-#define GET_OFFSET(bp, base) ((char *)(bp) - (char *)(base))
+/* Given free block ptr bp, compute the offset from the base in double words,
+ * so that a 32-bit link can address a heap of up to 32 GB */
+#define GET_OFFSET(bp, base)                                                   \
+  ((unsigned int)(((char *)(bp) - (char *)(base)) / DSIZE))
 
 /* Given base and offset, compute the address */
-#define GET_ADDRESS(offset, base) (())
+#define GET_ADDRESS(offset, base) ((char *)(base) + (size_t)(offset) * DSIZE)
 
 /* Given free block ptr bp, compute address of next and previous free blocks */
-#define NEXT_FREE_BLKP(bp, base) ((char *)(base) + GET(bp + WSIZE))
-#define PREV_FREE_BLKP(bp, base) ((char *)(base) + GET(bp))
+#define NEXT_FREE_BLKP(bp, base)                                               \
+  ((char *)(base) + (size_t)GET((char *)(bp) + WSIZE) * DSIZE)
+#define PREV_FREE_BLKP(bp, base) ((char *)(base) + (size_t)GET(bp) * DSIZE)
+
+/* Slab runs: page-aligned blocks whose payload starts with a run header of
+ * six words, followed by slots of one size class */
+#define SLAB_PAGE (1 << 12)                 /* Run block size (bytes) */
+#define SLAB_MAX 256                        /* Largest slab request (bytes) */
+#define SLAB_CLASSES (SLAB_MAX / ALIGNMENT) /* One class per multiple of 8 */
+#define SLAB_HDRSIZE (6 * WSIZE)            /* Run header size (bytes) */
+#define SLAB_LIMIT (SLAB_PAGE - WSIZE)      /* End of the last slot */
+#define SLAB_MAP_MIN (1 << 9)               /* Initial page map size (bytes) */
+
+/* A run per class would dominate a small heap, so below SLAB_MIN_HEAP bytes
+ * only a class with one SLAB_SHARE-th of the recent small requests starts a
+ * run or keeps an empty one. The counts halve every SLAB_WINDOW requests. */
+#define SLAB_MIN_HEAP (SLAB_CLASSES * SLAB_PAGE * 8)
+#define SLAB_SHARE 4
+#define SLAB_WINDOW (1 << 10)
+#define SLAB_WARMUP (1 << 4) /* Fewest requests a class is judged on */
+
+/* Given run ptr rp, compute address of its header fields */
+#define SLAB_SLOT(rp) ((char *)(rp))              /* Slot size */
+#define SLAB_USED(rp) ((char *)(rp) + WSIZE)      /* Slots in use */
+#define SLAB_FREE(rp) ((char *)(rp) + 2 * WSIZE)  /* First freed slot */
+#define SLAB_BUMP(rp) ((char *)(rp) + 3 * WSIZE)  /* First untouched slot */
+#define SLAB_PREV(rp) ((char *)(rp) + 4 * WSIZE)  /* Previous partial run */
+#define SLAB_NEXT(rp) ((char *)(rp) + 5 * WSIZE)  /* Next partial run */
+
+/* Given slab object ptr p, compute address of its run */
+#define SLAB_RUNP(p) ((char *)((uintptr_t)(p) & ~(uintptr_t)(SLAB_PAGE - 1)))
+
+/* Given run ptr rp, determine whether every slot is in use */
+#define SLAB_FULL(rp)                                                          \
+  (GET(SLAB_FREE(rp)) == 0 &&                                                  \
+   GET(SLAB_BUMP(rp)) + GET(SLAB_SLOT(rp)) > SLAB_LIMIT)
+
+/* Given a size class, compute address of the head of its partial run list,
+ * and of its count of recent requests */
+#define SLAB_LIST(cls) ((char *)heap_listp + (10 + (cls)) * WSIZE)
+#define SLAB_HITS(cls) ((char *)heap_listp + (10 + SLAB_CLASSES + (cls)) * WSIZE)
+
+/* Address of the count of recent small requests of all classes */
+#define SLAB_TOTAL ((char *)heap_listp + (10 + 2 * SLAB_CLASSES) * WSIZE)
 
 static void *heap_listp; /* Heap header */
+static char *slab_map;   /* Bitmap of the heap pages holding slab runs */
+static size_t slab_map_pages; /* Number of pages covered by slab_map */
+static char *slab_base;       /* First page covered by slab_map */
+static char *heap_fresh; /* No block has used the heap from here to the brk */
 
 /* Function declaration */
 static void *extend_heap(size_t words);
@@ -86,29 +178,61 @@ static void place(void *bp, size_t size);
 static void add_free_block(void *bp);
 static void remove_free_block(void *bp);
 static void *find_list(size_t size);
+static void shrink_block(void *bp, size_t size);
+static void *realloc_in_place(void *bp, size_t size, size_t gsize);
+static size_t aligned_gap(void *bp, size_t align);
+static void *find_aligned_fit(size_t size, size_t align);
+static void *place_aligned(void *bp, size_t size, size_t align);
+static void *alloc_aligned(size_t size, size_t align);
+static void trim_heap(void *bp);
+static void *map_alloc(size_t size, size_t align);
+static void map_free(void *ptr);
+static void map_shrink(void *ptr, size_t size);
+static int is_slab(void *ptr);
+static int slab_mark(void *rp, int used);
+static void slab_count(int cls);
+static int slab_wanted(int cls);
+static void *slab_alloc(size_t size);
+static void slab_free(void *ptr);
+static void slab_link(void *rp, int cls);
+static void slab_unlink(void *rp, int cls);
 
 /*
  * mm_init - initialize the malloc package.
  */
 int mm_init(void) {
+  int cls;
+
   /* Create the initial empty heap */
-  if ((heap_listp = mem_sbrk(7 * DSIZE)) == (void *)-1) {
+  if ((heap_listp = mem_sbrk((14 + 2 * SLAB_CLASSES) * WSIZE)) == (void *)-1) {
     return -1;
   }
-  PUT(heap_listp, 0);                       /* the predecessor of [2^4,2^6) */
-  PUT(heap_listp + (1 * WSIZE), 0);         /* the successor of [2^4,2^6) */
-  PUT(heap_listp + (2 * WSIZE), DSIZE);     /* the predecessor of [2^6,2^8) */
-  PUT(heap_listp + (3 * WSIZE), DSIZE);     /* the successor of [2^6,2^8) */
-  PUT(heap_listp + (4 * WSIZE), 2 * DSIZE); /* the predecessor of [2^8,2^10) */
-  PUT(heap_listp + (5 * WSIZE), 2 * DSIZE); /* the successor of [2^8,2^10) */
-  PUT(heap_listp + (6 * WSIZE), 3 * DSIZE); /* the predecessor of [2^10,2^12) */
-  PUT(heap_listp + (7 * WSIZE), 3 * DSIZE); /* the successor of [2^10,2^12) */
-  PUT(heap_listp + (8 * WSIZE), 4 * DSIZE); /* the predecessor of [2^12,inf) */
-  PUT(heap_listp + (9 * WSIZE), 4 * DSIZE); /* the successor of [2^12,inf) */
-  PUT(heap_listp + (10 * WSIZE), 0);        /* Alignment padding */
-  PUT(heap_listp + (11 * WSIZE), PACK(DSIZE, 1)); /* Prologue header */
-  PUT(heap_listp + (12 * WSIZE), PACK(DSIZE, 1)); /* Prologue footer */
-  PUT(heap_listp + (13 * WSIZE), PACK(0, 1));     /* Epilogue header */
+  PUT(heap_listp, 0);                /* the predecessor of [2^4,2^6) */
+  PUT(heap_listp + (1 * WSIZE), 0);  /* the successor of [2^4,2^6) */
+  PUT(heap_listp + (2 * WSIZE), 1);  /* the predecessor of [2^6,2^8) */
+  PUT(heap_listp + (3 * WSIZE), 1);  /* the successor of [2^6,2^8) */
+  PUT(heap_listp + (4 * WSIZE), 2);  /* the predecessor of [2^8,2^10) */
+  PUT(heap_listp + (5 * WSIZE), 2);  /* the successor of [2^8,2^10) */
+  PUT(heap_listp + (6 * WSIZE), 3);  /* the predecessor of [2^10,2^12) */
+  PUT(heap_listp + (7 * WSIZE), 3);  /* the successor of [2^10,2^12) */
+  PUT(heap_listp + (8 * WSIZE), 4);  /* the predecessor of [2^12,inf) */
+  PUT(heap_listp + (9 * WSIZE), 4);  /* the successor of [2^12,inf) */
+  for (cls = 0; cls < SLAB_CLASSES; cls++) {
+    PUT(SLAB_LIST(cls), 0); /* the partial runs of each slab class */
+    PUT(SLAB_HITS(cls), 0); /* the recent requests of each slab class */
+  }
+  PUT(SLAB_TOTAL, 0); /* the recent small requests, in place of padding */
+  PUT(heap_listp + ((11 + 2 * SLAB_CLASSES) * WSIZE),
+      PACK(DSIZE, 1, 1)); /* Prologue header */
+  PUT(heap_listp + ((12 + 2 * SLAB_CLASSES) * WSIZE),
+      PACK(DSIZE, 1, 1)); /* Prologue footer */
+  PUT(heap_listp + ((13 + 2 * SLAB_CLASSES) * WSIZE),
+      PACK(0, 1, 1)); /* Epilogue header */
+
+  slab_map = NULL;
+  slab_map_pages = 0;
+  slab_base = SLAB_RUNP(mem_heap_lo());
+  heap_fresh = (char *)mem_heap_hi() + 1;
 
   /* Extend the empty heap with a free block of CHUNKSIZE bytes */
   if (extend_heap(CHUNKSIZE / WSIZE) == NULL) {
@@ -125,14 +249,34 @@ void *mm_malloc(size_t size) {
   size_t asize;      /* Adjusted block size */
   size_t extendsize; /* Amount to extend heap if no fit */
   char *bp;
+  int cls;
 
   /* Ignore spurious requests */
-  if (size == 0) {
+  if (size == 0 || size > MAX_MAPPED) {
+    return NULL;
+  }
+
+  /* Small requests are served from slab runs if their class has a partial
+   * run or is in demand */
+  if (size <= SLAB_MAX) {
+    cls = ALIGN(size) / ALIGNMENT - 1;
+    slab_count(cls);
+    if (GET(SLAB_LIST(cls)) != 0 || slab_wanted(cls)) {
+      return slab_alloc(size);
+    }
+  }
+
+  /* Huge requests are served from their own mapping, and the rest from the
+   * heap, where one mem_sbrk call must be able to cover them */
+  if (size >= MMAP_THRESHOLD) {
+    return map_alloc(size, DSIZE);
+  }
+  if (size > MAX_REQUEST) {
     return NULL;
   }
 
-  /* Adjust block size to include overhead and alignment reqs. */
-  asize = ALIGN(size) + DSIZE;
+  /* Adjust block size to include the header and alignment reqs. */
+  asize = MAX(ALIGN(size + WSIZE), MIN_BLKSIZE);
 
   /* Search the free list for a fit */
   if ((bp = find_fit(asize)) != NULL) {
@@ -153,18 +297,34 @@ void *mm_malloc(size_t size) {
  * mm_free - Freeing a block does nothing.
  */
 void mm_free(void *ptr) {
-  size_t size = GET_SIZE(HDRP(ptr));
+  size_t size;
+  size_t prev_alloc;
+
+  if (is_slab(ptr)) {
+    slab_free(ptr);
+    return;
+  }
+  if (GET_MAPPED(HDRP(ptr))) {
+    map_free(ptr);
+    return;
+  }
 
-  PUT(HDRP(ptr), PACK(size, 0));
-  PUT(FTRP(ptr), PACK(size, 0));
-  coalesce(ptr);
+  size = GET_SIZE(HDRP(ptr));
+  prev_alloc = GET_PREV_ALLOC(HDRP(ptr));
+  PUT(HDRP(ptr), PACK(size, prev_alloc, 0));
+  PUT(FTRP(ptr), PACK(size, prev_alloc, 0));
+  trim_heap(coalesce(ptr));
 }
 
 /*
- * mm_realloc - Implemented simply in terms of mm_malloc and mm_free
+ * mm_realloc - Resize the block in place whenever the heap layout allows it,
+ *     and fall back to mm_malloc, memcpy and mm_free otherwise.
  */
 void *mm_realloc(void *ptr, size_t size) {
   void *newptr;
+  size_t capacity;
+  size_t asize; /* Adjusted block size */
+  size_t gsize; /* Adjusted block size plus the growth headroom */
 
   if (ptr ==
       NULL) { /* If ptr is NULL, the call is equivalent to mm_malloc(size) */
@@ -176,65 +336,226 @@ void *mm_realloc(void *ptr, size_t size) {
     return NULL;
   }
 
+  if (size > MAX_MAPPED) {
+    return NULL;
+  }
+
+  /* A slab object keeps its slot as long as the new size fits in it */
+  if (is_slab(ptr)) {
+    capacity = GET(SLAB_SLOT(SLAB_RUNP(ptr)));
+    if (size <= capacity) {
+      return ptr;
+    }
+    if ((newptr = mm_malloc(size)) == NULL) {
+      return NULL;
+    }
+    memcpy(newptr, ptr, capacity);
+    slab_free(ptr);
+    return newptr;
+  }
+
+  /* A mapped block gives back its tail pages while the request stays huge */
+  if (GET_MAPPED(HDRP(ptr))) {
+    capacity = MAP_START(ptr) + GET_SIZE(HDRP(ptr)) - (char *)ptr;
+    if (size >= MMAP_THRESHOLD && size <= capacity) {
+      map_shrink(ptr, size);
+      return ptr;
+    }
+    if ((newptr = mm_malloc(size)) == NULL) {
+      return NULL;
+    }
+    memcpy(newptr, ptr, MIN(capacity, size));
+    map_free(ptr);
+    return newptr;
+  }
+
+  capacity = GET_SIZE(HDRP(ptr));
+  asize = MAX(ALIGN(size + WSIZE), MIN_BLKSIZE);
+  if (capacity >= asize) { /* Shrink the block by splitting off the tail */
+    shrink_block(ptr, asize);
+    return ptr;
+  }
+
+  gsize = asize;
+  if (asize >= REALLOC_MIN) {
+    gsize += MIN(ALIGN(asize / REALLOC_RATIO), REALLOC_HEADROOM);
+  }
+  if (size <= MAX_REQUEST &&
+      (newptr = realloc_in_place(ptr, asize, gsize)) != NULL) {
+    return newptr;
+  }
+
   /* Add a new block */
-  if ((newptr = mm_malloc(size)) == NULL) {
+  if ((newptr = mm_malloc(gsize - WSIZE)) == NULL) {
     return NULL;
   }
-  memcpy(newptr, ptr, MIN(GET_SIZE(HDRP(ptr)) - DSIZE, size));
+  memcpy(newptr, ptr, capacity - WSIZE);
   mm_free(ptr);
   return newptr;
 }
 
+/*
+ * mm_memalign - Allocate a block of size bytes whose payload is aligned to
+ *     align bytes, a power of two. The space in front of the aligned payload
+ *     goes back to the free lists, or to the system for a mapped block.
+ */
+void *mm_memalign(size_t align, size_t size) {
+  if (size == 0 || size > MAX_MAPPED || (align & (align - 1)) != 0) {
+    return NULL;
+  }
+  if (align <= ALIGNMENT) {
+    return mm_malloc(size);
+  }
+  if (size >= MMAP_THRESHOLD) {
+    return map_alloc(size, align);
+  }
+  return alloc_aligned(MAX(ALIGN(size + WSIZE), MIN_BLKSIZE), align);
+}
+
+/*
+ * mm_calloc - Allocate a zeroed block for nmemb elements of size bytes. Only
+ *     the part of the block below heap_fresh can hold old data, apart from the
+ *     footer of a free block that was not split. Mapped blocks are zero.
+ */
+void *mm_calloc(size_t nmemb, size_t size) {
+  char *fresh = heap_fresh;
+  size_t total;
+  char *bp;
+
+  if (nmemb != 0 && size > MAX_MAPPED / nmemb) {
+    return NULL;
+  }
+  total = nmemb * size;
+  if ((bp = mm_malloc(total)) == NULL) {
+    return NULL;
+  }
+
+  if (is_slab(bp)) {
+    memset(bp, 0, total);
+  } else if (!GET_MAPPED(HDRP(bp))) {
+    if (bp < fresh) {
+      memset(bp, 0, MIN((size_t)(fresh - bp), total));
+    }
+    PUT(FTRP(bp), 0);
+  }
+  return bp;
+}
+
+/*
+ * mm_usable_size - Return the number of payload bytes the block at ptr can
+ *     hold, which may exceed the size it was requested with.
+ */
+size_t mm_usable_size(void *ptr) {
+  if (ptr == NULL) {
+    return 0;
+  }
+  if (is_slab(ptr)) {
+    return GET(SLAB_SLOT(SLAB_RUNP(ptr)));
+  }
+  if (GET_MAPPED(HDRP(ptr))) {
+    return MAP_START(ptr) + GET_SIZE(HDRP(ptr)) - (char *)ptr;
+  }
+  return GET_SIZE(HDRP(ptr)) - WSIZE;
+}
+
+/*
+ * mm_walk - Visit every block of the heap in address order. A slab run is
+ *     one allocated block whose run header counts as overhead.
+ */
+void mm_walk(mm_visit_t visit) {
+  char *bp;
+  size_t size;
+
+  for (bp = NEXT_BLKP(heap_listp + (12 + 2 * SLAB_CLASSES) * WSIZE);
+       (size = GET_SIZE(HDRP(bp))) != 0; bp = NEXT_BLKP(bp)) {
+    if (!GET_ALLOC(HDRP(bp))) {
+      visit(bp, size, 2 * WSIZE, 0,
+            (int)(((char *)find_list(size) - (char *)heap_listp) / DSIZE));
+    } else if (is_slab(bp)) {
+      visit(bp, size, WSIZE + SLAB_HDRSIZE, 1, -1);
+    } else {
+      visit(bp, size, WSIZE, 1, -1);
+    }
+  }
+}
+
 /*
  * extend_heap - Extend the heap with a free block of words words.
  */
 static void *extend_heap(size_t words) {
   char *bp;
+  char *newbp;
+  char *clean = mem_heap_clean();
   size_t size;
+  size_t prev_alloc;
 
-  /* Allocate an even number of words to maintain alignment */
+  /* Allocate an even number of words to maintain alignment, within what
+   * the int argument of mem_sbrk can carry */
   size = (words % 2) ? (words + 1) * WSIZE : words * WSIZE;
-  if ((long)(bp = mem_sbrk(size)) == -1) {
+  if (size > INT_MAX || (long)(bp = mem_sbrk(size)) == -1) {
     return NULL;
   }
 
-  PUT(HDRP(bp), PACK(size, 0));         /* Free block header */
-  PUT(FTRP(bp), PACK(size, 0));         /* Free block footer */
-  PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */
+  /* Of the new memory, the part from clean up is zero */
+  heap_fresh = clean > bp ? MAX(heap_fresh, clean) : MIN(heap_fresh, bp);
 
-  /* Coalesce if the previous block was free */
-  return coalesce(bp);
+  /* The old epilogue header becomes the free block header */
+  prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+  PUT(HDRP(bp), PACK(size, prev_alloc, 0)); /* Free block header */
+  PUT(FTRP(bp), PACK(size, prev_alloc, 0)); /* Free block footer */
+  PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 0, 1));  /* New epilogue header */
+
+  /* Coalesce if the previous block was free. Its old footer and the old
+   * epilogue header then lie inside the free block: wipe them. */
+  if ((newbp = coalesce(bp)) != bp) {
+    PUT((char *)bp - DSIZE, 0);
+    PUT(HDRP(bp), 0);
+  }
+  return newbp;
 }
 
 /*
  * coalesce - Coalesce adjacent free blocks.
  */
 static void *coalesce(void *bp) {
-  size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
-  size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
   size_t size = GET_SIZE(HDRP(bp));
+  size_t next_size = GET_SIZE(HDRP(NEXT_BLKP(bp)));
+  size_t prev_size = 0;
+  size_t prev_alloc;
+  size_t next_alloc;
+
+  /* A neighbour stays apart, as if it were allocated, when the merged block
+   * would be too large for its header word */
+  next_alloc =
+      GET_ALLOC(HDRP(NEXT_BLKP(bp))) || size + next_size > MAX_BLKSIZE;
+  prev_alloc = GET_PREV_ALLOC(HDRP(bp)) ||
+               size + (prev_size = GET_SIZE(HDRP(PREV_BLKP(bp)))) > MAX_BLKSIZE;
+  if (!prev_alloc && !next_alloc && size + prev_size + next_size > MAX_BLKSIZE) {
+    prev_alloc = 1;
+  }
 
   if (prev_alloc && next_alloc) { /* Case 1 */
     // do nothing here
   } else if (prev_alloc && !next_alloc) { /* Case 2 */
     remove_free_block(NEXT_BLKP(bp));
-    size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
-    PUT(HDRP(bp), PACK(size, 0));
-    PUT(FTRP(bp), PACK(size, 0));
+    size += next_size;
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)), 0));
+    PUT(FTRP(bp), GET(HDRP(bp)));
   } else if (!prev_alloc && next_alloc) { /* Case 3 */
     remove_free_block(PREV_BLKP(bp));
-    size += GET_SIZE(HDRP(PREV_BLKP(bp)));
-    PUT(FTRP(bp), PACK(size, 0));
-    PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
+    size += prev_size;
     bp = PREV_BLKP(bp);
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)), 0));
+    PUT(FTRP(bp), GET(HDRP(bp)));
   } else { /* Case 4 */
     remove_free_block(NEXT_BLKP(bp));
     remove_free_block(PREV_BLKP(bp));
-    size += GET_SIZE(HDRP(NEXT_BLKP(bp))) + GET_SIZE(HDRP(PREV_BLKP(bp)));
-    PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-    PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
+    size += next_size + prev_size;
     bp = PREV_BLKP(bp);
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)), 0));
+    PUT(FTRP(bp), GET(HDRP(bp)));
   }
+  CLR_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
   add_free_block(bp);
   return bp;
 }
@@ -265,17 +586,8 @@ static void place(void *bp, size_t size) {
   size_t capacity = GET_SIZE(HDRP(bp));
 
   remove_free_block(bp);
-  /* Determine if this block can be cut */
-  if ((capacity - size) >= 2 * DSIZE) {
-    PUT(HDRP(bp), PACK(size, 1));
-    PUT(FTRP(bp), PACK(size, 1));
-    PUT(HDRP(NEXT_BLKP(bp)), PACK(capacity - size, 0));
-    PUT(FTRP(NEXT_BLKP(bp)), PACK(capacity - size, 0));
-    coalesce(NEXT_BLKP(bp));
-  } else {
-    PUT(HDRP(bp), PACK(capacity, 1));
-    PUT(FTRP(bp), PACK(capacity, 1));
-  }
+  PUT(HDRP(bp), PACK(capacity, GET_PREV_ALLOC(HDRP(bp)), 1));
+  shrink_block(bp, size);
 }
 
 /*
@@ -287,12 +599,12 @@ static void add_free_block(void *bp) {
   char *list_header = find_list(size);
   char *ptr = list_header;
   char *next_ptr = NEXT_FREE_BLKP(ptr, heap_listp);
-  size_t next_size = GET_SIZE(HDRP(next_ptr));
 
-  while ((next_ptr != list_header) && (next_size < size)) {
+  /* The list header has no block header of its own (the word in front of
+   * the first list header lies outside the heap), so never read its size */
+  while ((next_ptr != list_header) && (GET_SIZE(HDRP(next_ptr)) < size)) {
     ptr = next_ptr;
     next_ptr = NEXT_FREE_BLKP(ptr, heap_listp);
-    next_size = GET_SIZE(HDRP(next_ptr));
   }
 
   PUT(bp, GET(next_ptr));
@@ -307,6 +619,12 @@ static void add_free_block(void *bp) {
 static void remove_free_block(void *bp) {
   PUT(PREV_FREE_BLKP(bp, heap_listp) + WSIZE, GET(bp + WSIZE));
   PUT(NEXT_FREE_BLKP(bp, heap_listp), GET(bp));
+
+  /* Keep the memory past heap_fresh zero */
+  if ((char *)bp + DSIZE > heap_fresh) {
+    PUT(bp, 0);
+    PUT(bp + WSIZE, 0);
+  }
 }
 
 /*
@@ -328,3 +646,403 @@ static void *find_list(size_t size) {
   offset = bit12 * 4 + bit10 * 3 + bit8 * 2 + bit6 * 1;
   return heap_listp + offset * DSIZE;
 }
+
+/*
+ * shrink_block - Cut an allocated block down to size bytes, and release the
+ *     tail as a free block if it is large enough to hold one.
+ */
+static void shrink_block(void *bp, size_t size) {
+  size_t capacity = GET_SIZE(HDRP(bp));
+
+  if ((capacity - size) >= MIN_BLKSIZE) {
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)), 1));
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(capacity - size, 1, 0));
+    PUT(FTRP(NEXT_BLKP(bp)), PACK(capacity - size, 1, 0));
+    coalesce(NEXT_BLKP(bp));
+  } else {
+    SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+  }
+  heap_fresh = MAX(heap_fresh, NEXT_BLKP(bp));
+}
+
+/*
+ * realloc_in_place - Try to grow the allocated block bp to at least size
+ *     bytes (preferably gsize bytes) without a free list search. The block
+ *     absorbs a free successor, extends the heap if it is the last block, or
+ *     slides down into a free predecessor. Return NULL if none applies.
+ */
+static void *realloc_in_place(void *bp, size_t size, size_t gsize) {
+  size_t capacity = GET_SIZE(HDRP(bp));
+  size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+  size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
+  size_t next_size = GET_SIZE(HDRP(NEXT_BLKP(bp)));
+  size_t avail = capacity + (next_alloc ? 0 : next_size);
+  void *newbp;
+
+  /* The block (plus a free successor) ends at the epilogue: grow the heap */
+  if (avail < size &&
+      GET_SIZE(HDRP(next_alloc ? NEXT_BLKP(bp) : NEXT_BLKP(NEXT_BLKP(bp)))) ==
+          0) {
+    if (extend_heap((gsize - avail) / WSIZE) == NULL) {
+      return NULL;
+    }
+    next_size = GET_SIZE(HDRP(NEXT_BLKP(bp)));
+    next_alloc = 0;
+    avail = capacity + next_size;
+  }
+
+  /* Absorb the free successor */
+  if (!next_alloc && avail >= size && avail <= MAX_BLKSIZE) {
+    remove_free_block(NEXT_BLKP(bp));
+    PUT(HDRP(bp), PACK(avail, prev_alloc, 1));
+    shrink_block(bp, MIN(avail, gsize));
+    return bp;
+  }
+
+  /* Slide the payload down into the free predecessor */
+  if (!prev_alloc) {
+    newbp = PREV_BLKP(bp);
+    avail += GET_SIZE(HDRP(newbp));
+    if (avail >= size && avail <= MAX_BLKSIZE) {
+      remove_free_block(newbp);
+      if (!next_alloc) {
+        remove_free_block(NEXT_BLKP(bp));
+      }
+      memmove(newbp, bp, capacity - WSIZE);
+      PUT(HDRP(newbp), PACK(avail, GET_PREV_ALLOC(HDRP(newbp)), 1));
+      shrink_block(newbp, MIN(avail, gsize));
+      return newbp;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * aligned_gap - Compute how far the payload of free block bp must move to be
+ *     aligned to align bytes, leaving room for a free block in front of it.
+ */
+static size_t aligned_gap(void *bp, size_t align) {
+  size_t gap = (align - (uintptr_t)bp % align) % align;
+
+  while (gap != 0 && gap < MIN_BLKSIZE) {
+    gap += align;
+  }
+  return gap;
+}
+
+/*
+ * find_aligned_fit - Find a free block which can accommodate size bytes with
+ *     its payload aligned to align bytes.
+ */
+static void *find_aligned_fit(size_t size, size_t align) {
+  void *list_header;
+  void *bp;
+
+  for (list_header = find_list(size); list_header <= (heap_listp + 4 * DSIZE);
+       list_header += DSIZE) {
+    for (bp = NEXT_FREE_BLKP(list_header, heap_listp); bp != list_header;
+         bp = NEXT_FREE_BLKP(bp, heap_listp)) {
+      if (GET_SIZE(HDRP(bp)) >= size + aligned_gap(bp, align)) {
+        return bp;
+      }
+    }
+  }
+  return NULL;
+}
+
+/*
+ * place_aligned - Store data into the free block at its first aligned
+ *     payload address, releasing the gap in front as a free block.
+ */
+static void *place_aligned(void *bp, size_t size, size_t align) {
+  size_t capacity = GET_SIZE(HDRP(bp));
+  size_t gap = aligned_gap(bp, align);
+  char *abp = (char *)bp + gap;
+
+  if (gap == 0) {
+    place(bp, size);
+    return bp;
+  }
+
+  remove_free_block(bp);
+  PUT(HDRP(bp), PACK(gap, GET_PREV_ALLOC(HDRP(bp)), 0));
+  PUT(FTRP(bp), GET(HDRP(bp)));
+  PUT(HDRP(abp), PACK(capacity - gap, 0, 1));
+  shrink_block(abp, size);
+  add_free_block(bp);
+  return abp;
+}
+
+/*
+ * alloc_aligned - Allocate a block of size bytes whose payload is aligned to
+ *     align bytes, extending the heap by just enough if no free block fits.
+ */
+static void *alloc_aligned(size_t size, size_t align) {
+  char *bp;
+  char *brk;
+  char *start;
+  size_t extendsize;
+
+  if ((bp = find_aligned_fit(size, align)) == NULL) {
+    /* The new free block starts at the last block if that one is free, and
+     * coalesce can merge the two */
+    brk = (char *)mem_heap_hi() + 1;
+    start = GET_PREV_ALLOC(HDRP(brk)) ? brk : PREV_BLKP(brk);
+    extendsize = start + aligned_gap(start, align) + size - brk;
+    if (start != brk && (size_t)(brk - start) + extendsize > MAX_BLKSIZE) {
+      extendsize = aligned_gap(brk, align) + size;
+    }
+    if ((bp = extend_heap(extendsize / WSIZE)) == NULL) {
+      return NULL;
+    }
+  }
+  return place_aligned(bp, size, align);
+}
+
+/*
+ * trim_heap - Give the free block bp back to the system if it is the last
+ *     block of the heap and at least TRIM_THRESHOLD bytes long. Free blocks
+ *     that coalesce kept apart at MAX_BLKSIZE follow it down.
+ */
+static void trim_heap(void *bp) {
+  size_t size;
+
+  while (GET_SIZE(HDRP(NEXT_BLKP(bp))) == 0 &&
+         (size = GET_SIZE(HDRP(bp))) >= TRIM_THRESHOLD) {
+    remove_free_block(bp);
+    PUT(HDRP(bp),
+        PACK(0, GET_PREV_ALLOC(HDRP(bp)), 1)); /* New epilogue header */
+
+    /* mem_sbrk takes an int, so a block of over 2 GB goes back in steps */
+    while (size > INT_MAX) {
+      mem_sbrk(-INT_MAX);
+      size -= INT_MAX;
+    }
+    mem_sbrk(-(int)size);
+
+    if (GET_PREV_ALLOC(HDRP(bp))) {
+      return;
+    }
+    bp = PREV_BLKP(bp);
+  }
+}
+
+/*
+ * map_alloc - Allocate a block of size bytes in a mapping of its own, with
+ *     its payload aligned to align bytes (at least DSIZE). The header records
+ *     the mapping length and the mapped bit, and sits in the first page, so
+ *     the payload starts align bytes into the mapping, or one page in for a
+ *     larger alignment. That case maps align bytes more and unmaps the pages
+ *     on either side of the aligned part.
+ */
+static void *map_alloc(size_t size, size_t align) {
+  size_t page = mem_pagesize();
+  size_t off = MIN(align, page); /* Payload offset into the mapping */
+  size_t len = (off + size + page - 1) & ~(page - 1);
+  size_t extra = align > page ? align - page : 0;
+  char *mp;
+  char *start;
+
+  if ((mp = mem_map(len + extra)) == (void *)-1) {
+    return NULL;
+  }
+  start = mp;
+  if (extra != 0) {
+    start = (char *)(((uintptr_t)mp + off + align - 1) & ~(uintptr_t)(align - 1)) -
+            off;
+    if (start > mp) {
+      mem_unmap(mp, start - mp);
+    }
+    if (start + len < mp + len + extra) {
+      mem_unmap(start + len, mp + extra - start);
+    }
+  }
+  PUT(start + off - WSIZE, len | 0x4 | 0x1);
+  return start + off;
+}
+
+/*
+ * map_free - Release the mapping of block ptr.
+ */
+static void map_free(void *ptr) {
+  mem_unmap(MAP_START(ptr), GET_SIZE(HDRP(ptr)));
+}
+
+/*
+ * map_shrink - Unmap the whole pages past the first size bytes of block ptr.
+ */
+static void map_shrink(void *ptr, size_t size) {
+  char *start = MAP_START(ptr);
+  size_t len = GET_SIZE(HDRP(ptr));
+  size_t newlen = ((char *)ptr - start + size + mem_pagesize() - 1) &
+                  ~(mem_pagesize() - 1);
+
+  if (newlen < len) {
+    mem_unmap(start + newlen, len - newlen);
+    PUT(HDRP(ptr), newlen | 0x4 | 0x1);
+  }
+}
+
+/*
+ * is_slab - Determine whether ptr was handed out from a slab run.
+ */
+static int is_slab(void *ptr) {
+  size_t page = (SLAB_RUNP(ptr) - slab_base) / SLAB_PAGE;
+
+  return page < slab_map_pages && (slab_map[page / 8] >> (page % 8)) & 0x1;
+}
+
+/*
+ * slab_mark - Record in the page map whether the page of run rp holds a slab
+ *     run, growing the map when the heap has outgrown it.
+ */
+static int slab_mark(void *rp, int used) {
+  size_t page = ((char *)rp - slab_base) / SLAB_PAGE;
+  size_t pages;
+  char *map;
+
+  if (page >= slab_map_pages) {
+    pages = MAX(MAX(2 * slab_map_pages, page + 1), 8 * SLAB_MAP_MIN);
+    pages = (pages + 7) & ~(size_t)7; /* Whole bytes of the map */
+    if ((map = mm_malloc(pages / 8)) == NULL) {
+      return -1;
+    }
+    memset(map, 0, pages / 8);
+    if (slab_map != NULL) {
+      memcpy(map, slab_map, slab_map_pages / 8);
+      mm_free(slab_map);
+    }
+    slab_map = map;
+    slab_map_pages = pages;
+  }
+
+  if (used) {
+    slab_map[page / 8] |= 1 << (page % 8);
+  } else {
+    slab_map[page / 8] &= ~(1 << (page % 8));
+  }
+  return 0;
+}
+
+/*
+ * slab_count - Count a small request of size class cls, halving the counts
+ *     of every class once SLAB_WINDOW requests have been counted.
+ */
+static void slab_count(int cls) {
+  int i;
+
+  PUT(SLAB_HITS(cls), GET(SLAB_HITS(cls)) + 1);
+  PUT(SLAB_TOTAL, GET(SLAB_TOTAL) + 1);
+  if (GET(SLAB_TOTAL) >= SLAB_WINDOW) {
+    for (i = 0; i < SLAB_CLASSES; i++) {
+      PUT(SLAB_HITS(i), GET(SLAB_HITS(i)) / 2);
+    }
+    PUT(SLAB_TOTAL, GET(SLAB_TOTAL) / 2);
+  }
+}
+
+/*
+ * slab_wanted - Determine whether size class cls deserves a run of its
+ *     own: always in a large heap, else if it is in demand.
+ */
+static int slab_wanted(int cls) {
+  return mem_heapsize() >= SLAB_MIN_HEAP ||
+         (GET(SLAB_HITS(cls)) >= SLAB_WARMUP &&
+          GET(SLAB_HITS(cls)) * SLAB_SHARE >= GET(SLAB_TOTAL));
+}
+
+/*
+ * slab_alloc - Take a slot from the first partial run of the size class,
+ *     starting a new run if the class has none.
+ */
+static void *slab_alloc(size_t size) {
+  int cls = ALIGN(size) / ALIGNMENT - 1;
+  char *rp;
+  char *ptr;
+
+  if (GET(SLAB_LIST(cls)) != 0) {
+    rp = GET_ADDRESS(GET(SLAB_LIST(cls)), heap_listp);
+  } else {
+    if ((rp = alloc_aligned(SLAB_PAGE, SLAB_PAGE)) == NULL) {
+      return NULL;
+    }
+    if (slab_mark(rp, 1) < 0) {
+      mm_free(rp);
+      return NULL;
+    }
+    PUT(SLAB_SLOT(rp), (cls + 1) * ALIGNMENT);
+    PUT(SLAB_USED(rp), 0);
+    PUT(SLAB_FREE(rp), 0);
+    PUT(SLAB_BUMP(rp), SLAB_HDRSIZE);
+    slab_link(rp, cls);
+  }
+
+  if (GET(SLAB_FREE(rp)) != 0) { /* Reuse a freed slot */
+    ptr = rp + GET(SLAB_FREE(rp));
+    PUT(SLAB_FREE(rp), GET(ptr));
+  } else { /* Carve an untouched slot */
+    ptr = rp + GET(SLAB_BUMP(rp));
+    PUT(SLAB_BUMP(rp), GET(SLAB_BUMP(rp)) + GET(SLAB_SLOT(rp)));
+  }
+  PUT(SLAB_USED(rp), GET(SLAB_USED(rp)) + 1);
+
+  if (SLAB_FULL(rp)) {
+    slab_unlink(rp, cls);
+  }
+  return ptr;
+}
+
+/*
+ * slab_free - Return a slot to its run. An empty run goes back to the heap
+ *     unless it is the only partial run of a class that still wants one.
+ */
+static void slab_free(void *ptr) {
+  char *rp = SLAB_RUNP(ptr);
+  int cls = GET(SLAB_SLOT(rp)) / ALIGNMENT - 1;
+  int full = SLAB_FULL(rp);
+
+  PUT(ptr, GET(SLAB_FREE(rp)));
+  PUT(SLAB_FREE(rp), (char *)ptr - rp);
+  PUT(SLAB_USED(rp), GET(SLAB_USED(rp)) - 1);
+
+  if (full) {
+    slab_link(rp, cls);
+  } else if (GET(SLAB_USED(rp)) == 0 &&
+             (GET(SLAB_PREV(rp)) != 0 || GET(SLAB_NEXT(rp)) != 0 ||
+              !slab_wanted(cls))) {
+    slab_unlink(rp, cls);
+    slab_mark(rp, 0);
+    mm_free(rp);
+  }
+}
+
+/*
+ * slab_link - Push run rp onto the partial run list of its size class.
+ */
+static void slab_link(void *rp, int cls) {
+  unsigned int head = GET(SLAB_LIST(cls));
+
+  PUT(SLAB_PREV(rp), 0);
+  PUT(SLAB_NEXT(rp), head);
+  if (head != 0) {
+    PUT(SLAB_PREV(GET_ADDRESS(head, heap_listp)), GET_OFFSET(rp, heap_listp));
+  }
+  PUT(SLAB_LIST(cls), GET_OFFSET(rp, heap_listp));
+}
+
+/*
+ * slab_unlink - Remove run rp from the partial run list of its size class.
+ */
+static void slab_unlink(void *rp, int cls) {
+  unsigned int prev = GET(SLAB_PREV(rp));
+  unsigned int next = GET(SLAB_NEXT(rp));
+
+  if (prev != 0) {
+    PUT(SLAB_NEXT(GET_ADDRESS(prev, heap_listp)), next);
+  } else {
+    PUT(SLAB_LIST(cls), next);
+  }
+  if (next != 0) {
+    PUT(SLAB_PREV(GET_ADDRESS(next, heap_listp)), prev);
+  }
+}
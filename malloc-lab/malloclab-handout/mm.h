@@ -5,6 +5,21 @@ extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
 
+/* Only mm.c provides these */
+extern void *mm_memalign(size_t align, size_t size);
+extern void *mm_calloc(size_t nmemb, size_t size);
+extern size_t mm_usable_size(void *ptr);
+
+/*
+ * mm_walk calls visit for every block of the heap in address order,
+ * with its size, the bytes of it taken by headers and footers, whether
+ * it is allocated and, for a free block, the index of the free list
+ * that holds it (-1 if the allocator keeps no separate lists).
+ */
+typedef void (*mm_visit_t)(void *bp, size_t size, size_t meta, int alloc,
+			   int list);
+extern void mm_walk(mm_visit_t visit);
+
 
 /* 
  * Students work in teams of one or two.  Teams enter their team name, 
@@ -0,0 +1,331 @@
+/*
+ * mmbench.c - Run every registered malloc package over the same traces
+ *     and compare them in one table
+ *
+ * Usage: mmbench [-hv] [-a <name>] [-f <file>] [-t <dir>]
+ *
+ * For each package in allocators.c and each trace, mmbench measures
+ * the space utilization (peak payload over peak footprint, as mdriver
+ * does), the throughput (timed with fsecs, as mdriver does) and the
+ * latency of single calls (with lprof.c). It only checks that every
+ * call succeeds and returns an aligned block; use mdriver to check a
+ * package for correctness. Traces with memalign requests are skipped,
+ * and reported as unsupported, for packages without memalign.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "allocator.h"
+#include "memlib.h"
+#include "fsecs.h"
+#include "lprof.h"
+#include "trace.h"
+#include "config.h"
+
+#define MAXLINE 1024    /* max string size */
+
+/* Input to run_speed, which is timed by fsecs */
+typedef struct {
+    allocator_t *a;
+    trace_t *trace;
+} speed_t;
+
+/* Results of one package over all traces */
+typedef struct {
+    int valid;          /* number of traces run without errors */
+    int unsupported;    /* number of traces the package cannot run */
+    double util;        /* sum of the utilization over those traces */
+    double ops, secs;   /* total ops and seconds over those traces */
+    double p50, p99, max; /* latency of single calls in ns */
+} result_t;
+
+int verbose = 0;        /* also read by fsecs.c */
+static char tracedir[MAXLINE] = TRACEDIR;
+static char *default_tracefiles[] = {
+    DEFAULT_TRACEFILES, NULL
+};
+
+static double run_util(allocator_t *a, trace_t *trace);
+static void run_speed(void *ptr);
+static void run_latency(allocator_t *a, trace_t *trace);
+static int run_op(allocator_t *a, trace_t *trace, int i);
+static void usage(void);
+static void app_error(char *msg);
+
+int main(int argc, char **argv)
+{
+    char **tracefiles = default_tracefiles;
+    char *only = NULL;          /* run only this package (-a) */
+    trace_t **traces;
+    int num_tracefiles, num_allocators, i, j;
+    result_t *results, *r;
+    allocator_t *a;
+    speed_t speed_params;
+    double util, secs;
+    int c;
+
+    while ((c = getopt(argc, argv, "a:f:t:hv")) != EOF) {
+	switch (c) {
+	case 'a': /* Run only the named package */
+	    only = optarg;
+	    break;
+	case 'f': /* Use one specific trace file only (path as given) */
+	    if ((tracefiles = malloc(2 * sizeof(char *))) == NULL)
+		app_error("malloc failed in main");
+	    strcpy(tracedir, "");
+	    tracefiles[0] = optarg;
+	    tracefiles[1] = NULL;
+	    break;
+	case 't': /* Directory where the traces are located */
+	    if (tracefiles != default_tracefiles)
+		break;
+	    strncpy(tracedir, optarg, MAXLINE - 2);
+	    if (tracedir[strlen(tracedir)-1] != '/')
+		strcat(tracedir, "/");
+	    break;
+	case 'v': /* Print a row per package and trace */
+	    verbose = 1;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+
+    for (num_tracefiles = 0; tracefiles[num_tracefiles]; num_tracefiles++)
+	;
+    for (num_allocators = 0; allocators[num_allocators].name; num_allocators++)
+	;
+    if ((traces = malloc(num_tracefiles * sizeof(trace_t *))) == NULL ||
+	(results = calloc(num_allocators, sizeof(result_t))) == NULL)
+	app_error("malloc failed in main");
+    for (j = 0; j < num_tracefiles; j++)
+	traces[j] = read_trace(tracedir, tracefiles[j]);
+
+    mem_init();
+    init_fsecs();
+    lp_init(0);
+
+    if (verbose)
+	printf("%-12s%6s%6s%10s\n", "package", "trace", "util", "Kops");
+    for (i = 0; i < num_allocators; i++) {
+	a = &allocators[i];
+	r = &results[i];
+	if (only != NULL && strcmp(only, a->name) != 0)
+	    continue;
+	lp_reset();
+	for (j = 0; j < num_tracefiles; j++) {
+	    /* A package without memalign cannot run m requests */
+	    if (traces[j]->memalign && a->memalign == NULL) {
+		printf("%-12s%6d unsupported: the package has no memalign\n",
+		       a->name, j);
+		r->unsupported++;
+		continue;
+	    }
+	    if ((util = run_util(a, traces[j])) < 0) {
+		if (verbose)
+		    printf("%-12s%6d%6s%10s\n", a->name, j, "-", "-");
+		continue;
+	    }
+	    speed_params.a = a;
+	    speed_params.trace = traces[j];
+	    secs = fsecs(run_speed, &speed_params);
+	    run_latency(a, traces[j]);
+	    r->valid++;
+	    r->util += util;
+	    r->ops += traces[j]->num_ops;
+	    r->secs += secs;
+	    if (verbose && a->uses_memlib)
+		printf("%-12s%6d%5.0f%%%10.0f\n", a->name, j, util * 100,
+		       traces[j]->num_ops / 1e3 / secs);
+	    else if (verbose)
+		printf("%-12s%6d%6s%10.0f\n", a->name, j, "-",
+		       traces[j]->num_ops / 1e3 / secs);
+	}
+	r->p50 = lp_quantile(0.5);
+	r->p99 = lp_quantile(0.99);
+	r->max = lp_quantile(1.0);
+    }
+
+    /* Print the comparison table */
+    if (verbose)
+	printf("\n");
+    printf("%-12s%6s%6s%10s%8s%8s%10s\n", "package", "valid", "util", "Kops",
+	   "p50ns", "p99ns", "maxns");
+    for (i = 0; i < num_allocators; i++) {
+	a = &allocators[i];
+	r = &results[i];
+	if (only != NULL && strcmp(only, a->name) != 0)
+	    continue;
+	printf("%-12s%3d/%-2d", a->name, r->valid,
+	       num_tracefiles - r->unsupported);
+	if (r->valid != 0) {
+	    if (a->uses_memlib)
+		printf("%5.0f%%", r->util / r->valid * 100);
+	    else
+		printf("%6s", "-");
+	    printf("%10.0f%8.0f%8.0f%10.0f", r->ops / 1e3 / r->secs,
+		   r->p50, r->p99, r->max);
+	}
+	if (r->unsupported != 0)
+	    printf("  (%d unsupported)", r->unsupported);
+	printf("\n");
+    }
+
+    for (j = 0; j < num_tracefiles; j++)
+	free_trace(traces[j]);
+    exit(0);
+}
+
+/*
+ * run_util - Run the trace once and return the space utilization, 0
+ *     for a package outside memlib, or -1 if a call failed
+ */
+static double run_util(allocator_t *a, trace_t *trace)
+{
+    int i, total_size = 0, max_total_size = 0;
+    traceop_t *op;
+
+    mem_reset_brk();
+    if (a->init() < 0)
+	return -1;
+    for (i = 0; i < trace->num_ops; i++) {
+	op = &trace->ops[i];
+	if (op->type == FREE || op->type == REALLOC)
+	    total_size -= trace->block_sizes[op->index];
+	if (!run_op(a, trace, i)) {
+	    fprintf(stderr, "%s: request %d of a trace failed\n", a->name, i);
+	    return -1;
+	}
+	if (op->type != FREE) {
+	    trace->block_sizes[op->index] = op->size;
+	    total_size += op->size;
+	    if (total_size > max_total_size)
+		max_total_size = total_size;
+	}
+    }
+    if (!a->uses_memlib)
+	return 0;
+    return (double)max_total_size / mem_peaksize();
+}
+
+/*
+ * run_speed - Run the trace once; timed by fsecs
+ */
+static void run_speed(void *ptr)
+{
+    allocator_t *a = ((speed_t *)ptr)->a;
+    trace_t *trace = ((speed_t *)ptr)->trace;
+    int i;
+
+    mem_reset_brk();
+    if (a->init() < 0)
+	app_error("init failed in run_speed");
+    for (i = 0; i < trace->num_ops; i++)
+	if (!run_op(a, trace, i))
+	    app_error("request failed in run_speed");
+}
+
+/*
+ * run_latency - Run the trace once, timing every call with lprof.c
+ */
+static void run_latency(allocator_t *a, trace_t *trace)
+{
+    int i, size;
+
+    mem_reset_brk();
+    if (a->init() < 0)
+	app_error("init failed in run_latency");
+    for (i = 0; i < trace->num_ops; i++) {
+	size = trace->ops[i].size;
+	lp_start();
+	if (!run_op(a, trace, i))
+	    app_error("request failed in run_latency");
+	switch (trace->ops[i].type) {
+	case ALLOC:
+	    lp_stop(LP_MALLOC, size);
+	    break;
+	case MEMALIGN:
+	    lp_stop(LP_MEMALIGN, size);
+	    break;
+	case CALLOC:
+	    lp_stop(LP_CALLOC, size);
+	    break;
+	case REALLOC:
+	    lp_stop(LP_REALLOC, size);
+	    break;
+	case FREE:
+	    lp_stop(LP_FREE, 0);
+	    break;
+	}
+    }
+}
+
+/*
+ * run_op - Carry out request i of the trace with package a; return 0
+ *     if it failed or returned a misaligned block. A package without
+ *     calloc zeroes a malloc'd block instead; main does not run traces
+ *     with memalign requests on a package without memalign.
+ */
+static int run_op(allocator_t *a, trace_t *trace, int i)
+{
+    traceop_t *op = &trace->ops[i];
+    char *p;
+
+    switch (op->type) {
+    case ALLOC:
+	p = a->malloc(op->size);
+	break;
+    case REALLOC:
+	p = a->realloc(trace->blocks[op->index], op->size);
+	break;
+    case MEMALIGN:
+	if ((p = a->memalign(op->align, op->size)) == NULL ||
+	    (size_t)p % op->align != 0)
+	    return 0;
+	break;
+    case CALLOC:
+	if (a->calloc != NULL)
+	    p = a->calloc(1, op->size);
+	else if ((p = a->malloc(op->size)) != NULL)
+	    memset(p, 0, op->size);
+	break;
+    default:
+	a->free(trace->blocks[op->index]);
+	return 1;
+    }
+    if (p == NULL || (size_t)p % ALIGNMENT != 0)
+	return 0;
+    trace->blocks[op->index] = p;
+    return 1;
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mmbench [-hv] [-a <name>] [-f <file>] "
+	    "[-t <dir>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-a <name>  Run only the named package.\n");
+    fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+    fprintf(stderr, "\t-v         Print a row per package and trace.\n");
+}
+
+/*
+ * app_error - Report an error and exit
+ */
+static void app_error(char *msg)
+{
+    fprintf(stderr, "%s\n", msg);
+    exit(1);
+}
@@ -0,0 +1,522 @@
+/*
+ * mtrace.c - LD_PRELOAD shim that records the malloc, calloc, realloc,
+ *     posix_memalign/aligned_alloc/memalign and free calls of a running
+ *     program as an mdriver trace file.
+ *
+ * Usage:
+ *     unix> LD_PRELOAD=./mtrace.so MTRACE_FILE=out.rep <program> ...
+ *     unix> mdriver -V -f out.rep
+ *
+ * While the program runs, every call is appended as a raw record to
+ * an mmap'd log, so that recording never calls back into malloc. At
+ * exit the log is turned into the .rep format: every pointer gets a
+ * block id, and the id of a freed block is reused by the next
+ * allocation (index compaction), so the number of ids equals the peak
+ * number of live blocks rather than the number of allocations. Blocks
+ * that are still live at exit are freed at the end of the trace.
+ *
+ * MTRACE_FILE names the output; a "%d" in it is replaced by the pid.
+ * The default is "mtrace-%d.rep". Zero-byte requests, and frees of
+ * pointers that were not allocated while recording, are dropped. The
+ * alignment of aligned_alloc and memalign is logged as the power of two
+ * they round it up to, not as the caller passed it.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#define MAXLINE   1024      /* max string size */
+#define BOOTSIZE  (1 << 12) /* bytes served to dlsym before we are set up */
+#define BOOTHDR   16        /* bootbuf header holding the block's size */
+#define LOGCHUNK  (1 << 20) /* initial size of the raw log in records */
+
+/* One raw call, as seen by the shim */
+typedef struct {
+    enum {ALLOC, FREE, REALLOC, MEMALIGN, CALLOC} type;
+    void *ptr;              /* block returned by malloc/realloc, or freed */
+    void *oldptr;           /* block passed to realloc */
+    size_t size;            /* requested size */
+    size_t align;           /* requested alignment (MEMALIGN) */
+} logrec_t;
+
+/* Maps a live block pointer to its trace id (open addressing) */
+typedef struct {
+    void *ptr;              /* NULL marks an empty slot */
+    int id;                 /* trace id of the block */
+    size_t size;            /* payload size of the block */
+} slot_t;
+
+/* The real allocator */
+static void *(*real_malloc)(size_t);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static int (*real_posix_memalign)(void **, size_t, size_t);
+static void *(*real_aligned_alloc)(size_t, size_t);
+static void *(*real_memalign)(size_t, size_t);
+static void (*real_free)(void *);
+
+/* Bump storage handed to dlsym while the real allocator is unknown.
+   It is never reused, so what has not been handed out is still zero */
+static char bootbuf[BOOTSIZE] __attribute__((aligned(16)));
+static size_t bootused = 0;
+
+/* The raw log */
+static logrec_t *log_recs = NULL;
+static size_t log_len = 0;
+static size_t log_cap = 0;
+static int recording = 0;
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int in_hook = 0;
+
+/* State used while writing the trace */
+static slot_t *table = NULL;
+static size_t table_cap = 0;
+static size_t table_len = 0;
+static int *free_ids = NULL;
+static int num_free_ids = 0;
+static int free_ids_cap = 0;
+static int num_ids = 0;
+
+static void *boot_alloc(size_t size);
+static void log_call(int type, void *ptr, void *oldptr, size_t size,
+		     size_t align);
+static void log_append(int type, void *ptr, void *oldptr, size_t size,
+		       size_t align);
+static size_t honoured_align(size_t align);
+static void write_trace(void);
+static slot_t *table_find(void *ptr);
+static void table_put(void *ptr, int id, size_t size);
+static void table_remove(void *ptr);
+static int new_id(void);
+
+/*
+ * mtrace_init - look up the real allocator and map the raw log
+ */
+__attribute__((constructor))
+static void mtrace_init(void)
+{
+    real_malloc = dlsym(RTLD_NEXT, "malloc");
+    real_calloc = dlsym(RTLD_NEXT, "calloc");
+    real_realloc = dlsym(RTLD_NEXT, "realloc");
+    real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+    real_aligned_alloc = dlsym(RTLD_NEXT, "aligned_alloc");
+    real_memalign = dlsym(RTLD_NEXT, "memalign");
+    real_free = dlsym(RTLD_NEXT, "free");
+
+    log_cap = LOGCHUNK;
+    log_recs = mmap(NULL, log_cap * sizeof(logrec_t), PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (log_recs == MAP_FAILED) {
+	fprintf(stderr, "mtrace: could not map the log, not recording\n");
+	return;
+    }
+    recording = 1;
+}
+
+/*
+ * mtrace_fini - turn the raw log into a trace file
+ */
+__attribute__((destructor))
+static void mtrace_fini(void)
+{
+    if (!recording)
+	return;
+    pthread_mutex_lock(&log_lock);
+    recording = 0;
+    pthread_mutex_unlock(&log_lock);
+    in_hook = 1;
+    write_trace();
+    munmap(log_recs, log_cap * sizeof(logrec_t));
+}
+
+/*****************************************
+ * The wrappers around the real allocator
+ ****************************************/
+
+void *malloc(size_t size)
+{
+    void *p;
+
+    if (real_malloc == NULL) /* called by dlsym during mtrace_init */
+	return boot_alloc(size);
+    p = real_malloc(size);
+    log_call(ALLOC, p, NULL, size, 0);
+    return p;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (real_calloc == NULL) { /* bootbuf is static, hence already zeroed */
+	if (size != 0 && nmemb > SIZE_MAX / size) {
+	    errno = ENOMEM;
+	    return NULL;
+	}
+	return boot_alloc(nmemb * size);
+    }
+    p = real_calloc(nmemb, size);
+    log_call(CALLOC, p, NULL, nmemb * size, 0);
+    return p;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    size_t oldsize;
+    void *p;
+
+    if (ptr == NULL)
+	return malloc(size);
+    if ((char *)ptr >= bootbuf && (char *)ptr < bootbuf + BOOTSIZE) {
+	oldsize = *(size_t *)((char *)ptr - BOOTHDR);
+	if ((p = malloc(size)) != NULL)
+	    memcpy(p, ptr, oldsize < size ? oldsize : size);
+	return p;
+    }
+    if (!recording || in_hook)
+	return real_realloc(ptr, size);
+
+    /* Log the call before another thread can get ptr back from malloc
+       and log it first, as free does by logging before real_free */
+    in_hook = 1;
+    pthread_mutex_lock(&log_lock);
+    p = real_realloc(ptr, size);
+    if (size == 0)
+	log_append(FREE, ptr, NULL, 0, 0);
+    else if (p != NULL)
+	log_append(REALLOC, p, ptr, size, 0);
+    pthread_mutex_unlock(&log_lock);
+    in_hook = 0;
+    return p;
+}
+
+int posix_memalign(void **memptr, size_t align, size_t size)
+{
+    int err;
+
+    if (real_posix_memalign == NULL)
+	return ENOMEM;
+    if ((err = real_posix_memalign(memptr, align, size)) == 0)
+	log_call(MEMALIGN, *memptr, NULL, size, align);
+    return err;
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+    void *p;
+
+    if (real_aligned_alloc == NULL)
+	return NULL;
+    p = real_aligned_alloc(align, size);
+    log_call(MEMALIGN, p, NULL, size, honoured_align(align));
+    return p;
+}
+
+void *memalign(size_t align, size_t size)
+{
+    void *p;
+
+    if (real_memalign == NULL)
+	return NULL;
+    p = real_memalign(align, size);
+    log_call(MEMALIGN, p, NULL, size, honoured_align(align));
+    return p;
+}
+
+void free(void *ptr)
+{
+    if (ptr == NULL ||
+	((char *)ptr >= bootbuf && (char *)ptr < bootbuf + BOOTSIZE))
+	return;
+    log_call(FREE, ptr, NULL, 0, 0);
+    real_free(ptr);
+}
+
+/*
+ * boot_alloc - hand out size bytes of bootbuf, behind a header that
+ *     holds size for realloc
+ */
+static void *boot_alloc(size_t size)
+{
+    size_t total;
+
+    if (size > BOOTSIZE)
+	return NULL;
+    total = BOOTHDR + ((size + 15) & ~(size_t)15);
+    if (bootused + total > BOOTSIZE)
+	return NULL;
+    *(size_t *)(bootbuf + bootused) = size;
+    bootused += total;
+    return bootbuf + bootused - total + BOOTHDR;
+}
+
+/*
+ * honoured_align - the alignment that aligned_alloc and memalign give
+ *     for align: a power of two of at least sizeof(void *)
+ */
+static size_t honoured_align(size_t align)
+{
+    size_t a = sizeof(void *);
+
+    while (a < align)
+	a <<= 1;
+    return a;
+}
+
+/*
+ * log_call - append one call to the raw log
+ */
+static void log_call(int type, void *ptr, void *oldptr, size_t size,
+		     size_t align)
+{
+    if (!recording || in_hook || ptr == NULL)
+	return;
+    in_hook = 1;
+    pthread_mutex_lock(&log_lock);
+    log_append(type, ptr, oldptr, size, align);
+    pthread_mutex_unlock(&log_lock);
+    in_hook = 0;
+}
+
+/*
+ * log_append - append one call to the raw log, growing it with mremap;
+ *     the caller holds log_lock
+ */
+static void log_append(int type, void *ptr, void *oldptr, size_t size,
+		       size_t align)
+{
+    logrec_t *recs;
+
+    if (recording && log_len == log_cap) {
+	recs = mremap(log_recs, log_cap * sizeof(logrec_t),
+		      2 * log_cap * sizeof(logrec_t), MREMAP_MAYMOVE);
+	if (recs == MAP_FAILED) {
+	    fprintf(stderr, "mtrace: log is full, recording stopped\n");
+	    recording = 0;
+	} else {
+	    log_recs = recs;
+	    log_cap *= 2;
+	}
+    }
+    if (recording) {
+	log_recs[log_len].type = type;
+	log_recs[log_len].ptr = ptr;
+	log_recs[log_len].oldptr = oldptr;
+	log_recs[log_len].size = size;
+	log_recs[log_len].align = align;
+	log_len++;
+    }
+}
+
+/**************************************
+ * Conversion of the raw log to a trace
+ *************************************/
+
+/*
+ * write_trace - assign compacted ids to the logged blocks and write the
+ *     trace file. Runs with recording off, so it may use the allocator.
+ */
+static void write_trace(void)
+{
+    char pattern[MAXLINE], path[MAXLINE], *name;
+    char *ops;           /* the body of the trace, built in memory */
+    size_t ops_len = 0, ops_cap = LOGCHUNK;
+    int num_ops = 0;
+    size_t i, live_bytes = 0, max_live_bytes = 0;
+    slot_t *slot;
+    int id;
+    FILE *fp;
+
+    if ((name = getenv("MTRACE_FILE")) == NULL)
+	name = "mtrace-%d.rep";
+    strncpy(pattern, name, MAXLINE - 1);
+    pattern[MAXLINE - 1] = '\0';
+    snprintf(path, MAXLINE, pattern, (int)getpid());
+
+    if ((ops = malloc(ops_cap)) == NULL) {
+	fprintf(stderr, "mtrace: out of memory while writing %s\n", path);
+	return;
+    }
+
+#define EMIT(...) do {							\
+	if (ops_cap - ops_len < MAXLINE) {				\
+	    ops_cap *= 2;						\
+	    if ((ops = realloc(ops, ops_cap)) == NULL) {		\
+		fprintf(stderr, "mtrace: out of memory\n");		\
+		return;							\
+	    }								\
+	}								\
+	ops_len += sprintf(ops + ops_len, __VA_ARGS__);			\
+	num_ops++;							\
+    } while (0)
+
+    for (i = 0; i < log_len; i++) {
+	logrec_t *r = &log_recs[i];
+
+	switch (r->type) {
+	case ALLOC:
+	case MEMALIGN:
+	case CALLOC:
+	    if (r->size == 0)
+		break;
+	    id = new_id();
+	    table_put(r->ptr, id, r->size);
+	    if (r->type == MEMALIGN)
+		EMIT("m %d %lu %lu\n", id, (unsigned long)r->align,
+		     (unsigned long)r->size);
+	    else
+		EMIT("%c %d %lu\n", r->type == CALLOC ? 'c' : 'a', id,
+		     (unsigned long)r->size);
+	    live_bytes += r->size;
+	    break;
+
+	case REALLOC:
+	    if ((slot = table_find(r->oldptr)) == NULL) { /* not ours */
+		id = new_id();
+		EMIT("a %d %lu\n", id, (unsigned long)r->size);
+	    } else {
+		id = slot->id;
+		live_bytes -= slot->size;
+		table_remove(r->oldptr);
+		EMIT("r %d %lu\n", id, (unsigned long)r->size);
+	    }
+	    table_put(r->ptr, id, r->size);
+	    live_bytes += r->size;
+	    break;
+
+	case FREE:
+	    if ((slot = table_find(r->ptr)) == NULL)
+		break;
+	    id = slot->id;
+	    live_bytes -= slot->size;
+	    table_remove(r->ptr);
+	    free_ids[num_free_ids++] = id;
+	    EMIT("f %d\n", id);
+	    break;
+	}
+	max_live_bytes = (live_bytes > max_live_bytes) ?
+	    live_bytes : max_live_bytes;
+    }
+
+    /* Balance the trace by freeing whatever is still live */
+    for (i = 0; i < table_cap; i++)
+	if (table[i].ptr != NULL)
+	    EMIT("f %d\n", table[i].id);
+#undef EMIT
+
+    if ((fp = fopen(path, "w")) == NULL) {
+	fprintf(stderr, "mtrace: could not open %s\n", path);
+	return;
+    }
+    fprintf(fp, "%lu\n%d\n%d\n%d\n", (unsigned long)max_live_bytes,
+	    num_ids, num_ops, 1);
+    fwrite(ops, 1, ops_len, fp);
+    fclose(fp);
+    free(ops);
+    free(table);
+    free(free_ids);
+}
+
+/*
+ * new_id - reuse the most recently freed id, or hand out a fresh one
+ */
+static int new_id(void)
+{
+    int *ids;
+
+    if (num_free_ids > 0)
+	return free_ids[--num_free_ids];
+    if (num_ids == free_ids_cap) { /* every id may be freed at once */
+	free_ids_cap = (free_ids_cap == 0) ? 1024 : 2 * free_ids_cap;
+	if ((ids = realloc(free_ids, free_ids_cap * sizeof(int))) == NULL) {
+	    fprintf(stderr, "mtrace: out of memory\n");
+	    exit(1);
+	}
+	free_ids = ids;
+    }
+    return num_ids++;
+}
+
+/* Hash a pointer into a table of table_cap slots */
+#define HASH(p) ((((unsigned long)(p) >> 4) * 2654435761UL) & (table_cap - 1))
+
+/*
+ * table_find - return the slot of block ptr, or NULL if it is unknown
+ */
+static slot_t *table_find(void *ptr)
+{
+    size_t i;
+
+    if (table_cap == 0)
+	return NULL;
+    for (i = HASH(ptr); table[i].ptr != NULL; i = (i + 1) & (table_cap - 1))
+	if (table[i].ptr == ptr)
+	    return &table[i];
+    return NULL;
+}
+
+/*
+ * table_put - remember that block ptr of size bytes has the given id,
+ *     doubling the table when it becomes half full
+ */
+static void table_put(void *ptr, int id, size_t size)
+{
+    slot_t *old = table;
+    size_t old_cap = table_cap;
+    size_t i;
+
+    if (2 * (table_len + 1) > table_cap) {
+	table_cap = (table_cap == 0) ? 1024 : 2 * table_cap;
+	if ((table = calloc(table_cap, sizeof(slot_t))) == NULL) {
+	    fprintf(stderr, "mtrace: out of memory\n");
+	    exit(1);
+	}
+	table_len = 0;
+	for (i = 0; i < old_cap; i++)
+	    if (old[i].ptr != NULL)
+		table_put(old[i].ptr, old[i].id, old[i].size);
+	free(old);
+    }
+    for (i = HASH(ptr); table[i].ptr != NULL; i = (i + 1) & (table_cap - 1))
+	if (table[i].ptr == ptr)
+	    break;
+    if (table[i].ptr == NULL)
+	table_len++;
+    table[i].ptr = ptr;
+    table[i].id = id;
+    table[i].size = size;
+}
+
+/*
+ * table_remove - forget block ptr, shifting back the entries that
+ *     probed past its slot
+ */
+static void table_remove(void *ptr)
+{
+    size_t i, j, home;
+
+    for (i = HASH(ptr); table[i].ptr != ptr; i = (i + 1) & (table_cap - 1))
+	if (table[i].ptr == NULL)
+	    return;
+    table[i].ptr = NULL;
+    table_len--;
+
+    for (j = (i + 1) & (table_cap - 1); table[j].ptr != NULL;
+	 j = (j + 1) & (table_cap - 1)) {
+	home = HASH(table[j].ptr);
+	/* move entry j into the hole at i unless its home lies in (i, j] */
+	if (((j > i) && (home <= i || home > j)) ||
+	    ((j < i) && (home <= i && home > j))) {
+	    table[i] = table[j];
+	    table[j].ptr = NULL;
+	    i = j;
+	}
+    }
+}
@@ -0,0 +1,133 @@
+/*
+ * trace.c - Read the trace files that mdriver and mmbench replay
+ *
+ * A trace starts with four numbers: the suggested heap size, the number
+ * of block ids, the number of requests and a weight (the first and the
+ * last are unused). Then come the requests, one per line:
+ *
+ *   a <id> <size>            malloc
+ *   r <id> <size>            realloc block id
+ *   f <id>                   free block id
+ *   m <id> <align> <size>    memalign
+ *   c <id> <size>            calloc
+ *
+ * mtrace.so logs the alignment that memalign actually honours, but a
+ * trace from elsewhere may hold any number there. The reader rejects an
+ * alignment of 0 and rounds any other up to a power of two of at least
+ * ALIGNMENT, before mdriver, mmbench or posix_memalign see it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trace.h"
+#include "config.h"
+
+#define MAXLINE   1024      /* max string size */
+#define MAX_ALIGN (1 << 30) /* largest alignment of an m request */
+
+extern int verbose;         /* defined by mdriver.c and mmbench.c */
+
+static void trace_error(char *path, char *msg);
+
+/*
+ * read_trace - read a trace file and store it in memory
+ */
+trace_t *read_trace(char *tracedir, char *filename)
+{
+    FILE *tracefile;
+    trace_t *trace;
+    traceop_t *op;
+    char type[MAXLINE];
+    char path[MAXLINE];
+    unsigned align, a;
+    int i, n;
+
+    if (verbose > 1)
+	printf("Reading tracefile: %s\n", filename);
+
+    /* Read the trace file header */
+    snprintf(path, MAXLINE, "%s%s", tracedir, filename);
+    if ((tracefile = fopen(path, "r")) == NULL)
+	trace_error(path, "could not open the trace");
+    if ((trace = (trace_t *)malloc(sizeof(trace_t))) == NULL)
+	trace_error(path, "malloc failed");
+    if (fscanf(tracefile, "%d %d %d %d", &trace->sugg_heapsize,
+	       &trace->num_ids, &trace->num_ops, &trace->weight) != 4 ||
+	trace->num_ids < 0 || trace->num_ops < 0)
+	trace_error(path, "bad trace header");
+
+    /* The requests, and for each block id its pointer and payload size */
+    if ((trace->ops = malloc(trace->num_ops * sizeof(traceop_t))) == NULL ||
+	(trace->blocks = malloc(trace->num_ids * sizeof(char *))) == NULL ||
+	(trace->block_sizes = malloc(trace->num_ids * sizeof(size_t))) == NULL)
+	trace_error(path, "malloc failed");
+    trace->memalign = 0;
+
+    /* Read every request line in the trace file */
+    for (i = 0; i < trace->num_ops; i++) {
+	op = &trace->ops[i];
+	if (fscanf(tracefile, "%s", type) != 1)
+	    trace_error(path, "the trace is shorter than its header says");
+	switch (type[0]) {
+	case 'a':
+	    op->type = ALLOC;
+	    n = fscanf(tracefile, "%d %d", &op->index, &op->size) - 2;
+	    break;
+	case 'r':
+	    op->type = REALLOC;
+	    n = fscanf(tracefile, "%d %d", &op->index, &op->size) - 2;
+	    break;
+	case 'f':
+	    op->type = FREE;
+	    op->size = 0;
+	    n = fscanf(tracefile, "%d", &op->index) - 1;
+	    break;
+	case 'm':
+	    op->type = MEMALIGN;
+	    trace->memalign = 1;
+	    n = fscanf(tracefile, "%d %u %d", &op->index, &align,
+		       &op->size) - 3;
+	    if (align == 0 || align > MAX_ALIGN)
+		trace_error(path, "bad alignment in an m request");
+	    for (a = ALIGNMENT; a < align; a <<= 1)
+		;
+	    op->align = a;
+	    break;
+	case 'c':
+	    op->type = CALLOC;
+	    n = fscanf(tracefile, "%d %d", &op->index, &op->size) - 2;
+	    break;
+	default:
+	    fprintf(stderr, "Bogus type character (%c) in tracefile %s\n",
+		    type[0], path);
+	    exit(1);
+	}
+	if (n != 0 || op->size < 0)
+	    trace_error(path, "bad request line");
+	if (op->index < 0 || op->index >= trace->num_ids)
+	    trace_error(path, "block id out of range");
+    }
+    fclose(tracefile);
+    return trace;
+}
+
+/*
+ * free_trace - Free the trace record and the three arrays it points
+ *              to, all of which were allocated in read_trace().
+ */
+void free_trace(trace_t *trace)
+{
+    free(trace->ops);         /* free the three arrays... */
+    free(trace->blocks);
+    free(trace->block_sizes);
+    free(trace);              /* and the trace record itself... */
+}
+
+/*
+ * trace_error - Report a bad trace file and exit
+ */
+static void trace_error(char *path, char *msg)
+{
+    fprintf(stderr, "ERROR: %s: %s in read_trace\n", path, msg);
+    exit(1);
+}
@@ -0,0 +1,32 @@
+/*
+ * trace.h - the trace file format, and the reader in trace.c that both
+ *     mdriver and mmbench use
+ */
+#include <stddef.h>
+
+/* One trace request */
+typedef struct {
+    enum {ALLOC, FREE, REALLOC, MEMALIGN, CALLOC} type; /* type of request */
+    int index;                        /* index for free() to use later */
+    int size;                         /* byte size of alloc/realloc request */
+    int align;                        /* alignment of a memalign request */
+} traceop_t;
+
+/* One trace file */
+typedef struct {
+    int sugg_heapsize;   /* suggested heap size (unused) */
+    int num_ids;         /* number of alloc/realloc ids */
+    int num_ops;         /* number of distinct requests */
+    int weight;          /* weight for this trace (unused) */
+    int memalign;        /* does the trace have MEMALIGN requests? */
+    traceop_t *ops;      /* array of requests */
+    char **blocks;       /* array of ptrs returned by malloc/realloc... */
+    size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+} trace_t;
+
+/* read_trace - Read tracedir/filename into memory, or exit with an error
+   message if it is not a valid trace */
+trace_t *read_trace(char *tracedir, char *filename);
+
+/* free_trace - Free a trace returned by read_trace */
+void free_trace(trace_t *trace);
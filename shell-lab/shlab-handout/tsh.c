@@ -3,13 +3,17 @@
  *
  * <Put your name and login ID here>
  */
+#define _GNU_SOURCE /* for splice, tee and pipe2 */
 #include <bits/types/sigset_t.h>
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -17,7 +21,9 @@
 /* Misc manifest constants */
 #define MAXLINE 1024   /* max line size */
 #define MAXARGS 128    /* max args on a command line */
-#define MAXJOBS 16     /* max jobs at any point in time */
+#define MAXPIPE 16     /* max commands in a pipeline */
+#define TEECHUNK 65536 /* max bytes the built-in tee moves at once */
+#define MAXJOBS 16     /* initial size of the job table, which grows */
 #define MAXJID 1 << 16 /* max job ID */
 
 /* Job states */
@@ -40,16 +46,53 @@
 extern char **environ;   /* defined in libc */
 char prompt[] = "tsh> "; /* command line prompt (DO NOT CHANGE) */
 int verbose = 0;         /* if true, print additional output */
+int use_fork = 0;        /* if true, launch jobs with fork instead of spawn */
 int nextjid = 1;         /* next job ID to allocate */
 char sbuf[MAXLINE];      /* for composing sprintf messages */
 
+/* The operators of a command line. parseline returns these very strings
+ * for them, so that a quoted '|' is an argument and not an operator. */
+char op_pipe[] = "|", op_in[] = "<", op_out[] = ">", op_append[] = ">>";
+
+struct cmd_t {   /* One command of a pipeline */
+  char **argv;   /* arguments, ending with NULL */
+  char *infile;  /* file after <, or NULL */
+  char *outfile; /* file after > or >>, or NULL */
+  int append;    /* true for >> */
+};
+
 struct job_t {           /* The job struct */
-  pid_t pid;             /* job PID */
+  pid_t pid;             /* job PID, the process group of its pipeline */
   int jid;               /* job ID [1, 2, ...] */
   int state;             /* UNDEF, BG, FG, or ST */
+  int nprocs;            /* processes in the pipeline */
+  int nlive;             /* of which not yet reaped */
+  pid_t pids[MAXPIPE];   /* their PIDs, in order; 0 once reaped */
   char cmdline[MAXLINE]; /* command line */
 };
-struct job_t jobs[MAXJOBS]; /* The job list */
+
+/*
+ * The job list is a table of slots that doubles when it is full, with
+ * two open-addressing hash maps, so that the lookups done by the signal
+ * handlers take constant time however many jobs there are: one from the
+ * PID of every process of a job to its slot and place in the pipeline,
+ * one from JID to slot. The table only grows in addjob, which runs with
+ * the signals blocked, so the handlers never see it half copied.
+ */
+struct jobs_t {
+  struct job_t *slots; /* cap slots */
+  int cap;             /* number of slots */
+  int *free;           /* stack of free slots */
+  int nfree;           /* number of free slots */
+  int *pidmap;         /* PID -> slot * MAXPIPE + place + 1, 0 if empty */
+  int *jidmap;         /* JID -> slot + 1, 0 for an empty entry */
+  int pidcap;          /* entries in pidmap, a power of 2 >= 2 * procs */
+  int jidcap;          /* entries in jidmap, a power of 2 >= 2 * cap */
+  pid_t fg;            /* PID of the foreground job, or 0 */
+  int maxjid;          /* largest allocated job ID */
+};
+struct jobs_t joblist;          /* The job list */
+struct jobs_t *jobs = &joblist; /* Passed to the job list helpers */
 /* End global variables */
 
 /* Function prototypes */
@@ -57,8 +100,11 @@ struct job_t jobs[MAXJOBS]; /* The job list */
 /* Here are the functions that you will implement */
 void eval(char *cmdline);
 int builtin_cmd(char **argv);
+int isbuiltin(char *name);
 void do_bgfg(char **argv);
+int do_tee(char **argv);
 void waitfg(pid_t pid);
+pid_t launch(struct cmd_t *cmd, pid_t pgid, int in, int out, sigset_t *mask);
 
 void sigchld_handler(int sig);
 void sigtstp_handler(int sig);
@@ -66,18 +112,30 @@ void sigint_handler(int sig);
 
 /* Here are helper routines that we've provided for you */
 int parseline(const char *cmdline, char **argv);
+int parsepipe(char **argv, struct cmd_t *cmds);
+char *operator(char *word, int len);
+int isop(char *word);
+int openfile(char *name, int flags);
 void sigquit_handler(int sig);
 
 void clearjob(struct job_t *job);
-void initjobs(struct job_t *jobs);
-int maxjid(struct job_t *jobs);
-int addjob(struct job_t *jobs, pid_t pid, int state, char *cmdline);
-int deletejob(struct job_t *jobs, pid_t pid);
-pid_t fgpid(struct job_t *jobs);
-struct job_t *getjobpid(struct job_t *jobs, pid_t pid);
-struct job_t *getjobjid(struct job_t *jobs, int jid);
+void initjobs(struct jobs_t *jobs);
+int maxjid(struct jobs_t *jobs);
+int addjob(struct jobs_t *jobs, pid_t *pids, int n, int state,
+           char *cmdline);
+int deletejob(struct jobs_t *jobs, pid_t pid);
+int deleteproc(struct jobs_t *jobs, pid_t pid);
+void setjobstate(struct jobs_t *jobs, struct job_t *job, int state);
+pid_t fgpid(struct jobs_t *jobs);
+struct job_t *getjobpid(struct jobs_t *jobs, pid_t pid);
+struct job_t *getjobjid(struct jobs_t *jobs, int jid);
 int pid2jid(pid_t pid);
-void listjobs(struct job_t *jobs);
+void listjobs(struct jobs_t *jobs);
+
+int writeall(int fd, const char *buf, ssize_t n);
+int copyfd(int in, int fd);
+int movefd(int in, int out, ssize_t n);
+int isfifo(int fd);
 
 void usage(void);
 void unix_error(char *msg);
@@ -98,7 +156,7 @@ int main(int argc, char **argv) {
   dup2(1, 2);
 
   /* Parse the command line */
-  while ((c = getopt(argc, argv, "hvp")) != EOF) {
+  while ((c = getopt(argc, argv, "hvpf")) != EOF) {
     switch (c) {
     case 'h': /* print help message */
       usage();
@@ -109,6 +167,9 @@ int main(int argc, char **argv) {
     case 'p':          /* don't print a prompt */
       emit_prompt = 0; /* handy for automatic testing */
       break;
+    case 'f': /* launch jobs with fork, for comparison */
+      use_fork = 1;
+      break;
     default:
       usage();
     }
@@ -155,17 +216,23 @@ int main(int argc, char **argv) {
  * eval - Evaluate the command line that the user has just typed in
  *
  * If the user has requested a built-in command (quit, jobs, bg or fg)
- * then execute it immediately. Otherwise, fork a child process and
- * run the job in the context of the child. If the job is running in
- * the foreground, wait for it to terminate and then return.  Note:
- * each child process must have a unique process group ID so that our
- * background children don't receive SIGINT (SIGTSTP) from the kernel
- * when we type ctrl-c (ctrl-z) at the keyboard.
+ * then execute it immediately. Otherwise, start a child process for
+ * each command of the pipeline, connected by pipes, and run the job in
+ * the context of the children. If the job is running in the foreground,
+ * wait for it to terminate and then return.  Note: each job must have a
+ * unique process group ID so that our background children don't receive
+ * SIGINT (SIGTSTP) from the kernel when we type ctrl-c (ctrl-z) at the
+ * keyboard. All the processes of a pipeline share the group of its first
+ * process, so that ctrl-c and ctrl-z reach all of them.
  */
 void eval(char *cmdline) {
   static char *argv[MAXARGS]; /* Holds arguments of command line */
+  struct cmd_t cmds[MAXPIPE]; /* Holds commands of the pipeline */
+  pid_t pids[MAXPIPE];        /* Holds processes started */
   int bg;                     /* Background job? */
-  pid_t pid;
+  int ncmds, nprocs, i;
+  int in, out, fds[2];
+  pid_t pid, pgid;
   sigset_t mask_one, mask_all, prev_mask;
 
   sigemptyset(&mask_one);
@@ -179,44 +246,193 @@ void eval(char *cmdline) {
   bg = parseline(cmdline, argv);
   if (argv[0] == NULL) /* Ignore blank line */
     return;
+  if ((ncmds = parsepipe(argv, cmds)) == 0) /* Syntax error */
+    return;
 
   /* Process as built-in command */
-  if (builtin_cmd(argv))
+  if (ncmds == 1 && cmds[0].infile == NULL && cmds[0].outfile == NULL &&
+      builtin_cmd(cmds[0].argv))
     return;
+  for (i = 0; i < ncmds; i++) {
+    if (isbuiltin(cmds[i].argv[0])) {
+      printf("%s: built-in command cannot be piped or redirected\n",
+             cmds[i].argv[0]);
+      return;
+    }
+  }
 
-  /* Process the executable file */
+  /* Process the executable files, from left to right. The first process
+   * started leads the group of the job. */
   sigprocmask(SIG_BLOCK, &mask_one, &prev_mask); /* Block SIGCHLD */
-  if ((pid = fork()) == 0) {                     /* Child process */
-    sigprocmask(SIG_SETMASK, &prev_mask,
-                NULL); /* Unblock SIGCHLD for the child process */
-    setpgid(0, 0);     /* Add the child process into a new group */
-    if (execve(argv[0], argv, environ) < 0) { /* Invalid executable file */
-      printf("%s: Command not found\n", argv[0]);
-      exit(0);
+  nprocs = 0;
+  pgid = 0;
+  in = -1;
+  for (i = 0; i < ncmds; i++) {
+    out = fds[0] = -1;
+    if (i < ncmds - 1) { /* Not the last command: pipe to the next one */
+      if (pipe2(fds, O_CLOEXEC) < 0) {
+        printf("pipe: %s\n", strerror(errno));
+        if (in >= 0)
+          close(in);
+        break;
+      }
+      out = fds[1];
+    }
+    if ((pid = launch(&cmds[i], pgid, in, out, &prev_mask)) != 0) {
+      pids[nprocs++] = pid;
+      if (pgid == 0)
+        pgid = pid;
     }
+    if (in >= 0)
+      close(in);
+    if (out >= 0)
+      close(out);
+    in = fds[0];
   }
+  if (nprocs == 0) {                            /* Nothing started */
+    sigprocmask(SIG_SETMASK, &prev_mask, NULL); /* Unblock SIGCHLD */
+    return;
+  }
+
+  pid = pgid;
   if (bg) { /* Run background */
     sigprocmask(SIG_BLOCK, &mask_all,
                 NULL); /* Block SIGCHLD, SIGTSTP, SIGINT */
-    addjob(jobs, pid, BG, cmdline);
+    addjob(jobs, pids, nprocs, BG, cmdline);
     sigprocmask(SIG_SETMASK, &mask_one, NULL); /* Unblock SIGTSTP, SIGINT */
     printf("[%d] (%d) %s", pid2jid(pid), pid, cmdline);
   } else { /* Run foreground */
     sigprocmask(SIG_BLOCK, &mask_all,
                 NULL); /* Block SIGCHLD, SIGTSTP, SIGINT */
-    addjob(jobs, pid, FG, cmdline);
+    addjob(jobs, pids, nprocs, FG, cmdline);
     sigprocmask(SIG_SETMASK, &mask_one, NULL); /* Unblock SIGTSTP, SIGINT */
     waitfg(pid);
   }
   sigprocmask(SIG_SETMASK, &prev_mask, NULL); /* Unblock SIGCHLD */
 }
 
+/*
+ * openfile - Open the file of a redirection in the shell, so that an
+ *    error is reported before anything is started. Return the file
+ *    descriptor (closed on exec), or -1 after printing the reason.
+ */
+int openfile(char *name, int flags) {
+  int fd;
+
+  if ((fd = open(name, flags | O_CLOEXEC, 0666)) < 0)
+    printf("%s: %s\n", name, strerror(errno));
+  return fd;
+}
+
+/*
+ * launch - Start the command cmd with its standard input and output
+ *    taken from in and out (unless -1) or from its redirections, in the
+ *    process group pgid, or in a new one whose ID is its PID if pgid is
+ *    0, with the signal mask set to mask. Return its PID, or 0 after
+ *    printing the reason if it could not be started.
+ *
+ * By default the child is created by posix_spawn, which glibc implements
+ * with clone(CLONE_VM | CLONE_VFORK): the child runs on the shell's
+ * memory until it calls execve, so unlike fork nothing is copied and the
+ * cost does not grow with the size of the shell's image. posix_spawn also
+ * reports a failed execve to the shell, which prints the error itself
+ * instead of leaving that to the child. With -f, and for the built-in
+ * tee, which runs code of the shell, the child is forked.
+ */
+pid_t launch(struct cmd_t *cmd, pid_t pgid, int in, int out,
+             sigset_t *mask) {
+  char **argv = cmd->argv;
+  pid_t pid = 0;
+  int err, infd = -1, outfd = -1;
+  posix_spawnattr_t attr;
+  posix_spawn_file_actions_t actions;
+
+  /* A redirection takes the place of the pipe */
+  if (cmd->infile != NULL) {
+    if ((infd = openfile(cmd->infile, O_RDONLY)) < 0)
+      return 0;
+    in = infd;
+  }
+  if (cmd->outfile != NULL) {
+    outfd = openfile(cmd->outfile,
+                     O_WRONLY | O_CREAT | (cmd->append ? O_APPEND : O_TRUNC));
+    if (outfd < 0) {
+      if (infd >= 0)
+        close(infd);
+      return 0;
+    }
+    out = outfd;
+  }
+
+  if (use_fork || !strcmp(argv[0], "tee")) {
+    if ((pid = fork()) == 0) { /* Child process */
+      Signal(SIGINT, SIG_DFL);
+      Signal(SIGTSTP, SIG_DFL);
+      Signal(SIGCHLD, SIG_DFL);
+      Signal(SIGQUIT, SIG_DFL);
+      setpgid(0, pgid); /* Join the job's group, or start it */
+      sigprocmask(SIG_SETMASK, mask, NULL); /* Unblock SIGCHLD for the child */
+      if (in >= 0)
+        dup2(in, STDIN_FILENO);
+      if (out >= 0)
+        dup2(out, STDOUT_FILENO);
+      if (!strcmp(argv[0], "tee")) {
+        close_range(3, ~0U, 0); /* The pipes of the other commands */
+        _exit(do_tee(argv));
+      }
+      if (execve(argv[0], argv, environ) < 0) { /* Invalid executable file */
+        printf("%s: Command not found\n", argv[0]);
+        exit(0);
+      }
+    }
+    if (pid < 0) {
+      printf("%s: %s\n", argv[0], strerror(errno));
+      pid = 0;
+    } else {
+      setpgid(pid, pgid ? pgid : pid); /* In case the shell runs first */
+    }
+  } else {
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr,
+                             POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+    posix_spawnattr_setpgroup(&attr, pgid); /* 0: group ID = the child's PID */
+    posix_spawnattr_setsigmask(&attr, mask);
+    posix_spawn_file_actions_init(&actions);
+    if (in >= 0)
+      posix_spawn_file_actions_adddup2(&actions, in, STDIN_FILENO);
+    if (out >= 0)
+      posix_spawn_file_actions_adddup2(&actions, out, STDOUT_FILENO);
+    err = posix_spawn(&pid, argv[0], &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    if (err != 0) {
+      /* glibc's posix_spawn reports a failed execve here and has already
+       * reaped the child, so the command gets no PID and no job, and
+       * sigchld_handler never sees it */
+      if (err == ENOENT || err == EACCES || err == ENOEXEC || err == ENOTDIR)
+        printf("%s: Command not found\n", argv[0]);
+      else
+        printf("%s: %s\n", argv[0], strerror(err));
+      pid = 0;
+    }
+  }
+
+  if (infd >= 0)
+    close(infd);
+  if (outfd >= 0)
+    close(outfd);
+  return pid;
+}
+
 /*
  * parseline - Parse the command line and build the argv array.
  *
  * Characters enclosed in single quotes are treated as a single
- * argument.  Return true if the user has requested a BG job, false if
- * the user has requested a FG job.
+ * argument. An unquoted word that is one of the operators |, <, > or >>
+ * is returned as op_pipe, op_in, op_out or op_append. Operators must be
+ * words of their own: "tsh>" is an argument, as the traces expect. Return
+ * true if the user has requested a BG job, false if the user has
+ * requested a FG job.
  */
 int parseline(const char *cmdline, char **argv) {
   static char array[MAXLINE]; /* holds local copy of command line */
@@ -224,6 +440,7 @@ int parseline(const char *cmdline, char **argv) {
   char *delim;                /* points to first space delimiter */
   int argc;                   /* number of args */
   int bg;                     /* background job? */
+  int quoted;                 /* is the current word quoted? */
 
   strcpy(buf, cmdline);
   buf[strlen(buf) - 1] = ' ';   /* replace trailing '\n' with space */
@@ -232,21 +449,21 @@ int parseline(const char *cmdline, char **argv) {
 
   /* Build the argv list */
   argc = 0;
-  if (*buf == '\'') {
+  if ((quoted = (*buf == '\''))) {
     buf++;
     delim = strchr(buf, '\'');
   } else {
     delim = strchr(buf, ' ');
   }
 
-  while (delim) {
-    argv[argc++] = buf;
+  while (delim && argc < MAXARGS - 1) {
+    argv[argc++] = quoted ? buf : operator(buf, delim - buf);
     *delim = '\0';
     buf = delim + 1;
     while (*buf && (*buf == ' ')) /* ignore spaces */
       buf++;
 
-    if (*buf == '\'') {
+    if ((quoted = (*buf == '\''))) {
       buf++;
       delim = strchr(buf, '\'');
     } else {
@@ -265,6 +482,86 @@ int parseline(const char *cmdline, char **argv) {
   return bg;
 }
 
+/*
+ * operator - Return the operator spelled by the len characters of word,
+ *    or word itself if they are not an operator
+ */
+char *operator(char *word, int len) {
+  if (len == 1 && *word == '|')
+    return op_pipe;
+  if (len == 1 && *word == '<')
+    return op_in;
+  if (len == 1 && *word == '>')
+    return op_out;
+  if (len == 2 && word[0] == '>' && word[1] == '>')
+    return op_append;
+  return word;
+}
+
+/*
+ * isop - Is the word an operator returned by parseline?
+ */
+int isop(char *word) {
+  return word == op_pipe || word == op_in || word == op_out ||
+         word == op_append;
+}
+
+/*
+ * parsepipe - Split the argv array built by parseline into the commands
+ *    of a pipeline, taking out the redirections. The arguments of each
+ *    command stay in argv, where each | is replaced by NULL. Return the
+ *    number of commands, or 0 after printing a message if the line is
+ *    not a valid pipeline.
+ */
+int parsepipe(char **argv, struct cmd_t *cmds) {
+  int ncmds = 0; /* number of commands */
+  int start = 0; /* where the arguments of the current command start */
+  int i, j;      /* read and write argv */
+  char *word;
+
+  memset(&cmds[0], 0, sizeof(struct cmd_t));
+  for (i = j = 0;; i++) {
+    word = argv[i];
+    if (word == NULL || word == op_pipe) { /* End of a command */
+      if (j == start) {
+        printf("Missing command in pipeline\n");
+        return 0;
+      }
+      cmds[ncmds++].argv = &argv[start];
+      argv[j++] = NULL;
+      if (word == NULL)
+        return ncmds;
+      if (ncmds == MAXPIPE) {
+        printf("Too many commands in pipeline\n");
+        return 0;
+      }
+      memset(&cmds[ncmds], 0, sizeof(struct cmd_t));
+      start = j;
+    } else if (isop(word)) { /* A redirection and its file */
+      if (argv[i + 1] == NULL || isop(argv[i + 1])) {
+        printf("Missing file name after %s\n", word);
+        return 0;
+      }
+      if (word == op_in) {
+        cmds[ncmds].infile = argv[++i];
+      } else {
+        cmds[ncmds].outfile = argv[++i];
+        cmds[ncmds].append = (word == op_append);
+      }
+    } else {
+      argv[j++] = word;
+    }
+  }
+}
+
+/*
+ * isbuiltin - Is name one of the built-in commands run by builtin_cmd?
+ */
+int isbuiltin(char *name) {
+  return !strcmp(name, "quit") || !strcmp(name, "jobs") ||
+         !strcmp(name, "bg") || !strcmp(name, "fg");
+}
+
 /*
  * builtin_cmd - If the user has typed a built-in command then execute
  *    it immediately.
@@ -339,7 +636,7 @@ void do_bgfg(char **argv) {
 
   /* Restart the child job */
   sigprocmask(SIG_BLOCK, &mask_all, NULL); /* Block SIGCHLD, SIGTSTP, SIGINT */
-  job->state = state;
+  setjobstate(jobs, job, state);
   sigprocmask(SIG_SETMASK, &mask_one, NULL); /* Unblock SIGTSTP, SIGINT */
   kill(-(job->pid), SIGCONT);
   if (state == BG) {
@@ -352,6 +649,125 @@ void do_bgfg(char **argv) {
   sigprocmask(SIG_SETMASK, &prev_mask, NULL); /* Unblock SIGCHLD */
 }
 
+/*
+ * writeall - Write the n bytes at buf to fd. Return 0, or -1 on error.
+ */
+int writeall(int fd, const char *buf, ssize_t n) {
+  ssize_t w;
+
+  while (n > 0) {
+    if ((w = write(fd, buf, n)) < 0)
+      return -1;
+    buf += w;
+    n -= w;
+  }
+  return 0;
+}
+
+/*
+ * copyfd - Copy in to the standard output and to fd (unless -1) through
+ *    a buffer, until end of file. Return the exit status of tee.
+ */
+int copyfd(int in, int fd) {
+  char buf[TEECHUNK];
+  ssize_t n;
+
+  while ((n = read(in, buf, sizeof(buf))) > 0) {
+    if (writeall(STDOUT_FILENO, buf, n) < 0 ||
+        (fd >= 0 && writeall(fd, buf, n) < 0))
+      return 1;
+  }
+  return n < 0;
+}
+
+/*
+ * movefd - Move n bytes from the pipe in to out, with splice, or with
+ *    read and write if out does not support splice. Return 0, or -1 on
+ *    error.
+ */
+int movefd(int in, int out, ssize_t n) {
+  char buf[TEECHUNK];
+  ssize_t m;
+
+  while (n > 0) {
+    if ((m = splice(in, NULL, out, NULL, n, SPLICE_F_MOVE)) < 0) {
+      if (errno != EINVAL)
+        return -1;
+      if ((m = read(in, buf, n < TEECHUNK ? n : TEECHUNK)) <= 0 ||
+          writeall(out, buf, m) < 0)
+        return -1;
+    }
+    n -= m;
+  }
+  return 0;
+}
+
+/*
+ * isfifo - Is the file descriptor a pipe?
+ */
+int isfifo(int fd) {
+  struct stat st;
+
+  return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+/*
+ * do_tee - Execute the built-in tee stage, in a child of its own: copy
+ *    the standard input to the standard output and to the file argv[1]
+ *    if given (appending to it after -a). Return the exit status.
+ *
+ * When the input is a pipe, the data does not pass through the stage's
+ * memory. tee(2) duplicates the bytes waiting in the input pipe into the
+ * output pipe without consuming them, then splice(2) moves the same
+ * bytes from the input pipe to the file. If the output is not a pipe,
+ * tee duplicates into a pipe of the stage's own, which splice empties
+ * into the output. Only where the kernel cannot splice to the output
+ * (a terminal, say) or when the input is not a pipe does the stage fall
+ * back to read and write.
+ */
+int do_tee(char **argv) {
+  int i = 1, fd = -1, append = 0;
+  int spare[2] = {-1, -1}; /* the stage's own pipe, if needed */
+  ssize_t n;
+
+  if (argv[i] != NULL && !strcmp(argv[i], "-a")) {
+    append = 1;
+    i++;
+  }
+  if (argv[i] != NULL && argv[i + 1] != NULL) {
+    fprintf(stderr, "Usage: tee [-a] [file]\n");
+    return 1;
+  }
+  if (argv[i] != NULL &&
+      (fd = open(argv[i], O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC),
+                 0666)) < 0) {
+    fprintf(stderr, "%s: %s\n", argv[i], strerror(errno));
+    return 1;
+  }
+
+  if (!isfifo(STDIN_FILENO))
+    return copyfd(STDIN_FILENO, fd);
+  if (fd < 0) { /* Nothing to duplicate: move the input to the output */
+    while ((n = splice(STDIN_FILENO, NULL, STDOUT_FILENO, NULL, TEECHUNK,
+                       SPLICE_F_MOVE)) > 0)
+      ;
+    if (n < 0 && errno == EINVAL)
+      return copyfd(STDIN_FILENO, -1);
+    return n < 0;
+  }
+  if (!isfifo(STDOUT_FILENO) && pipe(spare) < 0)
+    return copyfd(STDIN_FILENO, fd);
+
+  while ((n = tee(STDIN_FILENO, spare[1] >= 0 ? spare[1] : STDOUT_FILENO,
+                  TEECHUNK, 0)) > 0) {
+    if (spare[0] >= 0 && movefd(spare[0], STDOUT_FILENO, n) < 0)
+      return 1;
+    if (movefd(STDIN_FILENO, fd, n) < 0)
+      return 1;
+  }
+  return n < 0;
+}
+
 /*
  * waitfg - Block until process pid is no longer the foreground process
  */
@@ -392,20 +808,31 @@ void sigchld_handler(int sig) {
 
   while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED)) > 0) {
     sigprocmask(SIG_BLOCK, &mask, &prev_mask);
+    job = getjobpid(jobs, pid);
     if (WIFEXITED(status)) { /* Exit normally */
-      deletejob(jobs, pid);
+      deleteproc(jobs, pid);
     } else if (WIFSIGNALED(status)) { /* Exit by signal */
-      len =
-          snprintf(buf, sizeof(buf), "Job [%d] (%d) terminated by signal %d\n",
-                   pid2jid(pid), pid, WTERMSIG(status));
-      write(STDOUT_FILENO, buf, len);
-      deletejob(jobs, pid);
+      /* A pipeline is reported by its last command, so that a process
+       * killed by SIGPIPE after a later one exited goes unreported */
+      if (job == NULL || pid == job->pids[job->nprocs - 1]) {
+        len = snprintf(buf, sizeof(buf),
+                       "Job [%d] (%d) terminated by signal %d\n",
+                       job ? job->jid : 0, job ? job->pid : pid,
+                       WTERMSIG(status));
+        write(STDOUT_FILENO, buf, len);
+      }
+      deleteproc(jobs, pid);
     } else if (WIFSTOPPED(status)) { /* Stopped by signal */
-      len = snprintf(buf, sizeof(buf), "Job [%d] (%d) stopped by signal %d\n",
-                     pid2jid(pid), pid, WSTOPSIG(status));
-      write(STDOUT_FILENO, buf, len);
-      job = getjobpid(jobs, pid);
-      job->state = ST;
+      /* Reported once, by the first process of the job to stop */
+      if (job == NULL || job->state != ST) {
+        len = snprintf(buf, sizeof(buf),
+                       "Job [%d] (%d) stopped by signal %d\n",
+                       job ? job->jid : 0, job ? job->pid : pid,
+                       WSTOPSIG(status));
+        write(STDOUT_FILENO, buf, len);
+      }
+      if (job != NULL)
+        setjobstate(jobs, job, ST);
     }
     sigprocmask(SIG_SETMASK, &prev_mask, NULL);
   }
@@ -472,125 +899,265 @@ void clearjob(struct job_t *job) {
   job->pid = 0;
   job->jid = 0;
   job->state = UNDEF;
+  job->nprocs = 0;
+  job->nlive = 0;
   job->cmdline[0] = '\0';
 }
 
-/* initjobs - Initialize the job list */
-void initjobs(struct job_t *jobs) {
-  int i;
+/*
+ * jobkey - The key of entry e in the PID map (the PID of place
+ *    e % MAXPIPE of slot e / MAXPIPE), or in the JID map (slot e) if byjid
+ */
+static int jobkey(struct jobs_t *jobs, int e, int byjid) {
+  return byjid ? jobs->slots[e].jid
+               : jobs->slots[e / MAXPIPE].pids[e % MAXPIPE];
+}
 
-  for (i = 0; i < MAXJOBS; i++)
-    clearjob(&jobs[i]);
+/* jobhash - The home entry of key in a map of cap entries */
+static int jobhash(int key, int cap) {
+  return (int)(((unsigned)key * 2654435761u) & (cap - 1));
 }
 
-/* maxjid - Returns largest allocated job ID */
-int maxjid(struct job_t *jobs) {
-  int i, max = 0;
+/*
+ * mapfind - Return the entry of key in map, or the empty entry where it
+ *    belongs if it is not there
+ */
+static int mapfind(struct jobs_t *jobs, int *map, int key, int byjid) {
+  int cap = byjid ? jobs->jidcap : jobs->pidcap;
+  int h = jobhash(key, cap);
 
-  for (i = 0; i < MAXJOBS; i++)
-    if (jobs[i].jid > max)
-      max = jobs[i].jid;
-  return max;
+  while (map[h] != 0 && jobkey(jobs, map[h] - 1, byjid) != key)
+    h = (h + 1) & (cap - 1);
+  return h;
 }
 
-/* addjob - Add a job to the job list */
-int addjob(struct job_t *jobs, pid_t pid, int state, char *cmdline) {
-  int i;
+/* mapinsert - Point the key of entry e in map at e */
+static void mapinsert(struct jobs_t *jobs, int *map, int e, int byjid) {
+  map[mapfind(jobs, map, jobkey(jobs, e, byjid), byjid)] = e + 1;
+}
 
-  if (pid < 1)
-    return 0;
+/*
+ * mapremove - Remove key from map. The entries that follow it move back
+ *    into the hole where they can, so that no search stops short and
+ *    there are no tombstones.
+ */
+static void mapremove(struct jobs_t *jobs, int *map, int key, int byjid) {
+  int mask = (byjid ? jobs->jidcap : jobs->pidcap) - 1;
+  int hole = mapfind(jobs, map, key, byjid);
+  int i, home;
 
-  for (i = 0; i < MAXJOBS; i++) {
-    if (jobs[i].pid == 0) {
-      jobs[i].pid = pid;
-      jobs[i].state = state;
-      jobs[i].jid = nextjid++;
-      if (nextjid > MAXJID)
-        nextjid = 1;
-      strcpy(jobs[i].cmdline, cmdline);
-      if (verbose) {
-        printf("Added job [%d] %d %s\n", jobs[i].jid, jobs[i].pid,
-               jobs[i].cmdline);
-      }
-      return 1;
+  if (map[hole] == 0)
+    return;
+  for (i = (hole + 1) & mask; map[i] != 0; i = (i + 1) & mask) {
+    home = jobhash(jobkey(jobs, map[i] - 1, byjid), mask + 1);
+    if (((i - home) & mask) >= ((i - hole) & mask)) { /* hole in [home, i) */
+      map[hole] = map[i];
+      hole = i;
     }
   }
-  printf("Tried to create too many jobs\n");
+  map[hole] = 0;
+}
+
+/*
+ * growjobs - Double the job table, which must be full, and rebuild its
+ *    maps. Return 0, or -1 if memory runs out. The caller blocks the
+ *    signals whose handlers use the table.
+ */
+static int growjobs(struct jobs_t *jobs) {
+  int cap = jobs->cap ? 2 * jobs->cap : MAXJOBS;
+  int pidcap = 1, jidcap = 1;
+  struct job_t *slots;
+  int *stack, *pidmap, *jidmap;
+  int i, k;
+
+  while (jidcap < 2 * cap)
+    jidcap *= 2;
+  while (pidcap < 2 * cap * MAXPIPE)
+    pidcap *= 2;
+  if ((slots = realloc(jobs->slots, cap * sizeof(struct job_t))) == NULL)
+    return -1;
+  jobs->slots = slots; /* only the first jobs->cap slots are used yet */
+  stack = malloc(cap * sizeof(int));
+  pidmap = calloc(pidcap, sizeof(int));
+  jidmap = calloc(jidcap, sizeof(int));
+  if (stack == NULL || pidmap == NULL || jidmap == NULL) {
+    free(stack);
+    free(pidmap);
+    free(jidmap);
+    return -1;
+  }
+
+  /* Push the new slots so that the lowest is used first */
+  for (i = cap - 1; i >= jobs->cap; i--) {
+    clearjob(&slots[i]);
+    stack[jobs->nfree++] = i;
+  }
+  free(jobs->free);
+  free(jobs->pidmap);
+  free(jobs->jidmap);
+  jobs->free = stack;
+  jobs->pidmap = pidmap;
+  jobs->jidmap = jidmap;
+  jobs->pidcap = pidcap;
+  jobs->jidcap = jidcap;
+  for (i = 0; i < jobs->cap; i++) {
+    for (k = 0; k < slots[i].nprocs; k++)
+      if (slots[i].pids[k] != 0)
+        mapinsert(jobs, pidmap, i * MAXPIPE + k, 0);
+    mapinsert(jobs, jidmap, i, 1);
+  }
+  jobs->cap = cap;
   return 0;
 }
 
-/* deletejob - Delete a job whose PID=pid from the job list */
-int deletejob(struct job_t *jobs, pid_t pid) {
-  int i;
+/* initjobs - Initialize the job list */
+void initjobs(struct jobs_t *jobs) {
+  memset(jobs, 0, sizeof(*jobs));
+  if (growjobs(jobs) < 0)
+    app_error("initjobs: out of memory");
+}
 
-  if (pid < 1)
+/* maxjid - Returns largest allocated job ID */
+int maxjid(struct jobs_t *jobs) { return jobs->maxjid; }
+
+/*
+ * addjob - Add a job to the job list: a pipeline of the n processes in
+ *    pids, whose process group is that of pids[0]
+ */
+int addjob(struct jobs_t *jobs, pid_t *pids, int n, int state,
+           char *cmdline) {
+  struct job_t *job;
+  int i, k;
+
+  if (n < 1 || n > MAXPIPE || pids[0] < 1)
     return 0;
 
-  for (i = 0; i < MAXJOBS; i++) {
-    if (jobs[i].pid == pid) {
-      clearjob(&jobs[i]);
-      nextjid = maxjid(jobs) + 1;
-      return 1;
-    }
+  if (jobs->nfree == 0 && (jobs->cap >= MAXJID || growjobs(jobs) < 0)) {
+    printf("Tried to create too many jobs\n");
+    return 0;
   }
-  return 0;
+  while (getjobjid(jobs, nextjid) != NULL) /* IDs wrapped around */
+    if (++nextjid > MAXJID)
+      nextjid = 1;
+
+  i = jobs->free[--jobs->nfree];
+  job = &jobs->slots[i];
+  job->pid = pids[0];
+  job->state = state;
+  job->jid = nextjid++;
+  if (nextjid > MAXJID)
+    nextjid = 1;
+  job->nprocs = job->nlive = n;
+  strcpy(job->cmdline, cmdline);
+  for (k = 0; k < n; k++) {
+    job->pids[k] = pids[k];
+    mapinsert(jobs, jobs->pidmap, i * MAXPIPE + k, 0);
+  }
+  mapinsert(jobs, jobs->jidmap, i, 1);
+  if (job->jid > jobs->maxjid)
+    jobs->maxjid = job->jid;
+  if (state == FG)
+    jobs->fg = job->pid;
+  if (verbose) {
+    printf("Added job [%d] %d %s\n", job->jid, job->pid, job->cmdline);
+  }
+  return 1;
 }
 
-/* fgpid - Return PID of current foreground job, 0 if no such job */
-pid_t fgpid(struct job_t *jobs) {
-  int i;
+/* deletejob - Delete the job of the process PID=pid from the job list */
+int deletejob(struct jobs_t *jobs, pid_t pid) {
+  struct job_t *job;
+  int jid, k;
 
-  for (i = 0; i < MAXJOBS; i++)
-    if (jobs[i].state == FG)
-      return jobs[i].pid;
-  return 0;
+  if ((job = getjobpid(jobs, pid)) == NULL)
+    return 0;
+
+  jid = job->jid;
+  for (k = 0; k < job->nprocs; k++)
+    if (job->pids[k] != 0)
+      mapremove(jobs, jobs->pidmap, job->pids[k], 0);
+  mapremove(jobs, jobs->jidmap, jid, 1);
+  if (jobs->fg == job->pid)
+    jobs->fg = 0;
+  clearjob(job);
+  jobs->free[jobs->nfree++] = job - jobs->slots;
+
+  /* The next lower ID still in use; each ID is passed over at most once
+   * for every time it is allocated */
+  if (jid == jobs->maxjid)
+    while (jobs->maxjid > 0 && getjobjid(jobs, jobs->maxjid) == NULL)
+      jobs->maxjid--;
+  nextjid = maxjid(jobs) + 1;
+  return 1;
+}
+
+/*
+ * deleteproc - Remove the reaped process PID=pid from its job, and
+ *    delete the job if it was the last one left
+ */
+int deleteproc(struct jobs_t *jobs, pid_t pid) {
+  struct job_t *job;
+  int e;
+
+  if (pid < 1 || (e = jobs->pidmap[mapfind(jobs, jobs->pidmap, pid, 0)]) == 0)
+    return 0;
+  job = &jobs->slots[(e - 1) / MAXPIPE];
+  if (job->nlive == 1)
+    return deletejob(jobs, pid);
+  mapremove(jobs, jobs->pidmap, pid, 0);
+  job->pids[(e - 1) % MAXPIPE] = 0; /* the PID may be reused from now on */
+  job->nlive--;
+  return 1;
+}
+
+/* setjobstate - Change the state of a job on the job list */
+void setjobstate(struct jobs_t *jobs, struct job_t *job, int state) {
+  job->state = state;
+  if (state == FG)
+    jobs->fg = job->pid;
+  else if (jobs->fg == job->pid)
+    jobs->fg = 0;
 }
 
-/* getjobpid  - Find a job (by PID) on the job list */
-struct job_t *getjobpid(struct job_t *jobs, pid_t pid) {
-  int i;
+/* fgpid - Return PID of current foreground job, 0 if no such job */
+pid_t fgpid(struct jobs_t *jobs) { return jobs->fg; }
+
+/* getjobpid  - Find a job (by the PID of any of its processes) */
+struct job_t *getjobpid(struct jobs_t *jobs, pid_t pid) {
+  int e;
 
   if (pid < 1)
     return NULL;
-  for (i = 0; i < MAXJOBS; i++)
-    if (jobs[i].pid == pid)
-      return &jobs[i];
-  return NULL;
+  e = jobs->pidmap[mapfind(jobs, jobs->pidmap, pid, 0)];
+  return e ? &jobs->slots[(e - 1) / MAXPIPE] : NULL;
 }
 
 /* getjobjid  - Find a job (by JID) on the job list */
-struct job_t *getjobjid(struct job_t *jobs, int jid) {
-  int i;
+struct job_t *getjobjid(struct jobs_t *jobs, int jid) {
+  int e;
 
   if (jid < 1)
     return NULL;
-  for (i = 0; i < MAXJOBS; i++)
-    if (jobs[i].jid == jid)
-      return &jobs[i];
-  return NULL;
+  e = jobs->jidmap[mapfind(jobs, jobs->jidmap, jid, 1)];
+  return e ? &jobs->slots[e - 1] : NULL;
 }
 
 /* pid2jid - Map process ID to job ID */
 int pid2jid(pid_t pid) {
-  int i;
+  struct job_t *job = getjobpid(jobs, pid);
 
-  if (pid < 1)
-    return 0;
-  for (i = 0; i < MAXJOBS; i++)
-    if (jobs[i].pid == pid) {
-      return jobs[i].jid;
-    }
-  return 0;
+  return job ? job->jid : 0;
 }
 
-/* listjobs - Print the job list */
-void listjobs(struct job_t *jobs) {
-  int i;
+/* listjobs - Print the job list, in order of job ID */
+void listjobs(struct jobs_t *jobs) {
+  struct job_t *job;
+  int jid;
 
-  for (i = 0; i < MAXJOBS; i++) {
-    if (jobs[i].pid != 0) {
-      printf("[%d] (%d) ", jobs[i].jid, jobs[i].pid);
-      switch (jobs[i].state) {
+  for (jid = 1; jid <= jobs->maxjid; jid++) {
+    if ((job = getjobjid(jobs, jid)) != NULL) {
+      printf("[%d] (%d) ", job->jid, job->pid);
+      switch (job->state) {
       case BG:
         printf("Running ");
         break;
@@ -601,9 +1168,10 @@ void listjobs(struct job_t *jobs) {
         printf("Stopped ");
         break;
       default:
-        printf("listjobs: Internal error: job[%d].state=%d ", i, jobs[i].state);
+        printf("listjobs: Internal error: job[%d].state=%d ",
+               (int)(job - jobs->slots), job->state);
       }
-      printf("%s", jobs[i].cmdline);
+      printf("%s", job->cmdline);
     }
   }
 }
@@ -619,10 +1187,11 @@ void listjobs(struct job_t *jobs) {
  * usage - print a help message
  */
 void usage(void) {
-  printf("Usage: shell [-hvp]\n");
+  printf("Usage: shell [-hvpf]\n");
   printf("   -h   print this message\n");
   printf("   -v   print additional diagnostic information\n");
   printf("   -p   do not emit a command prompt\n");
+  printf("   -f   launch jobs with fork instead of posix_spawn\n");
   exit(1);
 }
 
@@ -0,0 +1,194 @@
+/*
+ * tshbench - Time how fast tsh launches background jobs
+ *
+ * usage: tshbench [-h] [-n jobs] [-c cmd] [-m MB] [-s shell]
+ *
+ * First it feeds the shell (./tsh by default) a script of <jobs> lines
+ * "<cmd> &", with /bin/true as the default command, and times the shell
+ * from start to exit, once launching with posix_spawn and once with fork
+ * (tsh -f). The shell reaps the jobs as they end, so this also exercises
+ * its job table; a longer command such as "./myspin 1" keeps thousands of
+ * jobs alive at once.
+ *
+ * Then it compares the two ways of launching in a process of its own, after
+ * touching <MB> megabytes of memory (256 by default): fork must copy the
+ * page tables of the whole image for every child, while posix_spawn starts
+ * the child on the parent's memory. tsh itself is small, so this shows
+ * what a shell with a large image would gain.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define MAXARGS 128 /* max args of the command */
+
+extern char **environ;
+
+/*
+ * now - Wall-clock time in seconds
+ */
+static double now(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/*
+ * unix_error - unix-style error routine
+ */
+static void unix_error(char *msg) {
+  fprintf(stderr, "%s: %s\n", msg, strerror(errno));
+  exit(1);
+}
+
+/*
+ * run_shell - Feed the shell n background jobs of cmd, with flag ("-f"
+ *    for fork) if not NULL, and return the seconds until it exits
+ */
+static double run_shell(const char *shell, const char *flag, const char *cmd,
+                        int n) {
+  int fds[2], devnull, status, i;
+  char line[1024];
+  pid_t pid;
+  double start;
+  FILE *in;
+
+  if (pipe(fds) < 0)
+    unix_error("pipe error");
+  start = now();
+  if ((pid = fork()) == 0) { /* Child: the shell reads the pipe */
+    if ((devnull = open("/dev/null", O_WRONLY)) < 0)
+      unix_error("open error");
+    dup2(fds[0], STDIN_FILENO);
+    dup2(devnull, STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    close(devnull);
+    execl(shell, shell, "-p", flag, (char *)NULL);
+    unix_error("execl error");
+  }
+  if (pid < 0)
+    unix_error("fork error");
+  close(fds[0]);
+  if ((in = fdopen(fds[1], "w")) == NULL)
+    unix_error("fdopen error");
+  snprintf(line, sizeof(line), "%s &\n", cmd);
+  for (i = 0; i < n; i++)
+    fputs(line, in);
+  fclose(in); /* EOF makes the shell exit */
+  if (waitpid(pid, &status, 0) < 0)
+    unix_error("waitpid error");
+  return now() - start;
+}
+
+/*
+ * run_direct - Launch n children running argv and wait for each, with
+ *    fork and execve if use_fork, else with posix_spawn. Return seconds.
+ */
+static double run_direct(char **argv, int n, int use_fork) {
+  double start = now();
+  pid_t pid;
+  int i, err;
+
+  for (i = 0; i < n; i++) {
+    if (use_fork) {
+      if ((pid = fork()) == 0) {
+        execve(argv[0], argv, environ);
+        _exit(127);
+      }
+      if (pid < 0)
+        unix_error("fork error");
+    } else if ((err = posix_spawn(&pid, argv[0], NULL, NULL, argv,
+                                  environ)) != 0) {
+      errno = err;
+      unix_error("posix_spawn error");
+    }
+    if (waitpid(pid, NULL, 0) < 0)
+      unix_error("waitpid error");
+  }
+  return now() - start;
+}
+
+/*
+ * usage - print a help message
+ */
+static void usage(void) {
+  printf("Usage: tshbench [-h] [-n jobs] [-c cmd] [-m MB] [-s shell]\n");
+  printf("   -h        print this message\n");
+  printf("   -n jobs   background jobs to launch (default 5000)\n");
+  printf("   -c cmd    command of each job (default /bin/true)\n");
+  printf("   -m MB     memory touched before launching directly (default "
+         "256)\n");
+  printf("   -s shell  shell to drive (default ./tsh)\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  const char *shell = "./tsh";
+  char *cmd = "/bin/true";
+  char buf[1024], *args[MAXARGS], *ballast;
+  int n = 5000, mb = 256, c, i;
+  double t;
+
+  while ((c = getopt(argc, argv, "hn:c:m:s:")) != EOF) {
+    switch (c) {
+    case 'n':
+      n = atoi(optarg);
+      break;
+    case 'c':
+      cmd = optarg;
+      break;
+    case 'm':
+      mb = atoi(optarg);
+      break;
+    case 's':
+      shell = optarg;
+      break;
+    default:
+      usage();
+    }
+  }
+  if (n < 1 || mb < 0)
+    usage();
+
+  /* A shell that dies early must not take the benchmark with it */
+  signal(SIGPIPE, SIG_IGN);
+
+  printf("%d background jobs of '%s' through %s\n", n, cmd, shell);
+  printf("  %-12s %10s %12s\n", "launch", "seconds", "jobs/s");
+  t = run_shell(shell, NULL, cmd, n);
+  printf("  %-12s %10.3f %12.0f\n", "posix_spawn", t, n / t);
+  t = run_shell(shell, "-f", cmd, n);
+  printf("  %-12s %10.3f %12.0f\n", "fork", t, n / t);
+
+  /* Split cmd into arguments for the direct runs */
+  snprintf(buf, sizeof(buf), "%s", cmd);
+  i = 0;
+  for (char *tok = strtok(buf, " "); tok && i < MAXARGS - 1;
+       tok = strtok(NULL, " "))
+    args[i++] = tok;
+  args[i] = NULL;
+
+  /* Touch every page, so that fork has page tables to copy */
+  if ((ballast = malloc((size_t)mb << 20 | 1)) == NULL)
+    unix_error("malloc error");
+  memset(ballast, 1, (size_t)mb << 20);
+
+  printf("\n%d launches of '%s' directly, with %d MB touched\n", n, cmd, mb);
+  printf("  %-12s %10s %12s\n", "launch", "seconds", "jobs/s");
+  t = run_direct(args, n, 0);
+  printf("  %-12s %10.3f %12.0f\n", "posix_spawn", t, n / t);
+  t = run_direct(args, n, 1);
+  printf("  %-12s %10.3f %12.0f\n", "fork", t, n / t);
+
+  free(ballast);
+  exit(0);
+}